@@ -1,25 +1,21 @@
-#include <map>
+#include <assert.h>
 #include "AST.hpp"
-
-extern "C" const char *lexer_file;
-extern "C" int lexer_line;
+#include "CompilationUnit.hpp"
 
 using namespace std;
 
-class Declaration;
-
 /**
- * Symbol table.
+ * Indentation helper functions. The indentation level is stored in the
+ * stream itself so that several ASTs can be printed concurrently.
  */
-map<string, Declaration *> symtab;
+static const int indent_slot = ios_base::xalloc();
 
-/**
- * Indentation helper functions.
- */
-static int indent_level = 0;
+static long& indent_level(ostream& out) {
+    return out.iword(indent_slot);
+}
 
-static string indent() {
-    return string(indent_level * 4, ' '); // 4 spaces per indent level
+static string indent(ostream& out) {
+    return string(indent_level(out) * 4, ' '); // 4 spaces per indent level
 }
 
 /**
@@ -41,16 +37,19 @@ static const char* COLOR_GRAY = "\033[0;90m";
  */
 
 /**
- * Build a position from the current lexer configuration.
+ * Build a position from the lexer configuration of the current
+ * compilation unit.
  */
 Position::Position() {
-	file = lexer_file;
-	line = lexer_line;
+	auto unit = CompilationUnit::current();
+	file = unit == nullptr ? "" : unit->file();
+	line = unit == nullptr ? 0 : unit->line();
 }
 
 ///
 Position::Position(int line_) {
-	file = lexer_file;
+	auto unit = CompilationUnit::current();
+	file = unit == nullptr ? "" : unit->file();
 	line = line_;
 }
 
@@ -68,6 +67,34 @@ ostream& operator<<(ostream& out, const Position& pos) {
  * printing, source position, etc.
  */
 
+/**
+ * Build an AST. If it is built in the current compilation unit,
+ * the unit records it to destroy it at release time.
+ */
+AST::AST() {
+	auto unit = CompilationUnit::current();
+	if(unit != nullptr)
+		unit->adopt(this);
+}
+
+/**
+ * Allocate an AST node in the arena of the current compilation unit.
+ * The nodes are never deleted one by one: they are all released with
+ * their unit, so AST nodes have to be allocated while a unit is current.
+ * @param size	Node size.
+ * @return		Allocated memory.
+ */
+void *AST::operator new(size_t size) {
+	auto unit = CompilationUnit::current();
+	assert(unit != nullptr);
+	return unit->allocate(size);
+}
+
+/**
+ * @fn void AST::operator delete(void *p);
+ * Do nothing: the memory of the nodes is released with their unit.
+ */
+
 /**
  * @fn void AST::print(ostream& out) const;
  * Print the AST.
@@ -97,6 +124,7 @@ ostream& operator<<(ostream& out, const AST *ast) {
 
 /**
  * Called to fix "goto" calles. Default implementaton does nothing.
+ * @param states	States of the automaton indexed by the identifier of their name.
  */
 void Statement::fix(const vector<State *>& states) {
 
@@ -122,36 +150,46 @@ void Statement::fix(const vector<State *>& states) {
 ///
 void NOPStatement::print(ostream& out) const {
     // AST Output: Print NOP with color
-    out << indent() << COLOR_GREEN << "NOP" << COLOR_RESET;
+    out << indent(out) << COLOR_GREEN << "NOP" << COLOR_RESET;
 }
 
 /**
- * @class SeqStatement
- * AST representing a sequence between statements.
+ * @class BlockStatement
+ * AST representing a sequence of statements. The statements are stored
+ * in a vector and processed in a loop: long sequences do not cause deep
+ * recursion.
  */
 
-///
-SeqStatement::~SeqStatement() {
-	delete _stmt1;
-	delete _stmt2;
-}
+/**
+ * @fn void BlockStatement::add(Statement *stmt);
+ * Add a statement at the end of the block.
+ * @param stmt	Added statement.
+ */
+
+/**
+ * @fn const vector<Statement *>& BlockStatement::statements() const;
+ * Get the statements of the block.
+ * @return	Block statements.
+ */
 
 ///
-void SeqStatement::print(ostream& out) const {
-    // AST Output: Print sequence of statements with color
-    out << indent() << COLOR_BLUE << "SEQ(" << COLOR_RESET << endl;
-    indent_level++;
-	_stmt1->print(out);
-    out << COLOR_BLUE << "," << COLOR_RESET << endl;
-	_stmt2->print(out);
-    indent_level--;
-    out << endl << indent() << COLOR_BLUE << ")" << COLOR_RESET;
+void BlockStatement::print(ostream& out) const {
+    // AST Output: Print block of statements with color
+    out << indent(out) << COLOR_BLUE << "SEQ(" << COLOR_RESET << endl;
+    indent_level(out)++;
+	for(size_t i = 0; i < _stmts.size(); i++) {
+		if(i != 0)
+			out << COLOR_BLUE << "," << COLOR_RESET << endl;
+		_stmts[i]->print(out);
+	}
+    indent_level(out)--;
+    out << endl << indent(out) << COLOR_BLUE << ")" << COLOR_RESET;
 }
 
 ///
-void SeqStatement::fix(const vector<State *>& states) {
-	_stmt1->fix(states);
-	_stmt2->fix(states);
+void BlockStatement::fix(const vector<State *>& states) {
+	for(auto s: _stmts)
+		s->fix(states);
 }
 
 /**
@@ -159,17 +197,13 @@ void SeqStatement::fix(const vector<State *>& states) {
  * Statement representing an assignment.
  */
 
-SetStatement::~SetStatement() {
-	delete _expr;
-}
-
 void SetStatement::print(ostream& out) const {
     // AST Output: Print set statement with color
-    out << indent() << COLOR_YELLOW << "SET(" << _dec->name() << "," << COLOR_RESET << endl;
-    indent_level++;
-	_expr->print(out);
-    indent_level--;
-    out << endl << indent() << COLOR_YELLOW << ")" << COLOR_RESET;
+    out << indent(out) << COLOR_YELLOW << "SET(" << _dec->name() << "," << COLOR_RESET << endl;
+    indent_level(out)++;
+	_expr.print(out);
+    indent_level(out)--;
+    out << endl << indent(out) << COLOR_YELLOW << ")" << COLOR_RESET;
 }
 
 /**
@@ -177,25 +211,17 @@ void SetStatement::print(ostream& out) const {
  * Statement representing the assignment of a field.
  */
 
-///
-SetFieldStatement::~SetFieldStatement() {
-	delete _hi;
-	if(_hi != _lo)
-		delete _lo;
-	delete _expr;
-}
-
 void SetFieldStatement::print(ostream& out) const {
     // AST Output: Print set field statement with color
-    out << indent() << COLOR_MAGENTA << "SET_FIELD(" << _dec->name() << "," << COLOR_RESET << endl;
-    indent_level++;
-	_hi->print(out);
+    out << indent(out) << COLOR_MAGENTA << "SET_FIELD(" << _dec->name() << "," << COLOR_RESET << endl;
+    indent_level(out)++;
+	_hi.print(out);
     out << COLOR_MAGENTA << "," << COLOR_RESET << endl;
-	_lo->print(out);
+	_lo.print(out);
     out << COLOR_MAGENTA << "," << COLOR_RESET << endl;
-	_expr->print(out);
-    indent_level--;
-    out << endl << indent() << COLOR_MAGENTA << ")" << COLOR_RESET;
+	_expr.print(out);
+    indent_level(out)--;
+    out << endl << indent(out) << COLOR_MAGENTA << ")" << COLOR_RESET;
 }
 
 /**
@@ -203,25 +229,18 @@ void SetFieldStatement::print(ostream& out) const {
  * Represents an "if" statement.
  */
 
-///
-IfStatement::~IfStatement() {
-	delete _cond;
-	delete _stmt1;
-	delete _stmt2;
-}
-
 ///
 void IfStatement::print(ostream& out) const {
     // AST Output: Print if statement with color
-    out << indent() << COLOR_CYAN << "IF(" << COLOR_RESET << endl;
-    indent_level++;
+    out << indent(out) << COLOR_CYAN << "IF(" << COLOR_RESET << endl;
+    indent_level(out)++;
 	_cond->print(out);
     out << COLOR_CYAN << "," << COLOR_RESET << endl;
 	_stmt1->print(out);
     out << COLOR_CYAN << "," << COLOR_RESET << endl;
 	_stmt2->print(out);
-    indent_level--;
-    out << endl << indent() << COLOR_CYAN << ")" << COLOR_RESET;
+    indent_level(out)--;
+    out << endl << indent(out) << COLOR_CYAN << ")" << COLOR_RESET;
 }
 
 ///
@@ -239,17 +258,15 @@ void IfStatement::fix(const vector<State *>& states) {
 ///
 void GotoStatement::print(ostream& out) const {
     // AST Output: Print goto statement with color
-    out << indent() << COLOR_RED << "GOTO(" << _state->name() << ")" << COLOR_RESET;
+    out << indent(out) << COLOR_RED << "GOTO(" << _state->name() << ")" << COLOR_RESET;
 }
 
 ///
 void GotoStatement::fix(const vector<State *>& states) {
-	for(auto s: states)
-		if(s->name() == _id) {
-			_state = s;
-			return;
-		}
-	throw ParseException(pos, "unknown state " + _id + "!");
+	if(_id < states.size() && states[_id] != nullptr)
+		_state = states[_id];
+	else
+		throw ParseException(pos, "unknown state " + CompilationUnit::current()->name(_id) + "!");
 }
 
 /**
@@ -260,205 +277,253 @@ void GotoStatement::fix(const vector<State *>& states) {
 ///
 void StopStatement::print(ostream& out) const {
     // AST Output: Print stop statement with color
-    out << indent() << COLOR_WHITE << "STOP" << COLOR_RESET;
+    out << indent(out) << COLOR_WHITE << "STOP" << COLOR_RESET;
 }
 
 /****** Expressions ******/
 
-static const class NoneExpr: public Expression {
-public:
-	NoneExpr(): Expression(NONE) {}
-	void print(ostream& out) const override {
-        // AST Output: Print none expression with color
-        out << indent() << COLOR_GRAY << "NONE" << COLOR_RESET;
-	}
-	optional<value_t> eval() const override {
-		return {};
-	}
-
-	Expression *reduce() override { return this; }
-
-	Quad::reg_t gen(QuadProgram& prog) override { return 0; }
+/**
+ * @class ExprPool
+ * Pool storing the expressions of a compilation unit as a structure of arrays:
+ * each expression node is an index giving its operation, its operand indexes
+ * (children, constant or declaration) and its source line.
+ *
+ * As the parser builds the nodes bottom-up, the children of a node have always
+ * lower indexes than their parent and the nodes of a sub-expression span
+ * a contiguous range of indexes ending with its root.
+ */
 
-} expr_none;
+///
+ExprPool::ExprPool() {
+}
 
 /**
- * @class Expression
- * AST representing an expression.
+ * Add a node to the pool.
+ * @param op	Operation.
+ * @param a1	First operand.
+ * @param a2	Second operand.
+ * @param a3	Third operand.
+ * @param line	Source line.
+ * @return		Index of the node.
  */
+ExprPool::index_t ExprPool::add(op_t op, index_t a1, index_t a2, index_t a3, int line) {
+	index_t i = _ops.size();
+	_ops.push_back(op);
+	_arg1.push_back(a1);
+	_arg2.push_back(a2);
+	_arg3.push_back(a3);
+	_lines.push_back(line);
+	return i;
+}
 
 /**
- * @fn type_t Expression::type() const;
- * Get the type of the expression.
+ * Build a constant expression.
+ * @param val	Constant value.
+ * @param line	Source line.
+ * @return		Index of the node.
  */
+ExprPool::index_t ExprPool::cst(value_t val, int line) {
+	_consts.push_back(val);
+	return add(CST, _consts.size() - 1, 0, 0, line);
+}
 
 /**
- * @fn optional<long> Expression::eval() const;
- * Evaluates the expression as a constant.
- * @return 	Evaluated value or none.
+ * Build an expression accessing a memory (variable, register or constant).
+ * @param dec	Accessed declaration.
+ * @param line	Source line.
+ * @return		Index of the node.
  */
+ExprPool::index_t ExprPool::mem(Declaration *dec, int line) {
+	_decls.push_back(dec);
+	return add(MEM, _decls.size() - 1, 0, 0, line);
+}
 
 /**
- * @fn Expression *Expression::reduce();
- * Call to reduce an expession as a constant.
- * @retrun	Itself or its reduced form.
+ * Build a bit field expression (hi and lo may be the same node).
+ * @param expr	Expression to extract the field from.
+ * @param hi	Upper bit.
+ * @param lo	Lower bit.
+ * @param line	Source line.
+ * @return		Index of the node.
  */
+ExprPool::index_t ExprPool::bitfield(index_t expr, index_t hi, index_t lo, int line) {
+	return add(BITFIELD, expr, hi, lo, line);
+}
 
 /**
- * @fn Quad::reg_t Expression::gen(QuadProgram& prog);
- * Generate the quadruplets for the expression in the given program.
- * @param prog	Program to generate code in.
- * @return		Virtual register number containing the result of the expression.
+ * Build a unary operation expression.
+ * @param op	Operation (one of NEG or INV).
+ * @param arg	Argument.
+ * @param line	Source line.
+ * @return		Index of the node.
  */
+ExprPool::index_t ExprPool::unop(op_t op, index_t arg, int line) {
+	return add(op, arg, 0, 0, line);
+}
 
 /**
- * Singleton for the none expression.
+ * Build a binary operation expression.
+ * @param op	Operation (one of ADD to ROR).
+ * @param arg1	First argument.
+ * @param arg2	Second argument.
+ * @param line	Source line.
+ * @return		Index of the node.
  */
-const Expression *Expression::none = &expr_none;
+ExprPool::index_t ExprPool::binop(op_t op, index_t arg1, index_t arg2, int line) {
+	return add(op, arg1, arg2, 0, line);
+}
 
 /**
- * @class ConstExpr
- * AST for constant expressions.
+ * Get the first index of the range of a sub-expression, that is, the index
+ * of its leftmost leaf (the first node built by the parser).
+ * @param i		Root of the sub-expression.
+ * @return		First index of the sub-expression.
  */
-
-///
-void ConstExpr::print(ostream& out) const {
-    // AST Output: Print constant expression with color
-    out << indent() << COLOR_GREEN;
-    if (_val > 10000)
-		out << "CST(0x" << hex << _val << ")";
-	else
-		out << "CST(" << _val << ")";
-    out << COLOR_RESET;
+ExprPool::index_t ExprPool::first(index_t i) const {
+	while(_ops[i] != CST && _ops[i] != MEM)
+		i = _arg1[i];
+	return i;
 }
 
 /**
- * @class MemExpr
- * AST for expression accessing a memory (variable, register or constant).
+ * @fn optional<value_t> ExprPool::eval(index_t i) const;
+ * Evaluate an expression as a constant.
+ * @param i		Expression to evaluate.
+ * @return		Evaluated value or none.
  */
 
-///
-void MemExpr::print(ostream& out) const {
-    // AST Output: Print memory expression with color
-    out << indent() << COLOR_YELLOW << "MEM(" << _dec->name() << ")" << COLOR_RESET;
-}
+/**
+ * @fn void ExprPool::reduce(index_t i);
+ * Reduce in place the constant sub-expressions of an expression.
+ * @param i		Expression to reduce.
+ */
 
 /**
- * @class BitFieldExpr
- * AST to represent bit field expression.
+ * @fn Quad::reg_t ExprPool::gen(index_t i, QuadProgram& prog) const;
+ * Generate the quadruplets for an expression in the given program.
+ * @param i		Expression to generate.
+ * @param prog	Program to generate code in.
+ * @return		Virtual register number containing the result of the expression.
  */
 
-///
-BitFieldExpr::~BitFieldExpr() {
-	delete _expr;
-	delete _hi;
-	if(_hi != _lo)
-		delete _lo;
+/**
+ * Print an expression.
+ * @param i		Expression to print.
+ * @param out	Stream to output to.
+ */
+void ExprPool::print(index_t i, ostream& out) const {
+	switch(op(i)) {
+
+	case CST:
+        // AST Output: Print constant expression with color
+        out << indent(out) << COLOR_GREEN;
+        if (value(i) > 10000)
+			out << "CST(0x" << hex << value(i) << ")";
+		else
+			out << "CST(" << value(i) << ")";
+        out << COLOR_RESET;
+		break;
+
+	case MEM:
+        // AST Output: Print memory expression with color
+        out << indent(out) << COLOR_YELLOW << "MEM(" << declaration(i)->name() << ")" << COLOR_RESET;
+		break;
+
+	case BITFIELD:
+        // AST Output: Print bit field expression with color
+        out << indent(out) << COLOR_BLUE << "BITFIELD(" << COLOR_RESET << endl;
+        indent_level(out)++;
+		print(_arg1[i], out);
+        out << COLOR_BLUE << "," << COLOR_RESET << endl;
+		print(_arg2[i], out);
+        out << COLOR_BLUE << "," << COLOR_RESET << endl;
+		print(_arg3[i], out);
+        indent_level(out)--;
+        out << endl << indent(out) << COLOR_BLUE << ")" << COLOR_RESET;
+		break;
+
+	case NEG:
+	case INV:
+        // AST Output: Print unary operation expression with color
+        out << indent(out) << COLOR_MAGENTA << "UNOP(" << COLOR_RESET
+			<< (op(i) == NEG ? "NEG" : "INV");
+        out << COLOR_MAGENTA << "," << COLOR_RESET << endl;
+        indent_level(out)++;
+		print(_arg1[i], out);
+        indent_level(out)--;
+        out << endl << indent(out) << COLOR_MAGENTA << ")" << COLOR_RESET;
+		break;
+
+	default: {
+			// AST Output: Print binary operation expression with color
+			static const char *names[] = {
+				"ADD", "SUB", "MUL", "DIV", "MOD", "BIT_AND",
+				"BIT_OR", "XOR", "SHL", "SHR", "ROL", "ROR"
+			};
+			out << indent(out) << COLOR_CYAN << "BINOP(" << COLOR_RESET << names[op(i) - ADD];
+			out << COLOR_CYAN << "," << COLOR_RESET << endl;
+			indent_level(out)++;
+			print(_arg1[i], out);
+			out << COLOR_CYAN << "," << COLOR_RESET << endl;
+			print(_arg2[i], out);
+			indent_level(out)--;
+			out << endl << indent(out) << COLOR_CYAN << ")" << COLOR_RESET;
+		}
+		break;
+	}
 }
 
-///
-void BitFieldExpr::print(ostream& out) const {
-    // AST Output: Print bit field expression with color
-    out << indent() << COLOR_BLUE << "BITFIELD(" << COLOR_RESET << endl;
-    indent_level++;
-	_expr->print(out);
-    out << COLOR_BLUE << "," << COLOR_RESET << endl;
-	_hi->print(out);
-    out << COLOR_BLUE << "," << COLOR_RESET << endl;
-	_lo->print(out);
-    indent_level--;
-    out << endl << indent() << COLOR_BLUE << ")" << COLOR_RESET;
-}
 
 /**
- * @class UnopExpr
- * AST for unary operation expression.
+ * @class Expression
+ * Handle on an expression stored in an ExprPool. A default-built
+ * expression is the none expression.
  */
 
-///
-UnopExpr::~UnopExpr() {
-	delete _arg;
-}
-
-///
-void UnopExpr::print(ostream& out) const {
-    // AST Output: Print unary operation expression with color
-    out << indent() << COLOR_MAGENTA << "UNOP(" << COLOR_RESET;
-    switch (_op) {
-        case NEG:
-            out << "NEG";
-            break;
-        case INV:
-            out << "INV";
-            break;
+/**
+ * Get the type of the expression.
+ * @return	Expression type.
+ */
+Expression::type_t Expression::type() const {
+	if(_pool == nullptr)
+		return NONE;
+	switch(_pool->op(_index)) {
+	case ExprPool::CST:			return CST;
+	case ExprPool::MEM:			return MEM;
+	case ExprPool::BITFIELD:	return BITFIELD;
+	case ExprPool::NEG:
+	case ExprPool::INV:			return UNOP;
+	default:					return BINOP;
 	}
-    out << COLOR_MAGENTA << "," << COLOR_RESET << endl;
-    indent_level++;
-	_arg->print(out);
-    indent_level--;
-    out << endl << indent() << COLOR_MAGENTA << ")" << COLOR_RESET;
 }
 
 /**
- * @class BinopExpr
- * AST for binary operation expression.
+ * @fn optional<value_t> Expression::eval() const;
+ * Evaluates the expression as a constant.
+ * @return 	Evaluated value or none.
  */
 
-///
-BinopExpr::~BinopExpr() {
-	delete _arg1;
-	delete _arg2;
-}
+/**
+ * @fn void Expression::reduce();
+ * Reduce in place the constant sub-expressions of the expression.
+ */
 
-///
-void BinopExpr::print(ostream& out) const {
-    // AST Output: Print binary operation expression with color
-    out << indent() << COLOR_CYAN << "BINOP(" << COLOR_RESET;
-    switch (_op) {
-        case ADD:
-            out << "ADD";
-            break;
-        case SUB:
-            out << "SUB";
-            break;
-        case MUL:
-            out << "MUL";
-            break;
-        case DIV:
-            out << "DIV";
-            break;
-        case MOD:
-            out << "MOD";
-            break;
-        case BIT_OR:
-            out << "BIT_OR";
-            break;
-        case BIT_AND:
-            out << "BIT_AND";
-            break;
-        case XOR:
-            out << "XOR";
-            break;
-        case SHL:
-            out << "SHL";
-            break;
-        case SHR:
-            out << "SHR";
-            break;
-        case ROL:
-            out << "ROL";
-            break;
-        case ROR:
-            out << "ROR";
-            break;
-	}
-    out << COLOR_CYAN << "," << COLOR_RESET << endl;
-    indent_level++;
-	_arg1->print(out);
-    out << COLOR_CYAN << "," << COLOR_RESET << endl;
-	_arg2->print(out);
-    indent_level--;
-    out << endl << indent() << COLOR_CYAN << ")" << COLOR_RESET;
+/**
+ * @fn Quad::reg_t Expression::gen(QuadProgram& prog) const;
+ * Generate the quadruplets for the expression in the given program.
+ * @param prog	Program to generate code in.
+ * @return		Virtual register number containing the result of the expression.
+ */
+
+/**
+ * Print the expression.
+ * @param out	Stream to output to.
+ */
+void Expression::print(ostream& out) const {
+	if(_pool == nullptr)
+        out << indent(out) << COLOR_GRAY << "NONE" << COLOR_RESET;
+	else
+		_pool->print(_index, out);
 }
 
 /****** Declarations ******/
@@ -468,7 +533,7 @@ public:
 	NoneDecl(): Declaration(NONE, "") {}
 	void print(ostream& out) const override {
         // AST Output: Print none declaration with color
-        out << indent() << COLOR_GRAY << "NONE" << COLOR_RESET << endl;
+        out << indent(out) << COLOR_GRAY << "NONE" << COLOR_RESET << endl;
 	}
 } _none;
 
@@ -480,14 +545,7 @@ public:
 ///
 Declaration::Declaration(type_t type, string name)
 	: _type(type), _name(name)
-	{
-		if(getSymbol(name) != nullptr) {
-			cerr << "ERROR:" << pos << ": symbol already exists!" << endl;
-			exit(1);
-		}
-		symtab[name] = this;
-
-	}
+	{ }
 
 
 /**
@@ -496,7 +554,6 @@ Declaration::Declaration(type_t type, string name)
  */
 
 ///
-Condition::~Condition() {}
 
 /**
  * @fn void Condition::gen(Quad::lab_t lab_true, Quad::lab_t lad_false, QuadProgram& prog) const;
@@ -519,7 +576,7 @@ Condition::~Condition() {}
 ///
 void CompCond::print(ostream& out) const {
     // AST Output: Print comparison condition with color
-    out << indent() << COLOR_RED << "COMP(" << COLOR_RESET;
+    out << indent(out) << COLOR_RED << "COMP(" << COLOR_RESET;
     switch (_comp) {
         case EQ:
             out << "EQ";
@@ -541,12 +598,12 @@ void CompCond::print(ostream& out) const {
             break;
 	}
     out << COLOR_RED << "," << COLOR_RESET << endl;
-    indent_level++;
-	_arg1->print(out);
+    indent_level(out)++;
+	_arg1.print(out);
     out << COLOR_RED << "," << COLOR_RESET << endl;
-	_arg2->print(out);
-    indent_level--;
-    out << endl << indent() << COLOR_RED << ")" << COLOR_RESET;
+	_arg2.print(out);
+    indent_level(out)--;
+    out << endl << indent(out) << COLOR_RED << ")" << COLOR_RESET;
 }
 
 /**
@@ -554,20 +611,15 @@ void CompCond::print(ostream& out) const {
  * AST for a not condition.
  */
 
-///
-NotCond::~NotCond() {
-	delete _cond;
-}
-
 
 ///
 void NotCond::print(ostream& out) const {
     // AST Output: Print not condition with color
-    out << indent() << COLOR_GREEN << "NOT(" << COLOR_RESET << endl;
-    indent_level++;
+    out << indent(out) << COLOR_GREEN << "NOT(" << COLOR_RESET << endl;
+    indent_level(out)++;
 	_cond->print(out);
-    indent_level--;
-    out << endl << indent() << COLOR_GREEN << ")" << COLOR_RESET;
+    indent_level(out)--;
+    out << endl << indent(out) << COLOR_GREEN << ")" << COLOR_RESET;
 }
 
 
@@ -576,12 +628,6 @@ void NotCond::print(ostream& out) const {
  * Base class AST for binary operation condition (AND and OR);
  */
 
-///
-BinCond::~BinCond() {
-	delete _cond1;
-	delete _cond2;
-}
-
 
 /**
  * @class AndCond
@@ -590,13 +636,13 @@ BinCond::~BinCond() {
 
 void AndCond::print(ostream& out) const {
     // AST Output: Print AND condition with color
-    out << indent() << COLOR_YELLOW << "AND(" << COLOR_RESET << endl;
-    indent_level++;
+    out << indent(out) << COLOR_YELLOW << "AND(" << COLOR_RESET << endl;
+    indent_level(out)++;
 	_cond1->print(out);
     out << COLOR_YELLOW << "," << COLOR_RESET << endl;
 	_cond2->print(out);
-    indent_level--;
-    out << endl << indent() << COLOR_YELLOW << ")" << COLOR_RESET;
+    indent_level(out)--;
+    out << endl << indent(out) << COLOR_YELLOW << ")" << COLOR_RESET;
 }
 
 /**
@@ -606,13 +652,13 @@ void AndCond::print(ostream& out) const {
 
 void OrCond::print(ostream& out) const {
     // AST Output: Print OR condition with color
-    out << indent() << COLOR_BLUE << "OR(" << COLOR_RESET << endl;
-    indent_level++;
+    out << indent(out) << COLOR_BLUE << "OR(" << COLOR_RESET << endl;
+    indent_level(out)++;
 	_cond1->print(out);
     out << COLOR_BLUE << "," << COLOR_RESET << endl;
 	_cond2->print(out);
-    indent_level--;
-    out << endl << indent() << COLOR_BLUE << ")" << COLOR_RESET;
+    indent_level(out)--;
+    out << endl << indent(out) << COLOR_BLUE << ")" << COLOR_RESET;
 }
 
 
@@ -634,33 +680,6 @@ void Declaration::reduce() {
 /** Empty declaration. */
 Declaration& Declaration::none = _none;
 
-/**
- * Get a symbol from the symbol table.
- * @param name	Name of the looked symbol.
- * @return		Found symbol or a null pointer.
- */
-Declaration *Declaration::getSymbol(string name) {
-	auto r = symtab.find(name);
-	if(r == symtab.end())
-		return nullptr;
-	else
-		return (*r).second;
-}
-
-/**
- * Retrieve the symbol table.
- */
-const map<string, Declaration *>& Declaration::symbols() {
-	return symtab;
-}
-
-void Declaration::clearSymTab() {
-	for(auto s: symtab) {
-		if(s.second != &none)
-			delete s.second;
-	}
-}
-
 
 /**
  * @class ConstDecl
@@ -670,7 +689,7 @@ void Declaration::clearSymTab() {
 ///
 void ConstDecl::print(ostream& out) const {
     // AST Output: Print constant declaration with color
-    out << indent() << COLOR_GREEN << name() << ": CONST(" << _val << ")" << COLOR_RESET << endl;
+    out << indent(out) << COLOR_GREEN << name() << ": CONST(" << _val << ")" << COLOR_RESET << endl;
 }
 
 
@@ -682,7 +701,7 @@ void ConstDecl::print(ostream& out) const {
 ///
 void VarDecl::print(ostream& out) const {
     // AST Output: Print variable declaration with color
-    out << indent() << COLOR_YELLOW << name() << ": VAR" << COLOR_RESET << endl;
+    out << indent(out) << COLOR_YELLOW << name() << ": VAR" << COLOR_RESET << endl;
 }
 
 
@@ -694,7 +713,7 @@ void VarDecl::print(ostream& out) const {
 ///
 void RegDecl::print(ostream& out) const {
     // AST Output: Print register declaration with color
-    out << indent() << COLOR_BLUE << name() << ": REG(0x" << hex << _addr << ")" << COLOR_RESET << endl;
+    out << indent(out) << COLOR_BLUE << name() << ": REG(0x" << hex << _addr << ")" << COLOR_RESET << endl;
 }
 
 
@@ -706,7 +725,7 @@ void RegDecl::print(ostream& out) const {
 ///
 void SigDecl::print(ostream& out) const {
     // AST Output: Print signal declaration with color
-    out << indent() << COLOR_MAGENTA << name() << ": SIG(" << _reg->name() << ", " << _bit << ")" << COLOR_RESET << endl;
+    out << indent(out) << COLOR_MAGENTA << name() << ": SIG(" << _reg->name() << ", " << _bit << ")" << COLOR_RESET << endl;
 }
 
 
@@ -715,25 +734,18 @@ void SigDecl::print(ostream& out) const {
  * Declaration for an automaton.
  */
 
-///
-AutoDecl::~AutoDecl() {
-	delete _init;
-	for(auto s: _states)
-		delete s;
-}
-
 ///
 void AutoDecl::print(ostream& out) const {
     // AST Output: Print automaton declaration with color
-    out << indent() << COLOR_CYAN << name() << ": AUTO" << COLOR_RESET << endl;
-    indent_level++;
+    out << indent(out) << COLOR_CYAN << name() << ": AUTO" << COLOR_RESET << endl;
+    indent_level(out)++;
     _init->print(out);
     out << endl;
     for (auto s : _states) {
 		s->print(out);
         out << endl;
     }
-    indent_level--;
+    indent_level(out)--;
 }
 
 ///
@@ -749,13 +761,6 @@ void AutoDecl::reduce() {
  * State in an automaton.
  */
 
-///
-State::~State() {
-	delete _action;
-	for(auto w: _whens)
-		delete w;
-}
-
 /**
  * Set the label to branch to implement the state.
  * @param label	Label to set.
@@ -768,15 +773,15 @@ void State::setLabel(Quad::lab_t label) {
 ///
 void State::print(ostream& out) const {
     // AST Output: Print state with color
-    out << indent() << COLOR_RED << "STATE " << name() << ":" << COLOR_RESET << endl;
-    indent_level++;
+    out << indent(out) << COLOR_RED << "STATE " << name() << ":" << COLOR_RESET << endl;
+    indent_level(out)++;
     _action->print(out);
     out << endl;
     for (auto w : _whens) {
 		w->print(out);
         out << endl;
     }
-    indent_level--;
+    indent_level(out)--;
 }
 
 ///
@@ -804,13 +809,13 @@ void State::fix(const vector<State *>& states) {
 ///
 void When::print(ostream& out) const {
     // AST Output: Print when condition with color
-    out << indent() << COLOR_GREEN << "WHEN " << COLOR_RESET;
+    out << indent(out) << COLOR_GREEN << "WHEN " << COLOR_RESET;
     if (_neg)
 		out << "!";
 	out << _sig->name() << ":" << endl;
-    indent_level++;
+    indent_level(out)++;
 	_action->print(out);
-    indent_level--;
+    indent_level(out)--;
 }
 
 /**
@@ -1,6 +1,7 @@
 #ifndef IOC_AST_CPP
 #define IOC_AST_CPP
 
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <optional>
@@ -8,6 +9,7 @@
 #include <vector>
 
 #include "Quad.hpp"
+#include "SymbolTable.hpp"
 
 using namespace std;
 
@@ -15,6 +17,8 @@ typedef unsigned long value_t;
 
 class AutoDecl;
 class Expression;
+class Hash;
+class ThreadPool;
 class Statement;
 class Condition;
 class Declaration;
@@ -25,6 +29,7 @@ class Position {
 public:
 	Position();
 	Position(int line);
+	inline Position(const char *file_, int line_): file(file_), line(line_) {}
 	const char *file;
 	int line;
 	inline string to_str() const { return string(file) + ":" + to_string(line); }
@@ -34,7 +39,10 @@ ostream& operator<<(ostream& out, const Position& pos);
 
 class AST {
 public:
+	AST();
 	virtual ~AST() { }
+	static void *operator new(size_t size);
+	static void operator delete(void *p) { }
 	virtual void print(ostream& out) const = 0;
 	void setLine(int line) { pos.line = line; }
 	Position pos;
@@ -52,13 +60,104 @@ private:
 };
 
 
+/****** Expressions ******/
+
+class ExprPool {
+public:
+	typedef uint32_t index_t;
+	typedef enum {
+		CST,
+		MEM,
+		BITFIELD,
+		NEG,
+		INV,
+		ADD,
+		SUB,
+		MUL,
+		DIV,
+		MOD,
+		BIT_AND,
+		BIT_OR,
+		XOR,
+		SHL,
+		SHR,
+		ROL,
+		ROR
+	} op_t;
+
+	ExprPool();
+	index_t cst(value_t val, int line);
+	index_t mem(Declaration *dec, int line);
+	index_t bitfield(index_t expr, index_t hi, index_t lo, int line);
+	index_t unop(op_t op, index_t arg, int line);
+	index_t binop(op_t op, index_t arg1, index_t arg2, int line);
+
+	inline size_t size() const { return _ops.size(); }
+	inline op_t op(index_t i) const { return op_t(_ops[i]); }
+	inline index_t arg1(index_t i) const { return _arg1[i]; }
+	inline index_t arg2(index_t i) const { return _arg2[i]; }
+	inline index_t arg3(index_t i) const { return _arg3[i]; }
+	inline int line(index_t i) const { return _lines[i]; }
+	inline value_t value(index_t i) const { return _consts[_arg1[i]]; }
+	inline Declaration *declaration(index_t i) const { return _decls[_arg1[i]]; }
+
+	optional<value_t> eval(index_t i) const;
+	void reduce(index_t i);
+	Quad::reg_t gen(index_t i, QuadProgram& prog) const;
+	void hash(index_t i, QuadProgram& prog, Hash& h) const;
+	void print(index_t i, ostream& out) const;
+
+private:
+	index_t add(op_t op, index_t a1, index_t a2, index_t a3, int line);
+	index_t first(index_t i) const;
+	void fold(index_t i);
+	Quad::reg_t genBitField(index_t i, QuadProgram& prog) const;
+
+	vector<uint8_t> _ops;
+	vector<index_t> _arg1, _arg2, _arg3;
+	vector<int> _lines;
+	vector<value_t> _consts;
+	vector<Declaration *> _decls;
+};
+
+class Expression {
+public:
+
+	typedef enum {
+		NONE,
+		CST,
+		MEM,
+		BITFIELD,
+		UNOP,
+		BINOP
+	} type_t;
+
+	inline Expression(): _pool(nullptr), _index(0) { }
+	inline Expression(ExprPool& pool, ExprPool::index_t index): _pool(&pool), _index(index) { }
+	type_t type() const;
+	inline ExprPool::index_t index() const { return _index; }
+	inline Position pos() const { return Position(_pool == nullptr ? 0 : _pool->line(_index)); }
+	inline optional<value_t> eval() const
+		{ if(_pool == nullptr) return {}; else return _pool->eval(_index); }
+	inline void reduce() { if(_pool != nullptr) _pool->reduce(_index); }
+	inline Quad::reg_t gen(QuadProgram& prog) const
+		{ return _pool == nullptr ? 0 : _pool->gen(_index, prog); }
+	void hash(QuadProgram& prog, Hash& h) const;
+	void print(ostream& out) const;
+
+private:
+	ExprPool *_pool;
+	ExprPool::index_t _index;
+};
+
+
 /****** Statements ******/
 
 class Statement: public AST {
 public:
 	typedef enum {
 		NOP,
-		SEQ,
+		BLOCK,
 		SET,
 		SET_FIELD,
 		IF,
@@ -66,12 +165,13 @@ public:
 		STOP
 	} type_t;
 
-	inline Statement(type_t type) {}
+	inline Statement(type_t type): _type(type) {}
 	virtual ~Statement() {}
 	virtual void fix(const vector<State *>& states);
 	inline type_t type() const { return _type; }
 	virtual void reduce() = 0;
 	virtual void gen(AutoDecl& automaton, QuadProgram& prog) const = 0;
+	virtual void hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const = 0;
 
 private:
 	type_t _type;
@@ -84,56 +184,58 @@ public:
 	void print(ostream& out) const override;
 	void reduce() override;
 	void gen(AutoDecl& automaton, QuadProgram& prog) const override;
+	void hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const override;
 };
 
-class SeqStatement: public Statement {
+class BlockStatement: public Statement {
 public:
-	SeqStatement(Statement *stmt1, Statement *stmt2)
-		: Statement(SEQ), _stmt1(stmt1), _stmt2(stmt2) {}
-	~SeqStatement();
+	inline BlockStatement(): Statement(BLOCK) {}
+	inline void add(Statement *stmt) { _stmts.push_back(stmt); }
+	inline const vector<Statement *>& statements() const { return _stmts; }
 	void print(ostream& out) const override;
 	void fix(const vector<State *>& states) override;
 	void reduce() override;
 	void gen(AutoDecl& automaton, QuadProgram& prog) const override;
+	void hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const override;
 private:
-	Statement *_stmt1, *_stmt2;
+	vector<Statement *> _stmts;
 };
 
 class SetStatement: public Statement {
 public:
-	inline SetStatement(Declaration *dec, Expression *expr)
+	inline SetStatement(Declaration *dec, Expression expr)
 		: Statement(SET), _dec(dec), _expr(expr) {}
-	~SetStatement();
 	void print(ostream& out) const override;
 	void reduce() override;
 	void gen(AutoDecl& automaton, QuadProgram& prog) const override;
+	void hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const override;
 private:
 	Declaration *_dec;
-	Expression *_expr;
+	Expression _expr;
 };
 
 class SetFieldStatement: public Statement {
 public:
-	inline SetFieldStatement(Declaration *dec, Expression *hi, Expression *lo, Expression *expr)
+	inline SetFieldStatement(Declaration *dec, Expression hi, Expression lo, Expression expr)
 		: Statement(SET_FIELD), _dec(dec), _hi(hi), _lo(lo),  _expr(expr) {}
-	~SetFieldStatement();
 	void print(ostream& out) const override;
 	void reduce() override;
 	void gen(AutoDecl& automaton, QuadProgram& prog) const override;
+	void hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const override;
 private:
 	Declaration *_dec;
-	Expression *_hi, *_lo, *_expr;
+	Expression _hi, _lo, _expr;
 };
 
 class IfStatement: public Statement {
 public:
 	inline IfStatement(Condition *cond, Statement *stmt1, Statement *stmt2)
 		: Statement(IF), _cond(cond), _stmt1(stmt1), _stmt2(stmt2) { }
-	~IfStatement();
 	void print(ostream& out) const override;
 	void fix(const vector<State *>& states) override;
 	void reduce() override;
 	void gen(AutoDecl& automaton, QuadProgram& prog) const override;
+	void hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const override;
 
 private:
 	Condition *_cond;
@@ -142,13 +244,14 @@ private:
 
 class GotoStatement: public Statement {
 public:
-	inline GotoStatement(string id): Statement(GOTO), _id(id), _state(nullptr) {}
+	inline GotoStatement(SymbolTable::id_t id): Statement(GOTO), _id(id), _state(nullptr) {}
 	void print(ostream& out) const override;
 	void fix(const vector<State *>& states) override;
 	void reduce() override;
 	void gen(AutoDecl& automaton, QuadProgram& prog) const override;
+	void hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const override;
 private:
-	string _id;
+	SymbolTable::id_t _id;
 	State *_state;
 };
 
@@ -158,119 +261,7 @@ public:
 	void print(ostream& out) const  override;
 	void reduce() override;
 	void gen(AutoDecl& automaton, QuadProgram& prog) const override;
-};
-
-
-/****** Expressions ******/
-
-class Expression: public AST {
-public:
-
-	typedef enum {
-		NONE,
-		CST,
-		MEM,
-		BITFIELD,
-		UNOP,
-		BINOP
-	} type_t;
-
-	inline Expression(type_t type): _type(type) { }
-	virtual ~Expression() {}
-	inline type_t type() const { return _type; }
-	virtual optional<value_t> eval() const = 0;
-	virtual Expression *reduce() = 0;
-	virtual Quad::reg_t gen(QuadProgram& prog) = 0;
-
-	static const Expression *none;
-private:
-	type_t _type;
-};
-
-class ConstExpr: public Expression {
-public:
-	inline ConstExpr(value_t val)
-		: Expression(CST), _val(val) {}
-	inline value_t value() const { return _val; }
-	void print(ostream& out) const override;
-	optional<value_t> eval() const override;
-	Expression *reduce() override;
-	Quad::reg_t gen(QuadProgram& prog) override;
-
-private:
-	value_t _val;
-};
-
-class MemExpr: public Expression {
-public:
-	inline MemExpr(Declaration *dec): Expression(MEM), _dec(dec) { }
-	void print(ostream& out) const override;
-	optional<value_t> eval() const override;
-	Expression *reduce() override;
-	Quad::reg_t gen(QuadProgram& prog) override;
-private:
-	Declaration *_dec;
-};
-
-class BitFieldExpr: public Expression {
-public:
-	inline BitFieldExpr(Expression *expr, Expression *hi, Expression *lo)
-		: Expression(BITFIELD), _expr(expr), _hi(hi), _lo(lo) { }
-	~BitFieldExpr();
-	void print(ostream& out) const override;
-	optional<value_t> eval() const override;
-	Expression *reduce() override;
-	Quad::reg_t gen(QuadProgram& prog) override;
-private:
-	Expression *_expr, *_hi, *_lo;
-};
-
-class UnopExpr: public Expression {
-public:
-	typedef enum {
-		NEG,
-		INV
-	} unop_t;
-
-	inline UnopExpr(unop_t op, Expression *arg)
-		: Expression(UNOP), _op(op), _arg(arg) {}
-	~UnopExpr();
-	void print(ostream& out) const override;
-	optional<value_t> eval() const override;
-	Expression *reduce() override;
-	Quad::reg_t gen(QuadProgram& prog) override;
-private:
-	unop_t _op;
-	Expression *_arg;
-};
-
-class BinopExpr: public Expression {
-public:
-	typedef enum {
-		ADD,
-		SUB,
-		MUL,
-		DIV,
-		MOD,
-		BIT_AND,
-		BIT_OR,
-		XOR,
-		SHL,
-		SHR,
-		ROL,
-		ROR
-	} op_t;
-
-	inline BinopExpr(op_t op, Expression *arg1, Expression *arg2)
-		: Expression(BINOP), _op(op), _arg1(arg1), _arg2(arg2) {}
-	~BinopExpr();
-	void print(ostream& out) const override;
-	optional<value_t> eval() const override;
-	Expression *reduce() override;
-	Quad::reg_t gen(QuadProgram& prog) override;
-private:
-	op_t _op;
-	Expression *_arg1, *_arg2;
+	void hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const override;
 };
 
 
@@ -286,10 +277,10 @@ public:
 	} type_t;
 
 	inline Condition(type_t type): _type(type) {}
-	~Condition();
 	inline type_t type() const { return _type; }
 	virtual void reduce() = 0;
 	virtual void gen(Quad::lab_t lab_true, Quad::lab_t lad_false, QuadProgram& prog) const = 0;
+	virtual void hash(QuadProgram& prog, Hash& h) const = 0;
 private:
 	type_t _type;
 };
@@ -305,25 +296,26 @@ public:
 		GE
 	} comp_t;
 
-	inline CompCond(comp_t comp, Expression *arg1, Expression *arg2)
+	inline CompCond(comp_t comp, Expression arg1, Expression arg2)
 		: Condition(COMP), _comp(comp), _arg1(arg1), _arg2(arg2) { }
 	void print(ostream& out) const override;
 	void reduce() override;
 	void gen(Quad::lab_t lab_true, Quad::lab_t lab_false, QuadProgram& prog) const override;
+	void hash(QuadProgram& prog, Hash& h) const override;
 
 private:
 	comp_t _comp;
-	Expression *_arg1, *_arg2;
+	Expression _arg1, _arg2;
 };
 
 
 class NotCond: public Condition {
 public:
 	inline NotCond(Condition *cond): Condition(NOT), _cond(cond) {}
-	~NotCond();
 	void print(ostream& out) const override;
 	void reduce() override;
 	void gen(Quad::lab_t lab_true, Quad::lab_t lab_false, QuadProgram& prog) const override;
+	void hash(QuadProgram& prog, Hash& h) const override;
 private:
 	Condition *_cond;
 };
@@ -333,8 +325,8 @@ class BinCond: public Condition {
 public:
 	inline BinCond(type_t type, Condition *cond1, Condition *cond2)
 		: Condition(type), _cond1(cond1), _cond2(cond2) { }
-	~BinCond();
 	void reduce() override;
+	void hash(QuadProgram& prog, Hash& h) const override;
 protected:
 	Condition *_cond1, *_cond2;
 };
@@ -375,9 +367,6 @@ public:
 	virtual void reduce();
 
 	static Declaration& none;
-	static Declaration *getSymbol(string name);
-	static const map<string, Declaration *>& symbols();
-	static void clearSymTab();
 
 private:
 	type_t _type;
@@ -434,6 +423,7 @@ public:
 	void fix(const vector<State *>& states);
 	void reduce();
 	void gen(AutoDecl& automaton, QuadProgram& prog);
+	void hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const;
 private:
 	bool _neg;
 	SigDecl *_sig;
@@ -444,7 +434,6 @@ class State: public AST {
 public:
 	inline State(string name, Statement *action, const vector<When *> whens)
 		: _name(name), _action(action), _whens(whens) { }
-	~State();
 	inline string name() const { return _name; }
 	inline Statement *action() const { return _action; }
 	inline const vector<When *>& whens() const { return _whens; }
@@ -452,6 +441,7 @@ public:
 	void fix(const vector<State *>& states);
 	void reduce();
 	void gen(AutoDecl& automaton, QuadProgram& prog);
+	void hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const;
 	inline Quad::lab_t label() const { return _label; }
 	void setLabel(Quad::lab_t label);
 private:
@@ -466,10 +456,13 @@ class AutoDecl: public Declaration {
 public:
 	inline AutoDecl(string name, Statement *init, const vector<State *>& states)
 		: Declaration(AUTO, name), _init(init), _states(states) { }
-	~AutoDecl();
 	void print(ostream& out) const override;
 	void reduce() override;
-	void gen(QuadProgram& prog);
+	void gen(QuadProgram& prog, ThreadPool *pool = nullptr);
+	void genPrologue(QuadProgram& prog);
+	void genEpilogue(QuadProgram& prog);
+	inline Statement *init() const { return _init; }
+	inline const vector<State *>& states() const { return _states; }
 	inline Quad::lab_t stopLabel() const { return _stop_label; }
 private:
 	Statement *_init;
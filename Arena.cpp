@@ -0,0 +1,84 @@
+#include <cstdlib>
+#include <new>
+#include "Arena.hpp"
+
+/**
+ * @class Arena
+ * Bump allocator: memory is taken from big chunks by simply moving
+ * a pointer forward and is only given back all at once, when the arena
+ * is released or destroyed. Destructors of the objects built in the arena
+ * are not called by the arena itself.
+ */
+
+/**
+ * Build an arena.
+ * @param chunk_size	Size of the chunks obtained from the system.
+ */
+Arena::Arena(size_t chunk_size):
+	_chunk_size(chunk_size),
+	_top(nullptr),
+	_end(nullptr),
+	_count(0),
+	_size(0)
+{ }
+
+///
+Arena::~Arena() {
+	release();
+}
+
+/**
+ * @fn void *Arena::allocate(size_t size);
+ * Allocate a block in the arena.
+ * @param size	Size of the block (in bytes).
+ * @return		Allocated block, aligned on Arena::alignment.
+ */
+
+/**
+ * Allocate a block that does not fit in the current chunk.
+ * Big blocks get their own chunk so that the current one is not wasted.
+ * @param size	Size of the block (already aligned).
+ * @return		Allocated block.
+ */
+void *Arena::grow(size_t size) {
+	size_t csize = size > _chunk_size / 4 ? size : _chunk_size;
+	char *chunk = static_cast<char *>(malloc(csize));
+	if(chunk == nullptr)
+		throw bad_alloc();
+	_chunks.push_back(chunk);
+	if(csize == _chunk_size) {
+		_top = chunk + size;
+		_end = chunk + csize;
+	}
+	_size += size;
+	_count++;
+	return chunk;
+}
+
+/**
+ * Give back all the memory of the arena to the system.
+ */
+void Arena::release() {
+	for(auto c: _chunks)
+		free(c);
+	_chunks.clear();
+	_top = nullptr;
+	_end = nullptr;
+	_count = 0;
+	_size = 0;
+}
+
+/**
+ * @fn size_t Arena::count() const;
+ * Get the number of blocks allocated in the arena.
+ */
+
+/**
+ * @fn size_t Arena::size() const;
+ * Get the number of bytes allocated in the arena.
+ */
+
+/**
+ * @fn size_t Arena::chunks() const;
+ * Get the number of chunks obtained from the system.
+ */
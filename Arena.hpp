@@ -0,0 +1,42 @@
+#ifndef IOC_ARENA_HPP
+#define IOC_ARENA_HPP
+
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+class Arena {
+public:
+	static constexpr size_t default_chunk = 64 * 1024;
+	static constexpr size_t alignment = alignof(max_align_t);
+
+	Arena(size_t chunk_size = default_chunk);
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+	~Arena();
+
+	inline void *allocate(size_t size) {
+		size = (size + alignment - 1) & ~(alignment - 1);
+		if(size > size_t(_end - _top))
+			return grow(size);
+		void *p = _top;
+		_top += size;
+		_size += size;
+		_count++;
+		return p;
+	}
+	void release();
+
+	inline size_t count() const { return _count; }
+	inline size_t size() const { return _size; }
+	inline size_t chunks() const { return _chunks.size(); }
+
+private:
+	void *grow(size_t size);
+	size_t _chunk_size;
+	vector<char *> _chunks;
+	char *_top, *_end;
+	size_t _count, _size;
+};
+
+#endif	// IOC_ARENA_HPP
@@ -1,13 +1,42 @@
 #ifndef IOC_CFG_HPP
 #define IOC_CFG_HPP
 
+#include <cstddef>
 #include <list>
 #include <iostream>
+#include <vector>
 using namespace std;
 
+template <class T>
+class Slice {
+public:
+	typedef const T *const_iterator;
+	inline Slice(): _begin(nullptr), _end(nullptr) {}
+	inline Slice(const T *begin, const T *end): _begin(begin), _end(end) {}
+	inline const T *begin() const { return _begin; }
+	inline const T *end() const { return _end; }
+	inline size_t size() const { return _end - _begin; }
+	inline bool empty() const { return _begin == _end; }
+	inline const T& front() const { return *_begin; }
+	inline const T& back() const { return _end[-1]; }
+private:
+	const T *_begin, *_end;
+};
+
+template <class T>
+class CFG;
+
+template <class T>
+class BBStorage {
+public:
+	typedef vector<T> insts_t;
+};
+
 template <class T>
 class BB {
+	friend class CFG<T>;
 public:
+	typedef typename BBStorage<T>::insts_t insts_t;
 
 	inline BB(): _next(nullptr), _target(nullptr), _number(-1) {}
 
@@ -18,7 +47,7 @@ public:
 			_target->removePred(this);
 	}
 
-	inline const list<T>& instructions() const { return _insts; }
+	inline const insts_t& instructions() const { return _insts; }
 	inline const list<BB<T> *>& predecessors() const { return _preds; }
 	inline BB<T> *next() const { return _next; }
 	inline BB<T> *target() const { return _target; }
@@ -38,13 +67,14 @@ public:
 		_target = bb;
 	}
 
-	inline void setInstructions(const list<T>& insts) { _insts = insts; }
+	inline void setInstructions(const insts_t& insts) { _insts = insts; }
+	inline void setInstructions(insts_t&& insts) { _insts = move(insts); }
 
 	inline void setNumber(int n) { _number = n; }
 
 	void print(ostream& out) {
 		out << "BB " << _number << ":" << endl;
-		for(auto i: _insts)
+		for(const auto& i: _insts)
 			out << '\t' << i << endl;
 	}
 
@@ -58,7 +88,7 @@ private:
 			}
 	}
 
-	list<T> _insts;
+	insts_t _insts;
 	list<BB<T> *> _preds;
 	BB<T> *_next, *_target;
 	int _number;
@@ -73,6 +103,16 @@ class CFG {
 public:
 
 	inline CFG() { add(&_entry); add(&_exit); }
+	CFG(const CFG&) = delete;
+	CFG& operator=(const CFG&) = delete;
+
+	~CFG() {
+		for(auto bb: _bbs)
+			bb->_next = bb->_target = nullptr;
+		for(auto bb: _bbs)
+			if(bb != &_entry && bb != &_exit)
+				delete bb;
+	}
 
 	inline BB<T> *entry() { return &_entry; }
 	inline BB<T> *exit() { return &_exit; }
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "Cache.hpp"
+#include "CompilationUnit.hpp"
+#include "Hash.hpp"
+#include "Scanner.hpp"
+#include "Source.hpp"
+#include "parser.hpp"
+
+/**
+ * @class Cache
+ * Content-addressed on-disk cache of the compilation results. An entry
+ * records the prints and the assembly output by a successful compilation
+ * and is named after a 128-bit key (32 hexadecimal digits) hashing:
+ * @li the normalized source, that is, its token stream with the line of
+ * each token (comments and blanks inside a line are not significant),
+ * @li the same for the imported sources, recursively,
+ * @li the options changing the output,
+ * @li the identity of the compiler (format version, size and modification
+ * time of the executable).
+ *
+ * An entry is made of a header (magic "IOCC", format version, sizes of
+ * the two texts) followed by the texts. Entries are written atomically
+ * (see Source::write()) and the cache is bounded in size: when an entry
+ * is added, the least recently used entries (the ones with the oldest
+ * modification time, updated at each hit) are removed.
+ */
+
+/**
+ * Create a directory and its missing parents.
+ * @param path	Directory path.
+ * @return		True for success, false else.
+ */
+static bool makeDirs(const string& path) {
+	for(size_t p = path.find('/', 1); ; p = path.find('/', p + 1)) {
+		string dir = path.substr(0, p);
+		if(mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST)
+			return false;
+		if(p == string::npos)
+			return true;
+	}
+}
+
+/**
+ * Test if a file name is a cache key.
+ * @param name	File name.
+ * @return		True if it is made of 32 hexadecimal digits.
+ */
+static bool isKey(const char *name) {
+	size_t n = 0;
+	for(; name[n] != '\0'; n++)
+		if(!((name[n] >= '0' && name[n] <= '9') || (name[n] >= 'a' && name[n] <= 'f')))
+			return false;
+	return n == 32;
+}
+
+
+/**
+ * Build a cache.
+ * @param dir	Directory of the cache (created if needed).
+ * @param size	Maximal size of the entries in bytes.
+ */
+Cache::Cache(const string& dir, size_t size): _dir(dir), _size(size) {
+	while(_dir.size() > 1 && _dir.back() == '/')
+		_dir.pop_back();
+	makeDirs(_dir);
+}
+
+/**
+ * Compute the key of a compilation.
+ * @param source	Path of the compiled source.
+ * @param flags		Options changing the output (see Options::signature()).
+ * @return			Key or an empty string if the source cannot be cached
+ * 					(standard input, unreadable or erroneous source).
+ */
+string Cache::key(const string& source, const string& flags) const {
+	if(source == "")
+		return "";
+	Hash h;
+	h.add(version);
+	Module::Stamp exe;
+	if(exe.get("/proc/self/exe")) {
+		h.add(exe.size);
+		h.add(exe.mtime);
+	}
+	h.add(flags);
+	set<string> done;
+	if(!hashSource(source, done, h))
+		return "";
+	return h.str();
+}
+
+/**
+ * Hash the token stream of a source and of the sources it imports.
+ * @param path	Path of the source.
+ * @param done	Sources already hashed (hashed only once).
+ * @param h		Hash to update.
+ * @return		True for success, false if a source cannot be read or scanned.
+ */
+bool Cache::hashSource(const string& path, set<string>& done, Hash& h) const {
+	h.add(path);
+	if(!done.insert(path).second)
+		return true;
+	Source text;
+	if(!text.open(path))
+		return false;
+	CompilationUnit unit(path);
+	Scanner scanner(unit, text);
+	YYSTYPE val;
+	try {
+		int prev = 0;
+		while(true) {
+			int token = scanner.next(&val);
+			if(token == 0)
+				break;
+			h.add(uint64_t(token) << 32 | uint32_t(unit.line()));
+			if(token == ID)
+				h.add(unit.name(val.ID));
+			else if(token == INT)
+				h.add(uint64_t(val.INT));
+			else if(token == STRING) {
+				string name = unit.name(val.STRING);
+				h.add(name);
+				if(prev == IMPORT) {
+					auto p = path.rfind('/');
+					if(name[0] != '/' && p != string::npos)
+						name = path.substr(0, p + 1) + name;
+					if(!hashSource(name, done, h))
+						return false;
+				}
+			}
+			prev = token;
+		}
+	}
+	catch(const ParseException& e) {
+		return false;
+	}
+	h.add(uint64_t(0));
+	return true;
+}
+
+/**
+ * Get the path of the file of an entry.
+ * @param key	Entry key.
+ * @return		Entry path.
+ */
+string Cache::pathOf(const string& key) const {
+	return _dir + "/" + key;
+}
+
+/**
+ * Look for an entry. A found entry becomes the most recently used one.
+ * @param key		Entry key.
+ * @param out		To store the prints in.
+ * @param asm_out	To store the assembly in.
+ * @return			True if the entry is found, false else.
+ */
+bool Cache::get(const string& key, string& out, string& asm_out) const {
+	string path = pathOf(key);
+	Source file;
+	if(!file.open(path) || file.size() < 24
+	|| memcmp(file.data(), "IOCC", 4) != 0)
+		return false;
+	uint32_t v;
+	uint64_t out_size, asm_size;
+	memcpy(&v, file.data() + 4, 4);
+	memcpy(&out_size, file.data() + 8, 8);
+	memcpy(&asm_size, file.data() + 16, 8);
+	if(v != version || out_size > file.size() - 24 || asm_size != file.size() - 24 - out_size)
+		return false;
+	out.assign(file.data() + 24, out_size);
+	asm_out.assign(file.data() + 24 + out_size, asm_size);
+	utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+	return true;
+}
+
+/**
+ * Add an entry then evict the least recently used entries if the cache
+ * is too big.
+ * @param key		Entry key.
+ * @param out		Prints of the compilation.
+ * @param asm_out	Assembly of the compilation.
+ * @return			True for success, false else.
+ */
+bool Cache::put(const string& key, const string& out, const string& asm_out) const {
+	uint32_t v = version;
+	uint64_t out_size = out.size(), asm_size = asm_out.size();
+	string data("IOCC", 4);
+	data.append(reinterpret_cast<const char *>(&v), 4);
+	data.append(reinterpret_cast<const char *>(&out_size), 8);
+	data.append(reinterpret_cast<const char *>(&asm_size), 8);
+	data += out;
+	data += asm_out;
+	if(!Source::write(pathOf(key), data))
+		return false;
+	evict();
+	return true;
+}
+
+/**
+ * Remove the least recently used entries until the total size of
+ * the entries fits in the cache size.
+ */
+void Cache::evict() const {
+	class File {
+	public:
+		int64_t mtime;
+		size_t size;
+		string path;
+	};
+	DIR *dir = opendir(_dir.c_str());
+	if(dir == nullptr)
+		return;
+	vector<File> files;
+	size_t total = 0;
+	for(auto e = readdir(dir); e != nullptr; e = readdir(dir)) {
+		if(!isKey(e->d_name))
+			continue;
+		string path = pathOf(e->d_name);
+		struct stat st;
+		if(stat(path.c_str(), &st) < 0)
+			continue;
+		files.push_back({ int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec, size_t(st.st_size), path });
+		total += st.st_size;
+	}
+	closedir(dir);
+	if(total <= _size)
+		return;
+	sort(files.begin(), files.end(),
+		[](const File& f1, const File& f2) { return f1.mtime < f2.mtime; });
+	for(const auto& f: files) {
+		if(total <= _size)
+			break;
+		unlink(f.path.c_str());
+		total -= f.size;
+	}
+}
+
+/**
+ * Get the default directory of the cache: $IOC_CACHE_DIR, else
+ * $XDG_CACHE_HOME/ioc, else $HOME/.cache/ioc.
+ * @return	Default directory or an empty string if there is none.
+ */
+string Cache::defaultDir() {
+	const char *d = getenv("IOC_CACHE_DIR");
+	if(d != nullptr && *d != '\0')
+		return d;
+	d = getenv("XDG_CACHE_HOME");
+	if(d != nullptr && *d != '\0')
+		return string(d) + "/ioc";
+	d = getenv("HOME");
+	if(d != nullptr && *d != '\0')
+		return string(d) + "/.cache/ioc";
+	return "";
+}
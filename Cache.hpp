@@ -0,0 +1,35 @@
+#ifndef IOC_CACHE_HPP
+#define IOC_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+using namespace std;
+
+class Hash;
+
+class Cache {
+public:
+	static constexpr uint32_t version = 1;
+	static constexpr size_t default_size = 64 << 20;
+
+	Cache(const string& dir, size_t size = default_size);
+	inline const string& directory() const { return _dir; }
+	inline size_t size() const { return _size; }
+
+	string key(const string& source, const string& flags) const;
+	bool get(const string& key, string& out, string& asm_out) const;
+	bool put(const string& key, const string& out, const string& asm_out) const;
+	void evict() const;
+
+	static string defaultDir();
+
+private:
+	bool hashSource(const string& path, set<string>& done, Hash& h) const;
+	string pathOf(const string& key) const;
+	string _dir;
+	size_t _size;
+};
+
+#endif	// IOC_CACHE_HPP
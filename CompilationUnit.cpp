@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unistd.h>
+#include "CompilationUnit.hpp"
+#include "Lexer.hpp"
+
+/**
+ * Unit currently parsed or compiled by this thread.
+ */
+static thread_local CompilationUnit *current_unit = nullptr;
+
+/**
+ * Modules kept between compilations (see CompilationUnit::keepModules()),
+ * indexed by source path.
+ */
+static bool keep_modules = false;
+static map<string, shared_ptr<Module> > kept_modules;
+static mutex kept_mutex;
+
+/**
+ * @class CompilationUnit
+ * Gather the whole state of the compilation of one IOML source:
+ * lexer position, interned names, declarations and parser work lists. Several units
+ * may be alive at the same time, in the same thread or in different
+ * threads.
+ *
+ * The AST nodes built while the unit is the current one are allocated
+ * in the arena of the unit and are all released with it. The expressions
+ * are not AST nodes but entries of the expression pool of the unit.
+ */
+
+/**
+ * Make a path absolute (relative paths are relative to the current
+ * directory).
+ * @param path	Path to convert.
+ * @return		Absolute path.
+ */
+static string absolutePath(const string& path) {
+	if(path[0] == '/')
+		return path;
+	char buf[4096];
+	if(getcwd(buf, sizeof(buf)) == nullptr)
+		return path;
+	return string(buf) + "/" + path;
+}
+
+
+/**
+ * Build a compilation unit.
+ * @param file	Name of the compiled source (used in positions).
+ */
+CompilationUnit::CompilationUnit(string file): _file(file), _line(1), _flex(nullptr), _scanner(nullptr), _kind(Scanner::FLEX), _importer(nullptr) {
+}
+
+///
+CompilationUnit::~CompilationUnit() {
+	release();
+}
+
+/**
+ * Release the AST of the unit (declarations, nodes, expressions, states
+ * and imported modules) as soon as it is no longer needed, that is,
+ * once the quads are generated. The file name of the unit remains
+ * available to the positions recorded in the quads.
+ */
+void CompilationUnit::release() {
+	vector<Declaration *>().swap(_decls);
+	vector<Declaration *>().swap(_order);
+	vector<State *>().swap(_states);
+	vector<State *>().swap(_state_index);
+	vector<When *>().swap(_whens);
+	for(auto i = _nodes.rbegin(); i != _nodes.rend(); i++)
+		(*i)->~AST();
+	vector<AST *>().swap(_nodes);
+	_exprs = ExprPool();
+	_ids = SymbolTable();
+	_modules.clear();
+	_arena.release();
+}
+
+/**
+ * Parse the given source and fill the symbol table. The source text is
+ * scanned in place, without being copied.
+ * Throws a ParseException in case of error.
+ * @param source	Source to parse.
+ * @param scanner	Scanner to use: FLEX for the Flex scanner, else the kind
+ * 					of the hand-written scanner (both give the same tokens).
+ */
+void CompilationUnit::parse(const Source& source, Scanner::kind_t scanner) {
+	Scope scope(*this);
+	_kind = scanner;
+	if(scanner != Scanner::FLEX) {
+		Scanner s(*this, source, scanner);
+		_scanner = &s;
+		try {
+			yyparse(*this);
+		}
+		catch(...) {
+			_scanner = nullptr;
+			throw;
+		}
+		_scanner = nullptr;
+		return;
+	}
+	yylex_init_extra(this, &_flex);
+	auto buffer = yy_scan_buffer(source.buffer(), source.size() + 2, _flex);
+	try {
+		yyparse(*this);
+	}
+	catch(...) {
+		yy_delete_buffer(buffer, _flex);
+		yylex_destroy(_flex);
+		_flex = nullptr;
+		throw;
+	}
+	yy_delete_buffer(buffer, _flex);
+	yylex_destroy(_flex);
+	_flex = nullptr;
+}
+
+/**
+ * Scan the next token of the parsed source with the scanner selected
+ * by parse() (called by the parser).
+ * @param val	To store the semantic value in.
+ * @return		Token code, 0 at the end of the source.
+ */
+int CompilationUnit::lex(YYSTYPE *val) {
+	if(_scanner != nullptr)
+		return _scanner->next(val);
+	else
+		return yylex(val, _flex);
+}
+
+/**
+ * Get the declaration of a name. The names not declared in the unit
+ * are looked up in the imported modules.
+ * @param id	Identifier of the name.
+ * @return		Found declaration or a null pointer.
+ */
+Declaration *CompilationUnit::getSymbol(SymbolTable::id_t id) {
+	if(id < _decls.size() && _decls[id] != nullptr)
+		return _decls[id];
+	else if(_modules.empty())
+		return nullptr;
+	else
+		return load(id);
+}
+
+/**
+ * Get a symbol from the symbol table.
+ * @param name	Name of the looked symbol.
+ * @return		Found symbol or a null pointer.
+ */
+Declaration *CompilationUnit::getSymbol(string name) {
+	auto id = _ids.find(name);
+	if(id == SymbolTable::none)
+		return nullptr;
+	else
+		return getSymbol(id);
+}
+
+/**
+ * Record a declaration in the symbol table.
+ * Throws a ParseException if the symbol already exists (in the unit
+ * or in an imported module).
+ * @param decl	Declaration to add.
+ */
+void CompilationUnit::declare(Declaration *decl) {
+	auto id = _ids.intern(decl->name());
+	if(getSymbol(id) != nullptr)
+		throw ParseException(decl->pos, "symbol already exists!");
+	if(id >= _decls.size())
+		_decls.resize(id + 1, nullptr);
+	_decls[id] = decl;
+	_order.push_back(decl);
+}
+
+/**
+ * Import the const, reg and sig declarations of another source. The path
+ * is relative to the directory of the unit source.
+ *
+ * The declarations are taken from the precompiled module of the source
+ * (see Module::pathOf()) if it is up to date. Modules are identified by
+ * absolute paths so that their dependencies do not depend on the current
+ * directory. Else the source is compiled
+ * and its module is written for the next imports. The declarations of the
+ * module are only loaded in the unit when their name is looked up.
+ *
+ * Throws a ParseException if the source cannot be imported.
+ * @param path	Path of the imported source.
+ * @param line	Line of the import.
+ */
+void CompilationUnit::import(const string& path, int line) {
+	string source = path;
+	auto p = _file.rfind('/');
+	if(path[0] != '/' && p != string::npos)
+		source = _file.substr(0, p + 1) + path;
+	for(auto u = this; u != nullptr; u = u->_importer)
+		if(u->_file == source)
+			throw ParseException(Position(line), "circular import of \"" + path + "\"");
+
+	// look in the kept modules
+	string file = absolutePath(source);
+	if(keep_modules) {
+		lock_guard<mutex> lock(kept_mutex);
+		auto i = kept_modules.find(file);
+		if(i != kept_modules.end() && i->second->upToDate()) {
+			_modules.push_back(i->second);
+			return;
+		}
+	}
+
+	// get the module, compile it if required
+	auto module = make_shared<Module>();
+	if(!module->open(file)) {
+		Module::Stamp stamp;
+		if(!stamp.get(file))
+			throw ParseException(Position(line), "cannot import \"" + path + "\"");
+		string image = compileModule(source, stamp, line);
+		if(!Source::write(Module::pathOf(file), image) || !module->open(file))
+			module->assign(file, image);
+	}
+	if(keep_modules) {
+		lock_guard<mutex> lock(kept_mutex);
+		kept_modules[file] = module;
+	}
+	_modules.push_back(module);
+}
+
+/**
+ * Keep the imported modules between compilations (as long as they are
+ * up to date) instead of mapping them again at each import. Used by
+ * long-running processes compiling several sources.
+ * @param keep	True to keep the modules, false to release them.
+ */
+void CompilationUnit::keepModules(bool keep) {
+	lock_guard<mutex> lock(kept_mutex);
+	keep_modules = keep;
+	if(!keep)
+		kept_modules.clear();
+}
+
+/**
+ * Compile an imported source to a module image.
+ * Throws a ParseException if the source is erroneous or declares
+ * something else than const, reg or sig.
+ * @param path	Path of the imported source.
+ * @param stamp	Stamp of the imported source.
+ * @param line	Line of the import.
+ * @return		Module image.
+ */
+string CompilationUnit::compileModule(const string& path, const Module::Stamp& stamp, int line) {
+	CompilationUnit unit(path);
+	unit._importer = this;
+	Source text;
+	if(!text.open(path))
+		throw ParseException(Position(line), "cannot import \"" + path + "\"");
+	try {
+		unit.parse(text, _kind);
+		unit.loadAll();
+	}
+	catch(const ParseException& e) {
+		throw ParseException(Position(line), "in import of " + e.pos().to_str() + ": " + e.msg());
+	}
+	auto decls = unit.declarations();
+	for(auto d: decls)
+		if(d->type() != Declaration::CST && d->type() != Declaration::REG && d->type() != Declaration::SIG)
+			throw ParseException(Position(line), path + ": " + d->name() + " cannot be imported (only const, reg and sig).");
+	vector<Module::Dependency> deps;
+	for(auto m: unit._modules) {
+		deps.push_back({ m->source(), m->stamp() });
+		for(const auto& d: m->dependencies())
+			deps.push_back(d);
+	}
+	return Module::build(decls, stamp, deps);
+}
+
+/**
+ * Load the declaration of a name from the imported modules.
+ * @param id	Identifier of the name.
+ * @return		Loaded declaration or a null pointer.
+ */
+Declaration *CompilationUnit::load(SymbolTable::id_t id) {
+	string name = _ids.name(id);
+	for(auto m: _modules) {
+		auto e = m->find(name.data(), name.size());
+		if(e == nullptr)
+			continue;
+		Scope scope(*this);
+		Declaration *d = nullptr;
+		switch(e->type) {
+		case Declaration::CST:
+			d = new ConstDecl(name, int(e->value));
+			break;
+		case Declaration::REG:
+			d = new RegDecl(name, e->value);
+			break;
+		case Declaration::SIG:
+			if(e->reg < m->count() && m->entry(e->reg).type == Declaration::REG && m->valid(m->entry(e->reg))) {
+				auto& r = m->entry(e->reg);
+				auto reg = getSymbol(_ids.intern(m->name(r), r.length));
+				if(reg != nullptr && reg->type() == Declaration::REG)
+					d = new SigDecl(name, static_cast<RegDecl *>(reg), e->bit);
+			}
+			break;
+		}
+		if(d == nullptr)
+			return nullptr;
+		if(id >= _decls.size())
+			_decls.resize(id + 1, nullptr);
+		_decls[id] = d;
+		_order.push_back(d);
+		return d;
+	}
+	return nullptr;
+}
+
+/**
+ * Load all the declarations of the imported modules (to re-export them).
+ */
+void CompilationUnit::loadAll() {
+	for(auto m: _modules)
+		for(uint32_t i = 0; i < m->count(); i++)
+			if(m->valid(m->entry(i)))
+				getSymbol(_ids.intern(m->name(m->entry(i)), m->entry(i).length));
+}
+
+/**
+ * Get the declarations sorted by name: this order is used for
+ * the outputs and the numbering of variables.
+ * @return	Sorted declarations.
+ */
+vector<Declaration *> CompilationUnit::declarations() const {
+	vector<Declaration *> r = _order;
+	sort(r.begin(), r.end(),
+		[](Declaration *d1, Declaration *d2) { return d1->name() < d2->name(); });
+	return r;
+}
+
+/**
+ * Look for the automaton declaration.
+ * @return	Found automaton or a null pointer.
+ */
+AutoDecl *CompilationUnit::automaton() const {
+	AutoDecl *r = nullptr;
+	for(auto d: _order)
+		if(d->type() == Declaration::AUTO
+		&& (r == nullptr || d->name() < r->name()))
+			r = static_cast<AutoDecl *>(d);
+	return r;
+}
+
+/**
+ * Get a state of the automaton being parsed.
+ * @param id	Identifier of the state name.
+ * @return		Found state or a null pointer.
+ */
+State *CompilationUnit::getState(SymbolTable::id_t id) const {
+	if(id < _state_index.size())
+		return _state_index[id];
+	else
+		return nullptr;
+}
+
+/**
+ * Add a state to the automaton being parsed.
+ * @param id	Identifier of the state name.
+ * @param state	Added state.
+ */
+void CompilationUnit::addState(SymbolTable::id_t id, State *state) {
+	if(id >= _state_index.size())
+		_state_index.resize(id + 1, nullptr);
+	_state_index[id] = state;
+	_states.push_back(state);
+}
+
+/**
+ * Reset the states at the end of an automaton.
+ */
+void CompilationUnit::clearStates() {
+	fill(_state_index.begin(), _state_index.end(), nullptr);
+	_states.clear();
+}
+
+/**
+ * @fn SymbolTable::id_t CompilationUnit::intern(const char *name, size_t len);
+ * Get the identifier of a name (used by the lexer).
+ * @param name	Name characters.
+ * @param len	Name length.
+ * @return		Name identifier.
+ */
+
+/**
+ * @fn const string& CompilationUnit::name(SymbolTable::id_t id) const;
+ * Get the name corresponding to an identifier.
+ * @param id	Name identifier.
+ * @return		Name.
+ */
+
+/**
+ * @fn void *CompilationUnit::allocate(size_t size);
+ * Allocate memory for an AST node in the arena of the unit.
+ * @param size	Size of the node.
+ * @return		Allocated memory.
+ */
+
+/**
+ * @fn void CompilationUnit::adopt(AST *node);
+ * Record a node allocated in the arena so that it is destroyed
+ * with the unit.
+ * @param node	Adopted node.
+ */
+
+/**
+ * @fn ExprPool& CompilationUnit::exprs();
+ * Get the pool storing the expressions of the unit.
+ */
+
+/**
+ * @fn Expression CompilationUnit::expr(ExprPool::index_t i);
+ * Get a handle on an expression of the pool of the unit.
+ * @param i		Expression index.
+ */
+
+/**
+ * Get the unit currently processed by the calling thread.
+ * @return	Current unit or a null pointer.
+ */
+CompilationUnit *CompilationUnit::current() {
+	return current_unit;
+}
+
+
+/**
+ * @class CompilationUnit::Scope
+ * Make a unit the current one of the calling thread for the lifetime
+ * of the scope object.
+ */
+
+///
+CompilationUnit::Scope::Scope(CompilationUnit& unit): _prev(current_unit) {
+	current_unit = &unit;
+}
+
+///
+CompilationUnit::Scope::~Scope() {
+	current_unit = _prev;
+}
@@ -0,0 +1,91 @@
+#ifndef IOC_COMPILATION_UNIT_HPP
+#define IOC_COMPILATION_UNIT_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "Arena.hpp"
+#include "Module.hpp"
+#include "Scanner.hpp"
+#include "Source.hpp"
+#include "AST.hpp"
+#include "SymbolTable.hpp"
+
+class CompilationUnit {
+public:
+
+	class Scope {
+	public:
+		Scope(CompilationUnit& unit);
+		~Scope();
+	private:
+		CompilationUnit *_prev;
+	};
+
+	CompilationUnit(string file = "<stdin>");
+	~CompilationUnit();
+	void release();
+
+	void parse(const Source& source, Scanner::kind_t scanner = Scanner::FLEX);
+	int lex(YYSTYPE *val);
+
+	inline const char *file() const { return _file.c_str(); }
+	inline int line() const { return _line; }
+	inline void newLine() { _line++; }
+	inline void newLines(int n) { _line += n; }
+	inline Position position() const { return Position(file(), _line); }
+	inline void *allocate(size_t size) { return _arena.allocate(size); }
+	inline void adopt(AST *node) { _nodes.push_back(node); }
+	inline size_t nodeCount() const { return _nodes.size() + _exprs.size(); }
+	inline ExprPool& exprs() { return _exprs; }
+	inline Expression expr(ExprPool::index_t i) { return Expression(_exprs, i); }
+	inline const Arena& arena() const { return _arena; }
+
+	inline SymbolTable::id_t intern(const char *name, size_t len) { return _ids.intern(name, len); }
+	inline const string& name(SymbolTable::id_t id) const { return _ids.name(id); }
+	inline const SymbolTable& symbolTable() const { return _ids; }
+
+	Declaration *getSymbol(SymbolTable::id_t id);
+	Declaration *getSymbol(string name);
+	void declare(Declaration *decl);
+	void import(const string& path, int line);
+	inline const vector<shared_ptr<Module> >& modules() const { return _modules; }
+	vector<Declaration *> declarations() const;
+	AutoDecl *automaton() const;
+
+	inline vector<State *>& states() { return _states; }
+	inline const vector<State *>& stateIndex() const { return _state_index; }
+	State *getState(SymbolTable::id_t id) const;
+	void addState(SymbolTable::id_t id, State *state);
+	void clearStates();
+	inline vector<When *>& whens() { return _whens; }
+
+	static CompilationUnit *current();
+	static void keepModules(bool keep);
+
+private:
+	Declaration *load(SymbolTable::id_t id);
+	void loadAll();
+	string compileModule(const string& path, const Module::Stamp& stamp, int line);
+
+	string _file;
+	int _line;
+	void *_flex;
+	Scanner *_scanner;
+	Scanner::kind_t _kind;
+	CompilationUnit *_importer;
+	Arena _arena;
+	vector<AST *> _nodes;
+	ExprPool _exprs;
+	SymbolTable _ids;
+	vector<Declaration *> _decls;
+	vector<Declaration *> _order;
+	vector<State *> _states;
+	vector<State *> _state_index;
+	vector<When *> _whens;
+	vector<shared_ptr<Module> > _modules;
+};
+
+#endif	// IOC_COMPILATION_UNIT_HPP
@@ -0,0 +1,676 @@
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdio.h>
+#include "Cache.hpp"
+#include "Compiler.hpp"
+#include "Hash.hpp"
+#include "RegAlloc.hpp"
+#include "Report.hpp"
+#include "SSA.hpp"
+#include "StateCache.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ * @class Options
+ * Options driving the compilation of a source.
+ */
+
+///
+Options::Options():
+	print_ast(false),
+	reduce_const(false),
+	sccp(false),
+	lvn(false),
+	gvn(false),
+	dce(false),
+	print_quads(false),
+	print_cfg(false),
+	print_ssa(false),
+	print_select(false),
+	print_alloc(false),
+	assembly(false),
+	stop_after_print(false),
+	time_report(NONE),
+	scanner(Scanner::FLEX),
+	cache_size(Cache::default_size),
+	incremental(false),
+	threads(1)
+{ }
+
+/**
+ * Get the signature of the options changing the output of a compilation
+ * (used to build the keys of the compilation cache).
+ * @return	Options signature.
+ */
+string Options::signature() const {
+	string s;
+	for(auto b: { print_ast, reduce_const, sccp, lvn, gvn, dce, print_quads, print_cfg, print_ssa, print_select, print_alloc, assembly, stop_after_print })
+		s += b ? '1' : '0';
+	return s;
+}
+
+/**
+ * Generate the CFG of machine instructions from the CFG of quads.
+ * The BBs are selected independently, in parallel if a pool is given:
+ * the result does not depend on the number of threads.
+ * @param g		CFG of quads.
+ * @param pool	Pool of threads to use (nullptr to select sequentially).
+ * @return		CFG of instructions.
+ */
+CFG<Inst> *selectInstructions(CFG<Quad> *g, ThreadPool *pool) {
+	CFG<Inst> *r = new CFG<Inst>();
+
+	// build BBs
+	map<BB<Quad> *, BB<Inst> *> map;
+	vector<pair<BB<Quad> *, BB<Inst> *> > todo;
+	for(auto bb: g->basicBlocks())
+		if(bb == g->entry())
+			map[g->entry()] = r->entry();
+		else if(bb == g->exit())
+			map[g->exit()] = r->exit();
+		else {
+			auto rbb = new BB<Inst>();
+			r->add(rbb);
+			map[bb] = rbb;
+			todo.push_back(make_pair(bb, rbb));
+		}
+
+	// select the instructions
+	auto job = [&](size_t i) {
+		todo[i].second->setInstructions(select(todo[i].first->instructions()));
+	};
+	if(pool == nullptr)
+		for(size_t i = 0; i < todo.size(); i++)
+			job(i);
+	else
+		pool->parallelFor(todo.size(), job);
+
+	// build edges
+	for(auto bb: g->basicBlocks()) {
+		auto rbb = map[bb];
+		if(bb->next() != nullptr)
+			rbb->setNext(map[bb->next()]);
+		if(bb->target() != nullptr)
+			rbb->setTarget(map[bb->target()]);
+	}
+
+	return r;
+}
+
+
+/**
+ * Allocate the registers in the CFG of registers. The layout of the
+ * variables in the stack is built first and then each BB is allocated
+ * with its own stack mapper, in parallel if a pool is given: the result
+ * does not depend on the number of threads.
+ * @param g		CFG of registers.
+ * @param prog	Current program (giving the variables).
+ * @param pool	Pool of threads to use (nullptr to allocate sequentially).
+ */
+void allocRegisters(CFG<Inst>& g, const QuadProgram& prog, ThreadPool *pool) {
+
+	// prepare layout
+	StackLayout layout;
+	for(auto r: prog.variables())
+		layout.add(r);
+	layout.markGlobal();
+
+	// allocate the registers
+	vector<BB<Inst> *> bbs(g.basicBlocks().begin(), g.basicBlocks().end());
+	auto job = [&](size_t i) {
+		StackMapper map(layout);
+		vector<Inst> nlist;
+		nlist.reserve(bbs[i]->instructions().size() * 5 / 4);
+		RegAlloc alloc(map, nlist);
+		for(const auto& inst: bbs[i]->instructions())
+			alloc.process(inst);
+		alloc.complete();
+		bbs[i]->setInstructions(move(nlist));
+	};
+	if(pool == nullptr)
+		for(size_t i = 0; i < bbs.size(); i++)
+			job(i);
+	else
+		pool->parallelFor(bbs.size(), job);
+}
+
+
+/**
+ * Output assembly from the CFG from the given stream.
+ * The BBs reachable from the entry are output once each, in the order
+ * of their numbers, that is, in the order of the program: a BB is thus
+ * always followed by its next BB. The output only depends on the CFG
+ * and not on the memory layout.
+ * @param g		Instruction CFG to output.
+ * @param out	Output stream to output to.
+ */
+void outputAssembly(CFG<Inst>& g, ostream& out) {
+
+	// generate prolog
+	out << "\t.global main\n"
+		<< "\n"
+		<< "_main:" << endl;
+
+	// find reachable BBs
+	vector<BB<Inst> *> bbs(g.basicBlocks().size(), nullptr);
+	vector<BB<Inst> *> todo = { g.entry() };
+	bbs[g.entry()->number()] = g.entry();
+	while(!todo.empty()) {
+		auto bb = todo.back();
+		todo.pop_back();
+		for(auto succ: { bb->next(), bb->target() })
+			if(succ != nullptr && bbs[succ->number()] == nullptr) {
+				bbs[succ->number()] = succ;
+				todo.push_back(succ);
+			}
+	}
+
+	// generate body
+	for(auto bb: bbs)
+		if(bb != nullptr)
+			for(const auto& i: bb->instructions())
+				out << i << endl;
+
+	// generate epilog
+	out << "\tbx LR" << endl;
+
+	// generate run-time
+	out << endl
+		<< "@ R0 = e, R1 = u, R2 = l\n"
+		<< "get_field:\n"
+		<< "L10000:\n"
+		<< "	stmfd sp!, {R1, R2}\n"
+		<< "	mov R0, R0, lsr R2\n"
+		<< "	sub R1, R1, R2\n"
+		<< "	add R1, R1, #1\n"
+		<< "	mov R2, #1\n"
+		<< "	mov R2, R2, lsl R1\n"
+		<< "	sub R2, R2, #1\n"
+		<< "	and R0, R0, R2\n"
+		<< "	ldmfd sp!, {R1, R2}\n"
+		<< "	bx  LR\n"
+		<< endl
+		<< "@ R0 = i, R1 = u, R2 = l, R3 = e\n"
+		<< "set_field:\n"
+		<< "L10001:\n"
+		<< "	stmfd sp!, {R1, R3, R4}\n"
+		<< "	sub R1, R1, R2\n"
+		<< "	add R1, R1, #1\n"
+		<< "	mov R4, #1\n"
+		<< "	mov R4, R4, lsl R1\n"
+		<< "	and R3, R3, R4\n"
+		<< "	mov R3, R3, lsl R2\n"
+		<< "	mov R4, R4, lsl R2\n"
+		<< "	mvn R4, R4\n"
+		<< "	and R0, R0, R4\n"
+		<< "	orr R0, R0, R3\n"
+		<< "	ldmfd sp!, {R1, R3, R4}\n"
+		<< "	bx  LR\n"
+	;
+}
+
+
+/**
+ * Count the instructions in a CFG.
+ * @param g		CFG to look in.
+ * @return		Number of instructions.
+ */
+template <class T>
+static size_t countInstructions(const CFG<T>& g) {
+	size_t n = 0;
+	for(auto bb: g.basicBlocks())
+		n += bb->instructions().size();
+	return n;
+}
+
+
+/**
+ * Get the labels of the entries of the states and of the epilogue of an
+ * automaton (the labels must be assigned).
+ * @param automaton	Automaton to look in.
+ * @return			Entry labels.
+ */
+static vector<Quad::lab_t> entryLabels(AutoDecl& automaton) {
+	vector<Quad::lab_t> labels;
+	for(auto state: automaton.states())
+		labels.push_back(state->label());
+	labels.push_back(automaton.stopLabel());
+	return labels;
+}
+
+
+/**
+ * Optimize the quads as required by the options.
+ * @param quads		Program to optimize.
+ * @param entries	Labels of the entries of the states and of the epilogue.
+ * @param options	Compilation options.
+ * @param report	Report to record phase times in.
+ */
+static void optimize(QuadProgram& quads, const vector<Quad::lab_t>& entries, const Options& options, Report& report) {
+	if(options.sccp) {
+		report.start("sccp");
+		quads.propagateConstants(entries);
+		report.stop(quads.count(), "quads");
+	}
+	if(options.lvn) {
+		report.start("lvn");
+		quads.numberValues();
+		report.stop(quads.count(), "quads");
+	}
+	if(options.gvn) {
+		report.start("gvn");
+		quads.eliminateRedundancies(entries);
+		report.stop(quads.count(), "quads");
+	}
+	if(options.dce) {
+		report.start("dce");
+		auto removed = quads.eliminateDeadCode();
+		report.stop(removed, "dead");
+	}
+}
+
+
+/**
+ * Region of the program generated for the incremental compilation: the
+ * prologue (with the first state, see compileIncremental()), a state or
+ * the epilogue.
+ */
+class Region {
+public:
+	inline Region(): label(0), base(0), labs(0), regs(0) { }
+	Quad::lab_t label;					// first label (except prologue)
+	Quad::lab_t base;					// first local label
+	unsigned labs, regs;				// local labels and registers
+	string key;							// state key (states)
+	shared_ptr<const StateCache::Entry> entry;	// cached state (reused states)
+	vector<StateCache::Block> blocks;	// compiled blocks (generated regions)
+};
+
+
+/**
+ * Compile an automaton to allocated instructions, reusing the compiled
+ * states of the cache and adding the newly compiled ones.
+ *
+ * The prologue (labels, initialization), the epilogue (stop) and the
+ * states that are not in the cache are generated in quads and compiled
+ * as usual: as the basic blocks never span two states and the register
+ * allocation is performed per basic block, this gives the same code as
+ * compiling the whole program. The first state is always compiled with
+ * the prologue because its first block may be merged with the last one
+ * of the initialization. The cached states are only stitched in, their
+ * local labels being relocated.
+ *
+ * @param unit		Compiled unit.
+ * @param automaton	Automaton to compile.
+ * @param quads		Program to generate in (with the variables declared).
+ * @param cache		State cache to use.
+ * @param options	Compilation options (giving the optimizations).
+ * @param pool		Pool of threads to use (nullptr to compile sequentially).
+ * @param report	Report to record phase times in.
+ * @return			CFG of allocated instructions.
+ */
+static CFG<Inst> *compileIncremental(CompilationUnit& unit, AutoDecl& automaton, QuadProgram& quads, StateCache& cache, const Options& options, ThreadPool *pool, Report& report) {
+
+	// hash the context of the states (the variables and the optimizations)
+	Hash context;
+	for(auto r: quads.variables())
+		context.add(r);
+	context.add(uint64_t(options.sccp));
+	context.add(uint64_t(options.lvn));
+	context.add(uint64_t(options.gvn));
+	context.add(uint64_t(options.dce));
+
+	// generate the quads of the regions that are not in the cache
+	report.start("gen");
+	vector<Region> regions(1);
+	automaton.genPrologue(quads);
+	size_t reused = 0;
+	for(size_t i = 0; i < automaton.states().size(); i++) {
+		auto state = automaton.states()[i];
+		if(i == 0) {
+			state->gen(automaton, quads);
+			continue;
+		}
+		Region r;
+		Hash h = context;
+		state->hash(automaton, quads, h);
+		r.key = h.str();
+		r.label = state->label();
+		r.base = quads.labCount();
+		r.entry = cache.find(r.key);
+		if(r.entry != nullptr) {
+			quads.skip(r.entry->regs, r.entry->labs);
+			reused++;
+		}
+		else {
+			auto reg = quads.regCount();
+			state->gen(automaton, quads);
+			r.labs = quads.labCount() - r.base;
+			r.regs = quads.regCount() - reg;
+		}
+		regions.push_back(r);
+	}
+	Region epilogue;
+	epilogue.label = automaton.stopLabel();
+	regions.push_back(epilogue);
+	automaton.genEpilogue(quads);
+	auto entries = entryLabels(automaton);
+	unit.release();
+	report.stop(quads.count(), "quads");
+	optimize(quads, entries, options, report);
+
+	// compile them
+	report.start("cfg");
+	unique_ptr<CFG<Quad> > cfg(quads.makeCFG());
+	report.stop(cfg->basicBlocks().size(), "BBs");
+	report.start("select");
+	unique_ptr<CFG<Inst> > part(selectInstructions(cfg.get(), pool));
+	report.stop(countInstructions(*part), "insts");
+	report.start("alloc");
+	allocRegisters(*part, quads, pool);
+	report.stop(countInstructions(*part), "insts");
+
+	// dispatch the compiled blocks in the regions
+	report.start("reuse");
+	auto r = regions.begin();
+	auto ibb = part->basicBlocks().begin();
+	for(auto bb: cfg->basicBlocks()) {
+		if(bb == cfg->entry() || bb == cfg->exit()) {
+			++ibb;
+			continue;
+		}
+		StateCache::Block b;
+		b.insts = (*ibb)->instructions();
+		for(const auto& quad: bb->instructions())
+			if(quad.type == Quad::LAB)
+				b.labels.push_back(quad.label());
+		for(auto n = next(r); n != regions.end(); ++n)
+			if(n->entry == nullptr) {
+				if(find(b.labels.begin(), b.labels.end(), n->label) != b.labels.end())
+					r = n;
+				break;
+			}
+		if(!bb->instructions().empty()) {
+			const Quad& last = bb->instructions().back();
+			b.branch = last.type >= Quad::GOTO && last.type <= Quad::GOTO_GE;
+			if(b.branch)
+				b.target = last.label();
+		}
+		b.exit = bb->next() == cfg->exit();
+		b.next = bb->next() != nullptr && !b.exit;
+		r->blocks.push_back(move(b));
+		++ibb;
+	}
+
+	part.reset();
+	cfg.reset();
+	quads.releaseQuads();
+
+	// assemble the blocks, relocating the reused ones
+	auto g = new CFG<Inst>();
+	vector<BB<Inst> *> bbs;
+	vector<StateCache::Block> edges;
+	map<Quad::lab_t, BB<Inst> *> labels;
+	auto add = [&](StateCache::Block& b) {
+		auto bb = new BB<Inst>();
+		g->add(bb);
+		bb->setInstructions(move(b.insts));
+		for(auto l: b.labels)
+			labels[l] = bb;
+		bbs.push_back(bb);
+		edges.push_back(b);
+	};
+	for(auto& region: regions)
+		if(region.entry == nullptr) {
+			if(region.key != "") {
+				auto e = make_shared<StateCache::Entry>();
+				e->base = region.base;
+				e->labs = region.labs;
+				e->regs = region.regs;
+				e->blocks = region.blocks;
+				cache.put(region.key, e);
+			}
+			for(auto& b: region.blocks)
+				add(b);
+		}
+		else
+			for(auto b: region.entry->blocks) {
+				if(region.entry->base != region.base)
+					StateCache::relocate(b, region.entry->base, region.entry->labs, region.base);
+				add(b);
+			}
+
+	// link them
+	if(!bbs.empty())
+		g->entry()->setNext(bbs[0]);
+	for(size_t i = 0; i < edges.size(); i++) {
+		if(edges[i].exit)
+			bbs[i]->setNext(g->exit());
+		else if(edges[i].next && i + 1 < bbs.size())
+			bbs[i]->setNext(bbs[i + 1]);
+		if(edges[i].branch) {
+			auto t = labels.find(edges[i].target);
+			if(t != labels.end())
+				bbs[i]->setTarget(t->second);
+		}
+	}
+	report.stop(reused, "states");
+	return g;
+}
+
+
+/**
+ * Run the compilation phases on a source text.
+ * @param source	Path of the source file ("" for standard input).
+ * @param text		Text of the source.
+ * @param options	Compilation options.
+ * @param report	Report to record phase times in.
+ * @param out		Stream to output the required prints to.
+ * @param asm_out	Stream to output the assembly to.
+ * @param err		Stream to output the diagnostics to.
+ * @return			0 for success, an error code else.
+ */
+static int run(const string& source, const Source& text, const Options& options, Report& report, ostream& out, ostream& asm_out, ostream& err) {
+
+	// perform analaysis
+	CompilationUnit unit(source == "" ? "<stdin>" : source);
+	CompilationUnit::Scope scope(unit);
+	try {
+		report.start("parse");
+		unit.parse(text, options.scanner);
+		report.stop(unit.nodeCount(), "nodes");
+	}
+	catch(const ParseException& e) {
+		err << "ERROR:" << e.pos() << ": " << e.msg() << endl;
+		return 1;
+	}
+
+	// reduce constant
+	if(options.reduce_const) {
+		report.start("reduce");
+		for(auto d: unit.declarations())
+			d->reduce();
+		report.stop(unit.nodeCount(), "nodes");
+	}
+
+	// perform post-processing
+	if(options.print_ast) {
+		for(auto d: unit.declarations())
+			d->print(out);
+		if(options.stop_after_print)
+			return 0;
+	}
+
+	// compile in quadruplets
+	QuadProgram quads;
+	for(auto d: unit.declarations())
+		if(d->type() == Declaration::VAR)
+			quads.declare(d->name());
+	AutoDecl *automaton = unit.automaton();
+	if(automaton == nullptr) {
+		err << "ERROR: no automaton in this file: '" << source << "'" << endl;
+		return 3;
+	}
+	// generate the code, incrementally if the intermediate prints are not needed
+	unique_ptr<ThreadPool> pool;
+	if(options.threads != 1)
+		pool.reset(new ThreadPool(options.threads));
+	unique_ptr<CFG<Inst> > inst_cfg;
+	if(options.incremental && !options.print_quads && !options.print_cfg && !options.print_ssa && !options.print_select)
+		inst_cfg.reset(compileIncremental(unit, *automaton, quads, StateCache::global(), options, pool.get(), report));
+	else {
+		report.start("gen");
+		automaton->gen(quads, pool.get());
+		auto entries = entryLabels(*automaton);
+		unit.release();
+		report.stop(quads.count(), "quads");
+		optimize(quads, entries, options, report);
+
+		// print quads if need
+		if(options.print_quads) {
+			quads.print(out);
+			if(options.stop_after_print)
+				return 0;
+		}
+
+		// print SSA form if needed
+		if(options.print_ssa) {
+			report.start("ssa");
+			unique_ptr<SSAForm> ssa(quads.makeSSA(entries));
+			report.stop(ssa->blockCount(), "BBs");
+			ssa->print(out);
+			if(options.stop_after_print)
+				return 0;
+			quads.restoreRegisters(*ssa);
+		}
+
+		// build CFG
+		report.start("cfg");
+		unique_ptr<CFG<Quad> > cfg(quads.makeCFG());
+		report.stop(cfg->basicBlocks().size(), "BBs");
+
+		// print CFG if needed
+		if(options.print_cfg) {
+			cfg->print(out);
+			if(options.stop_after_print)
+				return 0;
+		}
+
+		// select instructions
+		report.start("select");
+		inst_cfg.reset(selectInstructions(cfg.get(), pool.get()));
+		cfg.reset();
+		quads.releaseQuads();
+		report.stop(countInstructions(*inst_cfg), "insts");
+		if(options.print_select) {
+			inst_cfg->print(out);
+			if(options.stop_after_print)
+				return 0;
+		}
+
+		// allocate registers
+		report.start("alloc");
+		allocRegisters(*inst_cfg, quads, pool.get());
+		report.stop(countInstructions(*inst_cfg), "insts");
+	}
+	if(options.print_alloc) {
+		inst_cfg->print(out);
+		if(options.stop_after_print)
+			return 0;
+	}
+
+	// output machine instructions
+	if(options.assembly) {
+		report.start("output");
+		outputAssembly(*inst_cfg, asm_out);
+		report.stop(countInstructions(*inst_cfg), "insts");
+	}
+
+	return 0;
+}
+
+
+/**
+ * Run the compilation phases on a source file or get their output from
+ * the compilation cache. The output of a successful compilation is added
+ * to the cache.
+ * @param source	Path of the source file.
+ * @param text		Text of the source.
+ * @param options	Compilation options.
+ * @param report	Report to record phase times in.
+ * @param out		Stream to output the required prints to.
+ * @param asm_out	Stream to output the assembly to.
+ * @param err		Stream to output the diagnostics to.
+ * @return			0 for success, an error code else.
+ */
+static int runCached(const string& source, const Source& text, const Options& options, Report& report, ostream& out, ostream& asm_out, ostream& err) {
+	Cache cache(options.cache_dir, options.cache_size);
+
+	// look in the cache
+	report.start("cache");
+	string key = cache.key(source, options.signature()), cached, cached_asm;
+	bool hit = key != "" && cache.get(key, cached, cached_asm);
+	report.stop(hit ? 1 : 0, "hits");
+	if(hit) {
+		out << cached;
+		asm_out << cached_asm;
+		return 0;
+	}
+
+	// compile and record the output
+	ostringstream text_out, asm_text_out;
+	int code = run(source, text, options, report, text_out, asm_text_out, err);
+	out << text_out.str();
+	asm_out << asm_text_out.str();
+	if(code == 0 && key != "")
+		cache.put(key, text_out.str(), asm_text_out.str());
+	return code;
+}
+
+
+/**
+ * Compile a source file. If options.cache_dir is set, the compilation
+ * cache in this directory is used (except for the standard input).
+ * @param source	Path of the source file ("" for standard input).
+ * @param options	Compilation options.
+ * @param out		Stream to output the required prints to.
+ * @param asm_out	Stream to output the assembly to.
+ * @param err		Stream to output the diagnostics and the time report to.
+ * @return			0 for success, an error code else.
+ */
+int compile(const string& source, const Options& options, ostream& out, ostream& asm_out, ostream& err) {
+	Source text;
+	if(!text.open(source)) {
+		err << "ERROR: cannot open '" << source << "'" << endl;
+		return 2;
+	}
+	return compile(source, text, options, out, asm_out, err);
+}
+
+
+/**
+ * Compile a source text.
+ * @param source	Path of the source file ("" for standard input).
+ * @param text		Text of the source.
+ * @param options	Compilation options.
+ * @param out		Stream to output the required prints to.
+ * @param asm_out	Stream to output the assembly to.
+ * @param err		Stream to output the diagnostics and the time report to.
+ * @return			0 for success, an error code else.
+ */
+int compile(const string& source, const Source& text, const Options& options, ostream& out, ostream& asm_out, ostream& err) {
+	Report report(source == "" ? "<stdin>" : source);
+	int code;
+	if(options.cache_dir != "" && source != "")
+		code = runCached(source, text, options, report, out, asm_out, err);
+	else
+		code = run(source, text, options, report, out, asm_out, err);
+	if(options.time_report == Options::TEXT)
+		report.print(err);
+	else if(options.time_report == Options::JSON)
+		report.printJSON(err);
+	return code;
+}
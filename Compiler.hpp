@@ -0,0 +1,52 @@
+#ifndef IOC_COMPILER_HPP
+#define IOC_COMPILER_HPP
+
+#include <iostream>
+#include <string>
+using namespace std;
+
+#include "CFG.hpp"
+#include "CompilationUnit.hpp"
+#include "Inst.hpp"
+#include "Quad.hpp"
+
+class ThreadPool;
+
+class Options {
+public:
+	typedef enum {
+		NONE,
+		TEXT,
+		JSON
+	} report_t;
+
+	Options();
+	string signature() const;
+	bool print_ast;
+	bool reduce_const;
+	bool sccp;
+	bool lvn;
+	bool gvn;
+	bool dce;
+	bool print_quads;
+	bool print_cfg;
+	bool print_ssa;
+	bool print_select;
+	bool print_alloc;
+	bool assembly;
+	bool stop_after_print;
+	report_t time_report;
+	Scanner::kind_t scanner;
+	string cache_dir;
+	size_t cache_size;
+	bool incremental;
+	unsigned threads;
+};
+
+CFG<Inst> *selectInstructions(CFG<Quad> *g, ThreadPool *pool = nullptr);
+void allocRegisters(CFG<Inst>& g, const QuadProgram& prog, ThreadPool *pool = nullptr);
+void outputAssembly(CFG<Inst>& g, ostream& out);
+int compile(const string& source, const Options& options, ostream& out, ostream& asm_out, ostream& err);
+int compile(const string& source, const Source& text, const Options& options, ostream& out, ostream& asm_out, ostream& err);
+
+#endif	// IOC_COMPILER_HPP
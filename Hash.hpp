@@ -0,0 +1,42 @@
+#ifndef IOC_HASH_HPP
+#define IOC_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+using namespace std;
+
+/**
+ * 128-bit non-cryptographic hash made of two independent 64-bit lanes
+ * (FNV-1a and a rotate-multiply lane), used to identify contents.
+ */
+class Hash {
+public:
+	inline Hash(): _a(0xcbf29ce484222325ULL), _b(0x9e3779b97f4a7c15ULL) { }
+
+	void add(const void *data, size_t size) {
+		auto p = static_cast<const unsigned char *>(data);
+		for(size_t i = 0; i < size; i++) {
+			_a = (_a ^ p[i]) * 0x100000001b3ULL;
+			_b = (_b ^ p[i]) * 0xff51afd7ed558ccdULL;
+			_b = (_b << 31) | (_b >> 33);
+		}
+	}
+
+	inline void add(uint64_t x) { add(&x, sizeof(x)); }
+	inline void add(const string& s) { add(s.size()); add(s.data(), s.size()); }
+
+	string str() const {
+		static const char digits[] = "0123456789abcdef";
+		string r;
+		for(auto x: { _a, _b })
+			for(int i = 60; i >= 0; i -= 4)
+				r += digits[(x >> i) & 0xf];
+		return r;
+	}
+
+private:
+	uint64_t _a, _b;
+};
+
+#endif	// IOC_HASH_HPP
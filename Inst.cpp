@@ -13,7 +13,8 @@ typedef enum {
 
 typedef enum {
 	COPY = 0x10000,
-	LOG2 = 0x20000
+	LOG2 = 0x20000,
+	RCOMP = 0x30000
 } action_t;
 
 typedef struct select_t {
@@ -88,11 +89,11 @@ select_t
 	},
 	select_addi = {
 		{ Quad::seti(RECORD|2, ISIMM|3), Quad::add(RECORD|0, RECORD|1, EQUAL|2) },
-		{ Inst("\tadd R%0, R%1, #%2", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)) }
+		{ Inst("\tadd R%0, R%1, #%2", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
 	},
 	select_addi2 = {
 		{ Quad::seti(RECORD|2, ISIMM|3), Quad::add(RECORD|0, EQUAL|2, RECORD|1) },
-		{ Inst("\tadd R%0, R%1, #%2", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)) }
+		{ Inst("\tadd R%0, R%1, #%2", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
 	},
 // Call
 	select_call = {
@@ -134,12 +135,12 @@ select_t
 	select_mod = {
 		{ Quad::mod(RECORD|0, RECORD|1, RECORD|2) },
 		{ 
-			// R3 = R1 / R2
-			Inst("\tsdiv R%3, R%1, R%2", pwrite(COPY|3), pread(COPY|1), pread(COPY|2)),
-			// R4 = R3 * R2
-			Inst("\tmul R%4, R%3, R%2", pwrite(COPY|4), pread(COPY|3), pread(COPY|2)),
-			// R0 = R1 - R4
-			Inst("\tsub R%0, R%1, R%4", pwrite(COPY|0), pread(COPY|1), pread(COPY|4)),
+			// R0 = R1 / R2 (R0 is a fresh register, different from R1 and R2)
+			Inst("\tsdiv R%0, R%1, R%2", pwrite(COPY|0), pread(COPY|1), pread(COPY|2)),
+			// R0 = R0 * R2
+			Inst("\tmul R%0, R%1, R%2", pwrite(COPY|0), pread(COPY|0), pread(COPY|2)),
+			// R0 = R1 - R0
+			Inst("\tsub R%0, R%1, R%2", pwrite(COPY|0), pread(COPY|1), pread(COPY|0)),
 			Inst::end 
 		}
 	},
@@ -189,7 +190,7 @@ select_t
 	},
 	select_store = {
 		{ Quad::store(RECORD|0, RECORD|1) },
-		{ Inst("\tstr R%1, [R%0]", pread(COPY|1), pread(COPY|0)), Inst::end }
+		{ Inst("\tstr R%0, [R%1]", pread(COPY|1), pread(COPY|0)), Inst::end }
 	},
 	select_goto = {
 		{ Quad::goto_(RECORD|0) },
@@ -198,7 +199,7 @@ select_t
 	select_goto_eq = {
 		{ Quad::goto_eq(RECORD|0, RECORD|1, RECORD|2) },
 		{
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
 			Inst("\tbeq L%0", pcst(COPY|0)),
 			Inst::end
 		}
@@ -206,7 +207,7 @@ select_t
 	select_goto_ne = {
 		{ Quad::goto_ne(RECORD|0, RECORD|1, RECORD|2) },
 		{ 
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
 			Inst("\tbne L%0", pcst(COPY|0)),
 			Inst::end 
 		}
@@ -214,7 +215,7 @@ select_t
 	select_goto_lt = {
 		{ Quad::goto_lt(RECORD|0, RECORD|1, RECORD|2) },
 		{ 
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
 			Inst("\tblt L%0", pcst(COPY|0)),
 			Inst::end
 		}
@@ -222,7 +223,7 @@ select_t
 	select_goto_le = {
 		{ Quad::goto_le(RECORD|0, RECORD|1, RECORD|2) },
 		{ 	
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
 			Inst("\tble L%0", pcst(COPY|0)),
 			Inst::end
 		}
@@ -230,7 +231,7 @@ select_t
 	select_goto_gt = {
 		{ Quad::goto_gt(RECORD|0, RECORD|1, RECORD|2) },
 		{ 	
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
 			Inst("\tbgt L%0", pcst(COPY|0)),
 			Inst::end
 		}
@@ -238,7 +239,7 @@ select_t
 	select_goto_ge = {
 		{ Quad::goto_ge(RECORD|0, RECORD|1, RECORD|2) },
 		{ 
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
 			Inst("\tbge L%0", pcst(COPY|0)),
 			Inst::end
 		}
@@ -249,36 +250,36 @@ select_t
 	},
 	select_subi = {
 		{ Quad::seti(RECORD|2, ISIMM|3), Quad::sub(RECORD|0, RECORD|1, EQUAL|2) },
-		{ Inst("\tsub R%0, R%1, #%3", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
+		{ Inst("\tsub R%0, R%1, #%2", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
 	},
 	select_andi = {
 		{ Quad::seti(RECORD|2, ISIMM|3), Quad::and_(RECORD|0, RECORD|1, EQUAL|2) },
-		{ Inst("\tand R%0, R%1, #%3", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
+		{ Inst("\tand R%0, R%1, #%2", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
 	},
 	select_ori = {
 		{ Quad::seti(RECORD|2, ISIMM|3), Quad::or_(RECORD|0, RECORD|1, EQUAL|2) },
-		{ Inst("\torr R%0, R%1, #%3", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
+		{ Inst("\torr R%0, R%1, #%2", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
 	},
 	select_xori = {
 		{ Quad::seti(RECORD|2, ISIMM|3), Quad::xor_(RECORD|0, RECORD|1, EQUAL|2) },
-		{ Inst("\teor R%0, R%1, #%3", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
+		{ Inst("\teor R%0, R%1, #%2", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
 	},
 	select_rori = {
 		{ Quad::seti(RECORD|2, ISIMM|3), Quad::ror(RECORD|0, RECORD|1, EQUAL|2) },
-		{ Inst("\tror R%0, R%1, #%3", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
+		{ Inst("\tror R%0, R%1, #%2", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
 	},
 	select_shli = {
 		{ Quad::seti(RECORD|2, ISIMM|3), Quad::shl(RECORD|0, RECORD|1, EQUAL|2) },
-		{ Inst("\tmov R%0, R%1, lsl #%3", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
+		{ Inst("\tmov R%0, R%1, lsl #%2", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
 	},
 	select_shri = {
 		{ Quad::seti(RECORD|2, ISIMM|3), Quad::shr(RECORD|0, RECORD|1, EQUAL|2) },
-		{ Inst("\tmov R%0, R%1, lsr #%3", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
+		{ Inst("\tmov R%0, R%1, lsr #%2", pwrite(COPY|0), pread(COPY|1), pcst(COPY|3)), Inst::end }
 	},
 	select_roli = {
 		{ Quad::seti(RECORD|2, ISIMM|3), Quad::rol(RECORD|0, RECORD|1, EQUAL|2) },
 		{ 
-			Inst("\tror R%0, R%1, #%4", pwrite(COPY|0), pread(COPY|1), pcst(COPY|4)),
+			Inst("\tror R%0, R%1, #%2", pwrite(COPY|0), pread(COPY|1), pcst(RCOMP|3)),
 			Inst::end 
 		}
 	},
@@ -289,8 +290,8 @@ select_t
 	select_goto_eq_seq = {
 		{ Quad::goto_eq(RECORD|0, RECORD|1, RECORD|2), Quad::goto_(RECORD|3), Quad::lab(EQUAL|0) },
 		{
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
-			Inst("\tbne L%3", pcst(COPY|3)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
+			Inst("\tbne L%0", pcst(COPY|3)),
 			Inst("L%0:", pcst(COPY|0)),
 			Inst::end
 		},
@@ -298,8 +299,8 @@ select_t
 	select_goto_ne_seq = {
 		{ Quad::goto_ne(RECORD|0, RECORD|1, RECORD|2), Quad::goto_(RECORD|3), Quad::lab(EQUAL|0) },
 		{
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
-			Inst("\tbeq L%3", pcst(COPY|3)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
+			Inst("\tbeq L%0", pcst(COPY|3)),
 			Inst("L%0:", pcst(COPY|0)),
 			Inst::end
 		},
@@ -307,8 +308,8 @@ select_t
 	select_goto_lt_seq = {
 		{ Quad::goto_lt(RECORD|0, RECORD|1, RECORD|2), Quad::goto_(RECORD|3), Quad::lab(EQUAL|0) },
 		{
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
-			Inst("\tbge L%3", pcst(COPY|3)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
+			Inst("\tbge L%0", pcst(COPY|3)),
 			Inst("L%0:", pcst(COPY|0)),
 			Inst::end
 		},
@@ -316,8 +317,8 @@ select_t
 	select_goto_le_seq = {
 		{ Quad::goto_le(RECORD|0, RECORD|1, RECORD|2), Quad::goto_(RECORD|3), Quad::lab(EQUAL|0) },
 		{
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
-			Inst("\tbg L%3", pcst(COPY|3)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
+			Inst("\tbgt L%0", pcst(COPY|3)),
 			Inst("L%0:", pcst(COPY|0)),
 			Inst::end
 		},
@@ -325,8 +326,8 @@ select_t
 	select_goto_gt_seq = {
 		{ Quad::goto_gt(RECORD|0, RECORD|1, RECORD|2), Quad::goto_(RECORD|3), Quad::lab(EQUAL|0) },
 		{
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
-			Inst("\tble L%3", pcst(COPY|3)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
+			Inst("\tble L%0", pcst(COPY|3)),
 			Inst("L%0:", pcst(COPY|0)),
 			Inst::end
 		},
@@ -334,19 +335,19 @@ select_t
 	select_goto_ge_seq = {
 		{ Quad::goto_ge(RECORD|0, RECORD|1, RECORD|2), Quad::goto_(RECORD|3), Quad::lab(EQUAL|0) },
 		{
-			Inst("\tcmp R%1, R%2", pread(COPY|1), pread(COPY|2)),
-			Inst("\tbl L%3", pcst(COPY|3)),
+			Inst("\tcmp R%0, R%1", pread(COPY|1), pread(COPY|2)),
+			Inst("\tblt L%0", pcst(COPY|3)),
 			Inst("L%0:", pcst(COPY|0)),
 			Inst::end
 		},
 	},
 	select_mul_pow2 = {
 		{ Quad::seti(RECORD|2, POW2|3), Quad::mul(RECORD|0, RECORD|1, EQUAL|2) },
-		{ Inst("\tmov R%0, R%1, lsl #%4", pwrite(COPY|0), pread(COPY|1), pcst(COPY|4)), Inst::end }
+		{ Inst("\tmov R%0, R%1, lsl #%2", pwrite(COPY|0), pread(COPY|1), pcst(LOG2|3)), Inst::end }
 	},
 	select_div_pow2 = {
 		{ Quad::seti(RECORD|2, POW2|3), Quad::div(RECORD|0, RECORD|1, EQUAL|2) },
-		{ Inst("\tmov R%0, R%1, lsr #%4", pwrite(COPY|0), pread(COPY|1), pcst(COPY|4)), Inst::end }
+		{ Inst("\tmov R%0, R%1, lsr #%2", pwrite(COPY|0), pread(COPY|1), pcst(LOG2|3)), Inst::end }
 	},
 	select_add_zero = {
 		{ Quad::seti(RECORD|1, ISIMM|0), Quad::add(RECORD|2, RECORD|2, EQUAL|0) },
@@ -446,17 +447,17 @@ inline action_t action(uint32_t x)
 inline uint32_t value(uint32_t x)
 	{ return static_cast<uint32_t>(x & 0x0000ffff); }
 
-int bitcount(int32_t v) {
+int bitcount(uint32_t v) {
 	int cnt = 0;
 	for(int i = 0; v && i < 32; i++, v >>= 1)
-		if((i & 1) != 0)
+		if((v & 1) != 0)
 			cnt++;
 	return cnt;
 }
 
 uint32_t rightmostbit(uint32_t x) {
 	for(int i = 0; i < 32; i++)
-		if((i & 1) != 0)
+		if(((x >> i) & 1) != 0)
 			return i;
 	return -1;
 }
@@ -518,6 +519,28 @@ bool matchQuad(const Quad& temp, const Quad& quad, uint32_t vars[]) {
 }
 
 
+/**
+ * Test if a register is read once in a sequence of quadruplets, before
+ * being written again.
+ * @param r		Register to look for.
+ * @param q		First quadruplet of the sequence.
+ * @param end	End of the sequence.
+ * @return		True if it is read once, false else.
+ */
+bool readOnce(Quad::reg_t r, const Quad *q, const Quad *end) {
+	int count = 0;
+	for(; q != end && count <= 1; q++) {
+		if(q->readsA() && q->a == r)
+			count++;
+		if(q->readsB() && q->b == r)
+			count++;
+		if(q->writes() && q->d == r)
+			break;
+	}
+	return count == 1;
+}
+
+
 /**
  * Make an instruction from instruction template and variables.
  * @param temp	Instruction template.
@@ -534,6 +557,9 @@ Inst makeInst(const Inst& temp, uint32_t vars[]) {
 		case LOG2:
 			inst[i] = Param(temp[i].type(), rightmostbit(vars[value(temp[i].value())]));
 			break;
+		case RCOMP:
+			inst[i] = Param(temp[i].type(), (32 - vars[value(temp[i].value())]) & 31);
+			break;
 		default:
 			assert(false);
 			break;
@@ -547,8 +573,9 @@ Inst makeInst(const Inst& temp, uint32_t vars[]) {
  * @param quads	List of quadruplets to select in.
  * @return		List of corresponding instructions.
  */
-list<Inst> select(const list<Quad>& quads) {
-	list<Inst> insts;
+vector<Inst> select(const Slice<Quad>& quads) {
+	vector<Inst> insts;
+	insts.reserve(quads.size());
 	uint32_t vars[16];
 
 	// traverse all instructions
@@ -562,11 +589,16 @@ list<Inst> select(const list<Quad>& quads) {
 			j = i;
 			selector = *s;
 			//cerr << "DEBUG:\t\tcheck " << (*s)->insts[0].format() << endl;
-			for(int x = 0; j != quads.end() && (*s)->quads[x].type != Quad::NOP; ++x, ++j)
-				if(!matchQuad((*s)->quads[x], *j, vars)) {
+			for(int x = 0; (*s)->quads[x].type != Quad::NOP; ++x, ++j)
+				if(j == quads.end() || !matchQuad((*s)->quads[x], *j, vars)) {
 					selector = nullptr;
 					break;
 				}
+
+			// a constant folded in an operation must not be used elsewhere
+			if(selector != nullptr && (*s)->quads[0].type == Quad::SETI
+			&& (*s)->quads[1].type != Quad::NOP && !readOnce(i->d, i + 1, quads.end()))
+				selector = nullptr;
 		}
 
 		// apply the selector
@@ -67,6 +67,6 @@ inline ostream& operator<<(ostream& out, const Inst& i)
 	{ i.print(out); return out; }
 
 
-list<Inst> select(const list<Quad>& quads);
+vector<Inst> select(const Slice<Quad>& quads);
 
 #endif // IOC_INST_HPP
@@ -0,0 +1,15 @@
+#ifndef IOC_LEXER_HPP
+#define IOC_LEXER_HPP
+
+#include <cstddef>
+#include "parser.hpp"
+
+// reentrant Flex interface
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+int yylex_init_extra(CompilationUnit *unit, yyscan_t *scanner);
+int yylex_destroy(yyscan_t scanner);
+YY_BUFFER_STATE yy_scan_buffer(char *base, size_t size, yyscan_t scanner);
+void yy_delete_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner);
+int yylex(YYSTYPE *lvalp, yyscan_t scanner);
+
+#endif	// IOC_LEXER_HPP
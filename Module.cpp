@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "AST.hpp"
+#include "Module.hpp"
+
+/**
+ * @class Module
+ * Precompiled declaration module: binary image of the const, reg and sig
+ * declarations of an imported source, with the constant expressions
+ * already evaluated. The image is mapped in memory as is and the entries
+ * are only decoded when a name is looked up.
+ *
+ * The image is made of:
+ * @li a header (magic "IOCM", format version, size and modification time
+ * of the source it has been compiled from),
+ * @li the entries sorted by name (so that look up is a binary search),
+ * @li the dependencies (sources imported by the source, directly or not,
+ * with their size and modification time),
+ * @li the string table of the names and of the dependency paths.
+ *
+ * Modules are stored with the native byte order: they are a cache of the
+ * sources, not a distribution format.
+ */
+
+/**
+ * @class Module::Stamp
+ * Identification of the version of a source: a module is only valid for
+ * the sources (its own and its dependencies) with the same size and
+ * modification time.
+ */
+
+/**
+ * Get the stamp of a file.
+ * @param path	File path.
+ * @return		True for success, false if the file cannot be accessed.
+ */
+bool Module::Stamp::get(const string& path) {
+	struct stat st;
+	if(stat(path.c_str(), &st) < 0)
+		return false;
+	size = st.st_size;
+	mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+	return true;
+}
+
+///
+Module::Module(): _map(nullptr), _size(0), _header(nullptr), _entries(nullptr), _deps(nullptr), _strings(nullptr) {
+}
+
+///
+Module::~Module() {
+	release();
+}
+
+/**
+ * Release the image.
+ */
+void Module::release() {
+	if(_map != nullptr)
+		munmap(_map, _size);
+	_map = nullptr;
+	_image.clear();
+	_header = nullptr;
+	_entries = nullptr;
+	_deps = nullptr;
+	_strings = nullptr;
+}
+
+/**
+ * Check the image and set up the access to the entries.
+ * @param size	Image size.
+ * @return		True if the image is valid, false else.
+ */
+bool Module::check(size_t size) {
+	if(size < sizeof(Header)
+	|| memcmp(_header->magic, "IOCM", 4) != 0
+	|| _header->version != version
+	|| _header->strings < sizeof(Header) + uint64_t(_header->count) * sizeof(Entry) + uint64_t(_header->deps) * sizeof(Dep)
+	|| uint64_t(_header->strings) + _header->strings_size > size)
+		return false;
+	auto base = reinterpret_cast<const char *>(_header);
+	_entries = reinterpret_cast<const Entry *>(base + sizeof(Header));
+	_deps = reinterpret_cast<const Dep *>(_entries + _header->count);
+	_strings = base + _header->strings;
+	for(uint32_t i = 0; i < _header->deps; i++)
+		if(uint64_t(_deps[i].path) + _deps[i].length > _header->strings_size)
+			return false;
+	return true;
+}
+
+/**
+ * Test if the module has been compiled from the current version of its
+ * source and of its dependencies. The files that cannot be accessed are
+ * not checked (module used without its sources).
+ * @return	True if the module is up to date.
+ */
+bool Module::upToDate() const {
+	Stamp s;
+	if(s.get(_source) && !(s == stamp()))
+		return false;
+	for(const auto& d: dependencies())
+		if(s.get(d.path) && !(s == d.stamp))
+			return false;
+	return true;
+}
+
+/**
+ * Get the stamp of the source the module has been compiled from.
+ * @return	Source stamp.
+ */
+Module::Stamp Module::stamp() const {
+	Stamp s;
+	s.size = _header->source_size;
+	s.mtime = _header->source_mtime;
+	return s;
+}
+
+/**
+ * Get the sources imported, directly or not, by the source of the module.
+ * @return	Dependencies.
+ */
+vector<Module::Dependency> Module::dependencies() const {
+	vector<Dependency> r(_header->deps);
+	for(uint32_t i = 0; i < _header->deps; i++) {
+		r[i].path = string(_strings + _deps[i].path, _deps[i].length);
+		r[i].stamp.size = _deps[i].size;
+		r[i].stamp.mtime = _deps[i].mtime;
+	}
+	return r;
+}
+
+/**
+ * Map in memory the module of a source (see pathOf()).
+ * @param source	Path of the source.
+ * @return			True for success, false if there is no module or
+ * 					if it is not up to date.
+ */
+bool Module::open(const string& source) {
+	release();
+	int fd = ::open(pathOf(source).c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	if(fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(Header)) {
+		close(fd);
+		return false;
+	}
+	void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED)
+		return false;
+	_map = base;
+	_size = st.st_size;
+	_header = static_cast<const Header *>(base);
+	_source = source;
+	if(!check(_size) || !upToDate()) {
+		release();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Use an image built in memory (when the module file cannot be written).
+ * @param source	Path of the source of the module.
+ * @param image		Module image.
+ * @return			True for success, false if the image is not valid.
+ */
+bool Module::assign(const string& source, const string& image) {
+	release();
+	_image = image;
+	_header = reinterpret_cast<const Header *>(_image.data());
+	_source = source;
+	if(!check(_image.size())) {
+		release();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Look for an entry by name.
+ * @param name	Name characters.
+ * @param len	Name length.
+ * @return		Found entry or a null pointer.
+ */
+const Module::Entry *Module::find(const char *name, size_t len) const {
+	uint32_t l = 0, h = _header->count;
+	while(l < h) {
+		uint32_t m = l + (h - l) / 2;
+		const Entry& e = _entries[m];
+		if(!valid(e))
+			return nullptr;
+		int c = memcmp(_strings + e.name, name, min(size_t(e.length), len));
+		if(c == 0)
+			c = e.length < len ? -1 : e.length > len ? 1 : 0;
+		if(c == 0)
+			return &e;
+		else if(c < 0)
+			l = m + 1;
+		else
+			h = m;
+	}
+	return nullptr;
+}
+
+/**
+ * Build the image of a module.
+ * @param decls		Exported declarations (only const, reg and sig; the
+ * 					registers of the signals must be part of them).
+ * @param stamp		Stamp of the source of the module.
+ * @param deps		Dependencies of the source.
+ * @return			Module image.
+ */
+string Module::build(const vector<Declaration *>& decls, const Stamp& stamp, const vector<Dependency>& deps) {
+	vector<Declaration *> sorted = decls;
+	sort(sorted.begin(), sorted.end(),
+		[](Declaration *d1, Declaration *d2) { return d1->name() < d2->name(); });
+
+	// build the entries and the string table
+	vector<Entry> entries(sorted.size());
+	string strings;
+	for(size_t i = 0; i < sorted.size(); i++) {
+		auto d = sorted[i];
+		Entry& e = entries[i];
+		memset(&e, 0, sizeof(Entry));
+		e.name = strings.size();
+		e.length = d->name().size();
+		e.type = d->type();
+		e.line = d->pos.line;
+		strings += d->name();
+		strings += '\0';
+		switch(d->type()) {
+		case Declaration::CST:
+			e.value = int64_t(static_cast<ConstDecl *>(d)->value());
+			break;
+		case Declaration::REG:
+			e.value = static_cast<RegDecl *>(d)->address();
+			break;
+		case Declaration::SIG: {
+				auto s = static_cast<SigDecl *>(d);
+				e.bit = s->bit();
+				e.reg = find_if(sorted.begin(), sorted.end(),
+					[s](Declaration *r) { return r == s->reg(); }) - sorted.begin();
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	// build the dependencies
+	vector<Dep> ds(deps.size());
+	for(size_t i = 0; i < deps.size(); i++) {
+		ds[i].path = strings.size();
+		ds[i].length = deps[i].path.size();
+		ds[i].size = deps[i].stamp.size;
+		ds[i].mtime = deps[i].stamp.mtime;
+		strings += deps[i].path;
+		strings += '\0';
+	}
+
+	// assemble the image
+	Header h;
+	memset(&h, 0, sizeof(Header));
+	memcpy(h.magic, "IOCM", 4);
+	h.version = version;
+	h.source_size = stamp.size;
+	h.source_mtime = stamp.mtime;
+	h.count = entries.size();
+	h.deps = ds.size();
+	h.strings = sizeof(Header) + entries.size() * sizeof(Entry) + ds.size() * sizeof(Dep);
+	h.strings_size = strings.size();
+	string image(reinterpret_cast<const char *>(&h), sizeof(Header));
+	image.append(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(Entry));
+	image.append(reinterpret_cast<const char *>(ds.data()), ds.size() * sizeof(Dep));
+	image += strings;
+	return image;
+}
+
+/**
+ * Get the path of the module of a source: "x.io" gives "x.iom".
+ * @param source	Source path.
+ * @return			Module path.
+ */
+string Module::pathOf(const string& source) {
+	if(source.size() > 3 && source.compare(source.size() - 3, 3, ".io") == 0)
+		return source + "m";
+	else
+		return source + ".iom";
+}
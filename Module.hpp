@@ -0,0 +1,95 @@
+#ifndef IOC_MODULE_HPP
+#define IOC_MODULE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+class Declaration;
+
+class Module {
+public:
+	static constexpr uint32_t version = 1;
+
+	class Stamp {
+	public:
+		inline Stamp(): size(0), mtime(0) { }
+		bool get(const string& path);
+		inline bool operator==(const Stamp& s) const { return size == s.size && mtime == s.mtime; }
+		uint64_t size;
+		int64_t mtime;
+	};
+
+	class Dependency {
+	public:
+		string path;
+		Stamp stamp;
+	};
+
+	class Header {
+	public:
+		char magic[4];
+		uint32_t version;
+		uint64_t source_size;
+		int64_t source_mtime;
+		uint32_t count;
+		uint32_t deps;
+		uint32_t strings;
+		uint32_t strings_size;
+	};
+
+	class Entry {
+	public:
+		uint32_t name;
+		uint32_t length;
+		uint32_t type;
+		uint32_t line;
+		uint64_t value;
+		uint32_t reg;
+		uint32_t bit;
+	};
+
+	class Dep {
+	public:
+		uint32_t path;
+		uint32_t length;
+		uint64_t size;
+		int64_t mtime;
+	};
+
+	Module();
+	Module(const Module&) = delete;
+	Module& operator=(const Module&) = delete;
+	~Module();
+
+	bool open(const string& source);
+	bool assign(const string& source, const string& image);
+	inline const string& source() const { return _source; }
+	Stamp stamp() const;
+	vector<Dependency> dependencies() const;
+	inline uint32_t count() const { return _header->count; }
+	inline const Entry& entry(uint32_t i) const { return _entries[i]; }
+	inline const char *name(const Entry& e) const { return _strings + e.name; }
+	const Entry *find(const char *name, size_t len) const;
+	inline bool valid(const Entry& e) const { return uint64_t(e.name) + e.length <= _header->strings_size; }
+	bool upToDate() const;
+
+	static string build(const vector<Declaration *>& decls, const Stamp& stamp, const vector<Dependency>& deps);
+	static string pathOf(const string& source);
+
+private:
+	bool check(size_t size);
+	void release();
+	string _source;
+	string _image;
+	void *_map;
+	size_t _size;
+	const Header *_header;
+	const Entry *_entries;
+	const Dep *_deps;
+	const char *_strings;
+};
+
+#endif	// IOC_MODULE_HPP
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include "AST.hpp"
 #include "Quad.hpp"
 #include <string>
 using namespace std;
@@ -80,7 +82,7 @@ void Quad::print(ostream& out) const {
  */
 
 ///
-QuadProgram::QuadProgram(): _vreg(Quad::HARD_COUNT), _lab(1) {}
+QuadProgram::QuadProgram(): _vreg(Quad::HARD_COUNT), _lab(1), _reg_base(_vreg), _lab_base(_lab) {}
 
 /**
  * Add a quadruplet to the program.
@@ -106,6 +108,93 @@ Quad::lab_t QuadProgram::newLab() {
 	return _lab++;
 }
 
+/**
+ * Skip registers and labels, as if they were allocated by a part of
+ * the program generated elsewhere.
+ * @param regs	Number of registers to skip.
+ * @param labs	Number of labels to skip.
+ */
+void QuadProgram::skip(unsigned regs, unsigned labs) {
+	_vreg += regs;
+	_lab += labs;
+}
+
+/**
+ * Build a program to generate a part of this program in. The part has
+ * the same variables and allocates its registers and labels from the
+ * current counters of this program: several parts can be generated
+ * concurrently and then appended in order with append().
+ * @return	Part program.
+ */
+QuadProgram QuadProgram::fork() const {
+	QuadProgram part;
+	part._vreg = part._reg_base = _vreg;
+	part._lab = part._lab_base = _lab;
+	part._map = _map;
+	part._vars = _vars;
+	return part;
+}
+
+/**
+ * Append a part forked from this program, renumbering the registers and
+ * the labels allocated by the part to follow the ones of this program.
+ * The result is the same as if the part had been generated in this
+ * program. The part is left empty.
+ * @param part	Part to append.
+ */
+void QuadProgram::append(QuadProgram& part) {
+	Quad::arg_t reg_off = _vreg - part._reg_base, lab_off = _lab - part._lab_base;
+	auto reg = [&](Quad::arg_t& r) { if(r >= part._reg_base) r += reg_off; };
+	auto lab = [&](Quad::arg_t& l) { if(l >= part._lab_base) l += lab_off; };
+
+	// renumber the quads
+	if(reg_off != 0 || lab_off != 0)
+		for(auto& q: part._quads)
+			switch(q.type) {
+			case Quad::NOP:
+			case Quad::RETURN:
+			case Quad::CALL:
+				break;
+			case Quad::SETI:
+				reg(q.d);
+				break;
+			case Quad::SETL:
+				reg(q.d);
+				lab(q.a);
+				break;
+			case Quad::LAB:
+			case Quad::GOTO:
+				lab(q.d);
+				break;
+			case Quad::GOTO_EQ:
+			case Quad::GOTO_NE:
+			case Quad::GOTO_LT:
+			case Quad::GOTO_LE:
+			case Quad::GOTO_GT:
+			case Quad::GOTO_GE:
+				lab(q.d);
+				reg(q.a);
+				reg(q.b);
+				break;
+			default:
+				reg(q.d);
+				reg(q.a);
+				reg(q.b);
+				break;
+			}
+
+	// move quads and comments
+	for(const auto& c: part._coms)
+		_coms.push_back({ c.quad + uint32_t(_quads.size()), fileId(part._files[c.file]), c.line });
+	part._coms.clear();
+	_quads.insert(_quads.end(), part._quads.begin(), part._quads.end());
+	part._quads.clear();
+	_vreg += part._vreg - part._reg_base;
+	_lab += part._lab - part._lab_base;
+	part._vreg = part._reg_base;
+	part._lab = part._lab_base;
+}
+
 /**
  * Assocate a name with a new virtual register.
  * @param name		Name to associate with.
@@ -114,9 +203,25 @@ Quad::lab_t QuadProgram::newLab() {
 Quad::reg_t QuadProgram::declare(string name) {
 	auto r = newReg();
 	_map[name] = r;
+	_vars.push_back(r);
 	return r;
 }
 
+/**
+ * @fn const vector<Quad::reg_t>& QuadProgram::variables() const;
+ * Get the registers of the declared variables, in declaration order.
+ */
+
+/**
+ * Release the memory of the quads and of their comments once they are
+ * no longer needed (the CFGs built on them must have been deleted).
+ * The variables and the register and label counters are kept.
+ */
+void QuadProgram::releaseQuads() {
+	vector<Quad>().swap(_quads);
+	vector<Comment>().swap(_coms);
+}
+
 /**
  * Get the virtual register number for a name.
  * @param name		Looked name.
@@ -126,6 +231,59 @@ Quad::reg_t QuadProgram::regFor(string name) {
 	return _map[name];
 }
 
+/**
+ * Remove and insert quads in the program. The comments of a removed
+ * quad are moved to the next kept quad, unless all the quads up to the
+ * next comments are removed (labels apart): the comments are then
+ * dropped. The quads inserted before a quad are put before its comments.
+ * @param removed	Quads to remove (indexed like the quads).
+ * @param inserted	Quads to insert, each with the index of the quad to
+ * 					insert it before (in any order, the quads inserted
+ * 					at the same place keep their order).
+ */
+void QuadProgram::rewrite(const vector<bool>& removed, vector<pair<size_t, Quad> > inserted) {
+	stable_sort(inserted.begin(), inserted.end(),
+		[](const pair<size_t, Quad>& x, const pair<size_t, Quad>& y) { return x.first < y.first; });
+	vector<Quad> quads;
+	quads.reserve(_quads.size() + inserted.size());
+	vector<Comment> coms;
+	coms.reserve(_coms.size());
+	size_t group = 0;				// comments of the current quads
+	bool had = false, has = false;	// code in the current quads before and after
+	auto drop = [&]() {
+		if(had && !has)
+			coms.resize(group);
+	};
+	auto c = _coms.begin();
+	auto in = inserted.begin();
+	for(size_t i = 0; i <= _quads.size(); i++) {
+		for(; in != inserted.end() && in->first == i; ++in) {
+			quads.push_back(in->second);
+			has = true;
+		}
+		if(c != _coms.end() && c->quad == i) {
+			drop();
+			group = coms.size();
+			had = has = false;
+			for(; c != _coms.end() && c->quad == i; ++c) {
+				coms.push_back(*c);
+				coms.back().quad = quads.size();
+			}
+		}
+		if(i < _quads.size()) {
+			bool code = _quads[i].type != Quad::LAB;
+			had |= code;
+			if(!removed[i]) {
+				quads.push_back(_quads[i]);
+				has |= code;
+			}
+		}
+	}
+	drop();
+	_quads.swap(quads);
+	_coms.swap(coms);
+}
+
 /**
  * Print the program.
  * @param out	Stream to output to.
@@ -138,12 +296,10 @@ void QuadProgram::print(ostream& out) {
 
 	// print quadruplets
 	auto c = _coms.begin();
-	int i = 0;
+	uint32_t i = 0;
 	for(const auto& q: _quads) {
-		if(c != _coms.end() && c->first == i) {
-			out << "\t@ " << c->second << endl;
-			++c;
-		}
+		for(; c != _coms.end() && c->quad == i; ++c)
+			out << "\t@ " << _files[c->file] << ':' << c->line << endl;
 		if(q.type == Quad::LAB)
 			out << 'L' << q.label() << endl;
 		else
@@ -154,15 +310,32 @@ void QuadProgram::print(ostream& out) {
 }
 
 /**
- * Add a comment to the next generated quadruplet.
- * @param com	Added comment.
+ * Record the source position of the next generated quadruplet. Only the
+ * quad index, the file and the line are stored: the comment is formatted
+ * when the program is printed.
+ * @param pos	Source position.
  */
-void QuadProgram::comment(std::string com) {
-	_coms.push_back(pair(_quads.size(), com));
+void QuadProgram::comment(const Position& pos) {
+	_coms.push_back({ uint32_t(_quads.size()), fileId(pos.file), pos.line });
 }
 
 /**
- * Build a CFG from the quad list.
+ * Get the identifier of a file name in the comments.
+ * @param file	File name (compared by address).
+ * @return		File identifier.
+ */
+uint32_t QuadProgram::fileId(const char *file) {
+	for(size_t i = _files.size(); i > 0; i--)
+		if(_files[i - 1] == file)
+			return i - 1;
+	_files.push_back(file);
+	return _files.size() - 1;
+}
+
+/**
+ * Build a CFG from the quad list. The branches to labels that are not
+ * part of the program have no target. The BBs refer to the quads of the
+ * program: the program must not be changed while the CFG is used.
  * @return	Built CFG (ownership transferred to the caller).
  */
 CFG<Quad> *QuadProgram::makeCFG() {
@@ -174,10 +347,13 @@ CFG<Quad> *QuadProgram::makeCFG() {
 	// build BB
 	bool labels = true;
 	BB<Quad> *bb = nullptr;
-	list<Quad> qs;
+	size_t first = 0;
 	BB<Quad> *prev = g->entry();
+	auto slice = [this](size_t b, size_t e)
+		{ return Slice<Quad>(_quads.data() + b, _quads.data() + e); };
 
-	for(auto q: _quads) {
+	for(size_t i = 0; i < _quads.size(); i++) {
+		const Quad& q = _quads[i];
 
 		// create BB
 		if(bb == nullptr) {
@@ -191,32 +367,29 @@ CFG<Quad> *QuadProgram::makeCFG() {
 
 		case Quad::LAB:
 			if(!labels) {
-				bb->setInstructions(qs);
+				bb->setInstructions(slice(first, i));
 				prev = bb;
-				qs.clear();
+				first = i;
 				labels = true;
 				bb = new BB<Quad>();
 				g->add(bb);
 				prev->setNext(bb);
 			}
 			map[q.label()] = bb;
-			qs.push_back(q);
 			break;
 
 		case Quad::RETURN:
-			qs.push_back(q);
-			bb->setInstructions(qs);
+			bb->setInstructions(slice(first, i + 1));
 			bb->setNext(g->exit());
-			qs.clear();
+			first = i + 1;
 			prev = nullptr;
 			bb = nullptr;
 			labels = true;
 			break;
 
 		case Quad::GOTO:
-			qs.push_back(q);
-			bb->setInstructions(qs);
-			qs.clear();
+			bb->setInstructions(slice(first, i + 1));
+			first = i + 1;
 			prev = nullptr;
 			bb = nullptr;
 			labels = true;
@@ -228,25 +401,22 @@ CFG<Quad> *QuadProgram::makeCFG() {
 		case Quad::GOTO_LE:
 		case Quad::GOTO_GT:
 		case Quad::GOTO_GE:
-			qs.push_back(q);
-			bb->setInstructions(qs);
-			qs.clear();
+			bb->setInstructions(slice(first, i + 1));
+			first = i + 1;
 			prev = bb;
 			bb = nullptr;
 			labels = true;
 			break;
 
 		default:
-			qs.push_back(q);
 			labels = false;
 			break;
 		}
-
 	}
 
 	// finish current (shouldn't arise)
 	if(bb != nullptr)
-		bb->setInstructions(qs);
+		bb->setInstructions(slice(first, _quads.size()));
 
 	// fix the branches
 	for(auto bb: g->basicBlocks())
@@ -259,8 +429,11 @@ CFG<Quad> *QuadProgram::makeCFG() {
 			case Quad::GOTO_LT:
 			case Quad::GOTO_LE:
 			case Quad::GOTO_GT:
-			case Quad::GOTO_GE:
-				bb->setTarget(map[q.label()]);
+			case Quad::GOTO_GE: {
+					auto t = map.find(q.label());
+					if(t != map.end())
+						bb->setTarget(t->second);
+				}
 				break;
 			default:
 				break;
@@ -1,16 +1,21 @@
 #ifndef IOC_QUAD_HPP
 #define IOC_QUAD_HPP
 
+#include <cstdint>
 #include <iostream>
 #include <list>
 #include <map>
+#include <vector>
 using namespace std;
 
 #include "CFG.hpp"
 
+class Position;
+class SSAForm;
+
 class Quad {
 public:
-	typedef unsigned long arg_t;
+	typedef uint32_t arg_t;
 	typedef arg_t reg_t;
 	typedef arg_t lab_t;
 	typedef arg_t val_t;
@@ -24,7 +29,7 @@ public:
 
 	static string reg(int i);
 
-	typedef enum {
+	typedef enum : uint8_t {
 		NOP,
 		SETI,
 		SETL,
@@ -62,12 +67,21 @@ public:
 	inline Quad(): type(NOP), d(0), a(0), b(0) {}
 	inline Quad(type_t type_, arg_t d_ = 0, arg_t a_ = 0, arg_t b_ = 0)
 		: type(type_), d(d_), a(a_), b(b_) {}
-	inline Quad(const Quad& q): type(q.type), d(q.d), a(q.a), b(q.b) {}
 
 	lab_t label() const { return d; }
 	val_t cst() const { return a; }
 	reg_t addr() const { return a; }
 
+	inline bool writes() const
+		{ return (type >= SETI && type <= ROR) || type == LOAD || type == POP; }
+	inline bool readsA() const
+		{ return (type >= SET && type <= ROR) || (type >= GOTO_EQ && type <= GOTO_GE)
+			|| type == LOAD || type == STORE || type == PUSH; }
+	inline bool readsB() const
+		{ return (type >= ADD && type <= ROR) || (type >= GOTO_EQ && type <= GOTO_GE) || type == STORE; }
+	inline bool endsBlock() const
+		{ return (type >= GOTO && type <= GOTO_GE) || type == RETURN; }
+
 	type_t type;
 	arg_t d, a, b;
 
@@ -108,24 +122,57 @@ public:
 };
 inline ostream& operator<<(ostream& out, const Quad& q) { q.print(out); return out; }
 
+template <>
+class BBStorage<Quad> {
+public:
+	typedef Slice<Quad> insts_t;
+};
+
 
 class QuadProgram {
 public:
 	QuadProgram();
 	void emit(const Quad& q);
+	inline size_t count() const { return _quads.size(); }
 	Quad::reg_t newReg();
 	Quad::lab_t newLab();
+	inline unsigned regCount() const { return _vreg; }
+	inline unsigned labCount() const { return _lab; }
+	void skip(unsigned regs, unsigned labs);
+	QuadProgram fork() const;
+	void append(QuadProgram& part);
 	Quad::reg_t declare(string name);
 	Quad::reg_t regFor(string name);
+	inline const vector<Quad::reg_t>& variables() const { return _vars; }
+	void releaseQuads();
+	size_t numberValues();
+	size_t eliminateRedundancies(const vector<Quad::lab_t>& entries);
+	size_t eliminateDeadCode();
+	size_t propagateConstants(const vector<Quad::lab_t>& entries);
+	SSAForm *makeSSA(const vector<Quad::lab_t>& entries);
+	void restoreRegisters(SSAForm& ssa);
 	void print(ostream& out);
-	void comment(string com);
+	void comment(const Position& pos);
 	CFG<Quad> *makeCFG();
 private:
 	unsigned _vreg;
 	unsigned _lab;
-	list<Quad> _quads;
+	unsigned _reg_base;
+	unsigned _lab_base;
+	vector<Quad> _quads;
 	map<string, Quad::reg_t> _map;
-	list<pair<int, string> > _coms;
+	vector<Quad::reg_t> _vars;
+
+	class Comment {
+	public:
+		uint32_t quad;
+		uint32_t file;
+		int line;
+	};
+	uint32_t fileId(const char *file);
+	void rewrite(const vector<bool>& removed, vector<pair<size_t, Quad> > inserted = {});
+	vector<Comment> _coms;
+	vector<const char *> _files;
 };
 
 #endif // IOC_QUAD_HPP
@@ -5,24 +5,61 @@ using namespace std;
 #include <algorithm>
 
 /**
- * @class StackMapper
- * Map the variable to stack offset.
+ * @class StackLayout
+ * Layout of the global variables in the stack. Once built, it is shared
+ * (read-only) by the stack mappers of all BBs.
  */
 
 /**
  */
-StackMapper::StackMapper(): _offset(0), _global(0) {
+StackLayout::StackLayout(): _offset(0), _global(0) {
 }
 
 /**
- * Add a variable to the map.
+ * Add a variable to the layout.
  * @param reg	Assign a stack offset to the register.
  */
-void StackMapper::add(Quad::reg_t reg) {
+void StackLayout::add(Quad::reg_t reg) {
 	_offset -= 4;
 	_offsets[reg] = _offset;
 }
 
+/**
+ * Mark the current stack position as being the end of the global variable save area.
+ */
+void StackLayout::markGlobal() {
+	_global = _offset;
+}
+
+/**
+ * @fn int32_t StackLayout::global() const;
+ * Get the end of the global variable save area.
+ */
+
+/**
+ * @fn const map<Quad::reg_t, int32_t>& StackLayout::offsets() const;
+ * Get the offsets of the registers of the layout.
+ */
+
+
+/**
+ * @class StackMapper
+ * Map the variable to stack offset in a BB: the temporaries of the BB
+ * are allocated after the global variables of the layout. As each BB has
+ * its own mapper, the BBs can be allocated in parallel.
+ */
+
+/**
+ * Build a mapper starting with the global variables of the layout.
+ * @param layout	Layout of the global variables.
+ */
+StackMapper::StackMapper(const StackLayout& layout)
+: _offset(layout.global()), _global(layout.global()) {
+	for(auto p: layout.offsets())
+		if(p.second >= _global)
+			_offsets.insert(p);
+}
+
 /**
  * Get the offset of a register.
  * @param reg	Register to get offset of.
@@ -39,18 +76,6 @@ int32_t StackMapper::offsetOf(Quad::reg_t reg) {
 	}
 }
 
-/**
- * @fn uint32_t StackMapper::stackSize() const;
- * Get the size to allocate in the stack.
- */
-
-/**
- * Mark the current stack position as being the end of the global variable save area.
- */
-void StackMapper::markGlobal() {
-	_global = _offset;
-}
-
 /**
  * Test if a virtual register is a global variable register.
  * @param reg	Virtual register to look.
@@ -58,21 +83,17 @@ void StackMapper::markGlobal() {
  */
 bool StackMapper::isGlobal(Quad::reg_t reg) {
 	auto p = _offsets.find(reg);
-	return p != _offsets.end() && (*p).second < _global;
+	return p != _offsets.end() && (*p).second >= _global;
 }
 
 /**
- * Rewind the size of the stack to the given size to remove temporary allocation,
- * to keep only global variables.
+ * Test if a virtual register has a stack offset, that is, if it is a
+ * global variable or a temporary spilled in the BB.
+ * @param reg	Virtual register to look.
+ * @return		True if the register has a stack offset.
  */
-void StackMapper::rewind() {
-	_offset = _global;
-	vector<int32_t> to_remove;
-	for(auto p: _offsets)
-		if(p.second < _global)
-			to_remove.push_back(p.first);
-	for(auto v: to_remove)
-		_offsets.erase(v);
+bool StackMapper::isMapped(Quad::reg_t reg) {
+	return _offsets.find(reg) != _offsets.end();
 }
 
 
@@ -87,9 +108,9 @@ void StackMapper::rewind() {
  * @param insts		List of instruction to complete with allocated instructions
  * 					and stack store/load instructions.
  */
-RegAlloc::RegAlloc(StackMapper& mapper, list<Inst>& insts)
+RegAlloc::RegAlloc(StackMapper& mapper, vector<Inst>& insts)
 : _mapper(mapper), _insts(insts) {
-	for(int i = 0; i < Quad::ALLOC_COUNT; i++)
+	for(int i = Quad::ALLOC_COUNT - 1; i >= 0; i--)
 		_avail.push_back(i);
 }
 
@@ -98,15 +119,18 @@ RegAlloc::RegAlloc(StackMapper& mapper, list<Inst>& insts)
  * @param inst		Instruction sto process.
  */
 void RegAlloc::process(Inst inst) {
-    for (int i = 0; i < Inst::param_num; ++i) {
-        Param& param = inst[i];
-
-        if (param.type() == Param::READ) {
-            processRead(param);
-        } else if (param.type() == Param::WRITE) {
-            processWrite(param);
-        }
-    }
+    _used.clear();
+    for (int i = 0; i < Inst::param_num; ++i)
+        if (inst[i].type() == Param::READ || inst[i].type() == Param::WRITE)
+            _used.push_back(inst[i].value());
+
+    // the reads first as they may load a register also written
+    for (int i = 0; i < Inst::param_num; ++i)
+        if (inst[i].type() == Param::READ)
+            processRead(inst[i]);
+    for (int i = 0; i < Inst::param_num; ++i)
+        if (inst[i].type() == Param::WRITE)
+            processWrite(inst[i]);
 
     _insts.push_back(inst);
 
@@ -119,11 +143,22 @@ void RegAlloc::process(Inst inst) {
 
 /**
  * Complete the allocation of a BB by generating store of modified global variables.
+ * The stores are placed before the branch ending the BB, if any; the variables
+ * spilled in the BB have already been stored.
  */
 void RegAlloc::complete() {
+    Inst branch;
+    bool ends = !_insts.empty() && isBranch(_insts.back());
+    if (ends) {
+        branch = _insts.back();
+        _insts.pop_back();
+    }
     for (const auto& virt_reg : _written) {
-        store(virt_reg);
+        if (find(virt_reg) != _map.end())
+            store(virt_reg);
     }
+    if (ends)
+        _insts.push_back(branch);
 }
 
 /**
@@ -134,9 +169,10 @@ void RegAlloc::processRead(Param& param) {
     assert("parameter should be a read parameter!" && param.type() == Param::READ);
 
     Quad::reg_t virt_reg = param.value();
+    bool loaded = find(virt_reg) != _map.end();
     Quad::reg_t phys_reg = allocate(virt_reg);
 
-    if (isVar(virt_reg) && _map.find(virt_reg) == _map.end()) { // not already loaded
+    if (!loaded && _mapper.isMapped(virt_reg)) { // variable or spilled temporary
         load(virt_reg);
     }
 
@@ -173,27 +209,25 @@ void RegAlloc::processWrite(Param& param) {
 
 /**
  * Allocate an hardware register through the free ones or spill a register
- * to get a new free hardware register.
+ * to get a new free hardware register. The registers used by the current
+ * instruction are never spilled.
  */
 Quad::reg_t RegAlloc::allocate(Quad::reg_t reg) {
-    if (_map.find(reg) != _map.end()) {
-        return _map[reg];
+    auto p = find(reg);
+    if (p != _map.end()) {
+        return p->second;
     }
 
-    if (!_avail.empty()) {
-        Quad::reg_t phys_reg = _avail.front();
-        _avail.pop_front();
-        _map[reg] = phys_reg;
-        return phys_reg;
+    if (_avail.empty()) {
+        auto q = _map.begin();
+        while (std::find(_used.begin(), _used.end(), q->first) != _used.end())
+            ++q;
+        spill(q->first);
     }
 
-    Quad::reg_t to_spill = _map.begin()->first;
-    spill(to_spill);
-
-    Quad::reg_t phys_reg = _map[to_spill];
-    _map.erase(to_spill);
-    _map[reg] = phys_reg;
-
+    Quad::reg_t phys_reg = _avail.back();
+    _avail.pop_back();
+    at(reg) = phys_reg;
     return phys_reg;
 }
 
@@ -203,8 +237,8 @@ Quad::reg_t RegAlloc::allocate(Quad::reg_t reg) {
  */
 void RegAlloc::spill(Quad::reg_t reg) {
 	store(reg);
-	_avail.push_front(_map[reg]);
-	_map.erase(reg);
+	_avail.push_back(at(reg));
+	erase(reg);
 }
 
 /**
@@ -212,10 +246,10 @@ void RegAlloc::spill(Quad::reg_t reg) {
  * @param reg	Virtual register to free.
  */
 void RegAlloc::free(Quad::reg_t reg) {
-    auto vr = _map.find(reg);
+    auto vr = find(reg);
     if (vr != _map.end()) {
         Quad::reg_t phys_reg = vr->second;
-        _avail.push_front(phys_reg);
+        _avail.push_back(phys_reg);
         _map.erase(vr);
     }
 }
@@ -225,7 +259,7 @@ void RegAlloc::free(Quad::reg_t reg) {
  * @param reg		Virtual register to store.
  */
 void RegAlloc::store(Quad::reg_t reg) {
-	auto hreg = _map[reg];
+	auto hreg = at(reg);
 	auto offset = _mapper.offsetOf(reg);
 	_insts.push_back(Inst("\tstr R%0, [SP, #%1]", Param::read(hreg), Param::cst(offset)));
 }
@@ -236,11 +270,20 @@ void RegAlloc::store(Quad::reg_t reg) {
  * @param offset	Offset in the stack of the value to load.
  */
 void RegAlloc::load(Quad::reg_t reg) {
-	auto hreg = _map[reg];
+	auto hreg = at(reg);
 	auto offset = _mapper.offsetOf(reg);
 	_insts.push_back(Inst("\tldr R%0, [SP, #%1]", Param::write(hreg), Param::cst(offset)));
 }
 
+/**
+ * Test if an instruction is a branch.
+ * @param inst	Instruction to test.
+ * @return		True if it is a branch.
+ */
+bool RegAlloc::isBranch(const Inst& inst) {
+	return inst.format() != nullptr && inst.format()[0] == '\t' && inst.format()[1] == 'b';
+}
+
 /**
  * Test if a virtual register contains a variable.
  * @param reg	Virtual register to test.
@@ -249,3 +292,40 @@ void RegAlloc::load(Quad::reg_t reg) {
 bool RegAlloc::isVar(Quad::reg_t reg) const {
 	return _mapper.isGlobal(reg);
 }
+
+/**
+ * Find the mapping of a virtual register.
+ * @param reg	Virtual register to look for.
+ * @return		Iterator on the mapping or _map.end().
+ */
+RegAlloc::map_t::iterator RegAlloc::find(Quad::reg_t reg) {
+	for(auto p = _map.begin(); p != _map.end() && p->first <= reg; ++p)
+		if(p->first == reg)
+			return p;
+	return _map.end();
+}
+
+/**
+ * Get the hardware register mapped to a virtual register, mapping it
+ * to R0 if it is not mapped.
+ * @param reg	Virtual register.
+ * @return		Reference on the mapped hardware register.
+ */
+Quad::reg_t& RegAlloc::at(Quad::reg_t reg) {
+	auto p = _map.begin();
+	while(p != _map.end() && p->first < reg)
+		++p;
+	if(p == _map.end() || p->first != reg)
+		p = _map.insert(p, make_pair(reg, Quad::reg_t(0)));
+	return p->second;
+}
+
+/**
+ * Remove the mapping of a virtual register, if any.
+ * @param reg	Virtual register.
+ */
+void RegAlloc::erase(Quad::reg_t reg) {
+	auto p = find(reg);
+	if(p != _map.end())
+		_map.erase(p);
+}
@@ -1,21 +1,33 @@
 #ifndef IOC_REGALLOC_HPP
 #define IOC_REGALLOC_HPP
 
-#include <list>
 #include <map>
+#include <utility>
+#include <vector>
 using namespace std;
 
 #include "Inst.hpp"
 #include "Quad.hpp"
+#include "SmallVector.hpp"
 
-class StackMapper {
+class StackLayout {
 public:
-	StackMapper();
+	StackLayout();
 	void add(Quad::reg_t reg);
-	int32_t offsetOf(Quad::reg_t reg);
 	void markGlobal();
+	inline int32_t global() const { return _global; }
+	inline const map<Quad::reg_t, int32_t>& offsets() const { return _offsets; }
+private:
+	int32_t _offset, _global;
+	map<Quad::reg_t, int32_t> _offsets;
+};
+
+class StackMapper {
+public:
+	StackMapper(const StackLayout& layout);
+	int32_t offsetOf(Quad::reg_t reg);
 	bool isGlobal(Quad::reg_t reg);
-	void rewind();
+	bool isMapped(Quad::reg_t reg);
 private:
 	int32_t _offset, _global;
 	map<Quad::reg_t, int32_t> _offsets;
@@ -23,7 +35,7 @@ private:
 
 class RegAlloc {
 public:
-	RegAlloc(StackMapper& mapper, list<Inst>& insts);
+	RegAlloc(StackMapper& mapper, vector<Inst>& insts);
 	void process(Inst inst);
 	void complete();
 private:
@@ -35,13 +47,20 @@ private:
 	void store(Quad::reg_t reg);
 	void load(Quad::reg_t reg);
 	bool isVar(Quad::reg_t reg) const;
+	static bool isBranch(const Inst& inst);
+
+	typedef SmallVector<pair<Quad::reg_t, Quad::reg_t>, Quad::ALLOC_COUNT + 1> map_t;
+	map_t::iterator find(Quad::reg_t reg);
+	Quad::reg_t& at(Quad::reg_t reg);
+	void erase(Quad::reg_t reg);
 
-	map<Quad::reg_t, Quad::reg_t> _map; // reg (virt) -> reg (phys) => mapping
-	list<Quad::reg_t> _written; // reg (virt) written in the BB
-	list<Quad::reg_t> _avail; // reg (phys) available for allocation
+	map_t _map; // reg (virt) -> reg (phys) => mapping, sorted by virt
+	SmallVector<Quad::reg_t, 16> _written; // reg (virt) written in the BB
+	SmallVector<Quad::reg_t, Quad::ALLOC_COUNT> _avail; // reg (phys) available for allocation, next at back
 	StackMapper& _mapper; // reg -> offset in stack mapping (stack) 
-	list<Inst>& _insts; // instructions to add the generated code to 
-	list<Quad::reg_t> _fried; // reg (phys) to free
+	vector<Inst>& _insts; // instructions to add the generated code to 
+	SmallVector<Quad::reg_t, Inst::param_num> _fried; // reg (phys) to free
+	SmallVector<Quad::reg_t, Inst::param_num> _used; // reg (virt) used by the current instruction
 };
 
 #endif	// IOC_REGALLOC_HPP
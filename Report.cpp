@@ -0,0 +1,261 @@
+#include <iomanip>
+#include <sys/resource.h>
+#include <time.h>
+#include "Report.hpp"
+
+/**
+ * Counter of the heap allocations of the calling thread, installed by the
+ * programs replacing the allocation operators (see alloc.cpp).
+ */
+static size_t (*alloc_counter)() = nullptr;
+
+
+/**
+ * @class Report
+ * Record the wall and CPU time spent in the phases of a compilation,
+ * with the number of items produced by each phase, the number of heap
+ * allocations it performed and the peak RSS of the process at its end.
+ */
+
+/**
+ * Build a report.
+ * @param source	Name of the compiled source.
+ */
+Report::Report(string source): _source(source), _cpu_start(0), _allocs_start(0) {
+}
+
+/**
+ * Start the measure of a phase.
+ * @param name	Phase name.
+ */
+void Report::start(string name) {
+	Phase p;
+	p.name = name;
+	p.wall = 0;
+	p.cpu = 0;
+	p.items = 0;
+	p.allocs = 0;
+	p.rss = 0;
+	_phases.push_back(p);
+	_allocs_start = allocations();
+	_cpu_start = cpuTime();
+	_wall_start = chrono::steady_clock::now();
+}
+
+/**
+ * Stop the measure of the current phase.
+ * @param items		Number of items produced by the phase.
+ * @param unit		Name of the items.
+ */
+void Report::stop(size_t items, string unit) {
+	auto& p = _phases.back();
+	p.wall = chrono::duration<double>(chrono::steady_clock::now() - _wall_start).count();
+	p.cpu = cpuTime() - _cpu_start;
+	p.allocs = allocations() - _allocs_start;
+	p.rss = maxRSS();
+	p.items = items;
+	p.unit = unit;
+}
+
+/**
+ * Keep, phase by phase, the fastest measure between this report and
+ * the given one (both reports must have the same phases).
+ * @param report	Report to compare with.
+ */
+void Report::keepFastest(const Report& report) {
+	for(size_t i = 0; i < _phases.size() && i < report._phases.size(); i++)
+		if(report._phases[i].wall < _phases[i].wall)
+			_phases[i] = report._phases[i];
+}
+
+/**
+ * Get the total wall time of the phases.
+ * @return	Wall time in seconds.
+ */
+double Report::wall() const {
+	double t = 0;
+	for(const auto& p: _phases)
+		t += p.wall;
+	return t;
+}
+
+/**
+ * Get the total CPU time of the phases.
+ * @return	CPU time in seconds.
+ */
+double Report::cpu() const {
+	double t = 0;
+	for(const auto& p: _phases)
+		t += p.cpu;
+	return t;
+}
+
+/**
+ * Get the total number of heap allocations of the phases.
+ * @return	Number of allocations.
+ */
+size_t Report::allocs() const {
+	size_t n = 0;
+	for(const auto& p: _phases)
+		n += p.allocs;
+	return n;
+}
+
+/**
+ * Get the peak RSS reached at the end of the phases.
+ * @return	Peak RSS in KiB.
+ */
+long Report::peakRSS() const {
+	long m = 0;
+	for(const auto& p: _phases)
+		m = max(m, p.rss);
+	return m;
+}
+
+/**
+ * Get the number of heap allocations performed with operator new by
+ * the calling thread since its start (C allocations are not counted).
+ * @return	Number of allocations (0 if no counter is installed).
+ */
+size_t Report::allocations() {
+	return alloc_counter == nullptr ? 0 : alloc_counter();
+}
+
+/**
+ * Install the counter of the heap allocations. The library does not
+ * replace the allocation operators, so that the programs embedding it
+ * keep theirs: the programs counting the allocations install a counter.
+ * @param counter	Function returning the number of allocations of the
+ * 					calling thread.
+ */
+void Report::setAllocationCounter(size_t (*counter)()) {
+	alloc_counter = counter;
+}
+
+/**
+ * Get the peak resident set size of the process. As it concerns
+ * the whole process, it is only meaningful for serial compilations.
+ * @return	Peak RSS in KiB.
+ */
+long Report::maxRSS() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+/**
+ * Get the CPU time consumed by the calling thread.
+ * @return	CPU time in seconds.
+ */
+double Report::cpuTime() {
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Print the report in human-readable form. The RSS of a phase is the
+ * peak RSS of the process at the end of the phase.
+ * @param out	Stream to output to.
+ */
+void Report::print(ostream& out) const {
+	auto flags = out.flags();
+	out << "Execution times (source: " << _source << ")\n"
+		<< left << setw(10) << " phase"
+		<< right << setw(12) << "wall (ms)"
+		<< setw(12) << "cpu (ms)"
+		<< setw(10) << "allocs"
+		<< setw(12) << "RSS (KiB)"
+		<< setw(18) << "items"
+		<< setw(20) << "throughput" << "\n";
+	for(const auto& p: _phases) {
+		out << left << setw(10) << (" " + p.name)
+			<< right << fixed << setprecision(3)
+			<< setw(12) << p.wall * 1000
+			<< setw(12) << p.cpu * 1000
+			<< setw(10) << p.allocs
+			<< setw(12) << p.rss;
+		if(p.unit == "")
+			out << "\n";
+		else {
+			out << setw(12) << p.items << " " << left << setw(5) << p.unit << right;
+			if(p.wall > 0)
+				out << setw(14) << setprecision(0) << p.items / p.wall << " " << p.unit << "/s";
+			out << "\n";
+		}
+	}
+	out << left << setw(10) << " TOTAL"
+		<< right << fixed << setprecision(3)
+		<< setw(12) << wall() * 1000
+		<< setw(12) << cpu() * 1000
+		<< setw(10) << allocs()
+		<< setw(12) << peakRSS() << "\n"
+		<< " peak RSS: " << peakRSS() << " KiB" << endl;
+	out.flags(flags);
+}
+
+/**
+ * Escape a string for JSON output: the control characters without a
+ * short escape are output as \u00XX.
+ * @param s		String to escape.
+ * @return		Escaped string.
+ */
+static string escape(const string& s) {
+	static const char *digits = "0123456789abcdef";
+	string r;
+	for(auto c: s)
+		switch(c) {
+		case '"':	r += "\\\""; break;
+		case '\\':	r += "\\\\"; break;
+		case '\n':	r += "\\n"; break;
+		case '\t':	r += "\\t"; break;
+		case '\r':	r += "\\r"; break;
+		case '\b':	r += "\\b"; break;
+		case '\f':	r += "\\f"; break;
+		default:
+			if(static_cast<unsigned char>(c) < 0x20) {
+				r += "\\u00";
+				r += digits[c >> 4];
+				r += digits[c & 0xf];
+			}
+			else
+				r += c;
+			break;
+		}
+	return r;
+}
+
+/**
+ * Print the report as a JSON object on one line (times in seconds).
+ * @param out	Stream to output to.
+ */
+void Report::printJSON(ostream& out) const {
+	auto flags = out.flags();
+	auto prec = out.precision();
+	out << setprecision(9)
+		<< "{\"source\": \"" << escape(_source) << "\", \"phases\": [";
+	bool first = true;
+	for(const auto& p: _phases) {
+		if(!first)
+			out << ", ";
+		first = false;
+		out << "{\"name\": \"" << escape(p.name) << "\""
+			<< ", \"wall\": " << p.wall
+			<< ", \"cpu\": " << p.cpu
+			<< ", \"allocs\": " << p.allocs
+			<< ", \"rss\": " << p.rss;
+		if(p.unit != "") {
+			out << ", \"items\": " << p.items
+				<< ", \"unit\": \"" << escape(p.unit) << "\"";
+			if(p.wall > 0)
+				out << ", \"throughput\": " << p.items / p.wall;
+		}
+		out << "}";
+	}
+	out << "], \"wall\": " << wall()
+		<< ", \"cpu\": " << cpu()
+		<< ", \"allocs\": " << allocs()
+		<< ", \"peak_rss\": " << peakRSS() << "}" << endl;
+	out.flags(flags);
+	out.precision(prec);
+}
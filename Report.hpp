@@ -0,0 +1,49 @@
+#ifndef IOC_REPORT_HPP
+#define IOC_REPORT_HPP
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+class Report {
+public:
+
+	class Phase {
+	public:
+		string name;
+		double wall, cpu;
+		size_t items;
+		string unit;
+		size_t allocs;
+		long rss;
+	};
+
+	Report(string source = "");
+	inline const string& source() const { return _source; }
+	inline const vector<Phase>& phases() const { return _phases; }
+	void start(string name);
+	void stop(size_t items = 0, string unit = "");
+	void keepFastest(const Report& report);
+	double wall() const;
+	double cpu() const;
+	size_t allocs() const;
+	long peakRSS() const;
+	void print(ostream& out) const;
+	void printJSON(ostream& out) const;
+
+	static double cpuTime();
+	static size_t allocations();
+	static void setAllocationCounter(size_t (*counter)());
+	static long maxRSS();
+
+private:
+	string _source;
+	vector<Phase> _phases;
+	chrono::steady_clock::time_point _wall_start;
+	double _cpu_start;
+	size_t _allocs_start;
+};
+
+#endif	// IOC_REPORT_HPP
@@ -0,0 +1,582 @@
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include "SSA.hpp"
+
+/**
+ * @class SSAForm
+ * Static single assignment form of the quadruplets of a program. Each
+ * write of a virtual register (variables included) gives a new register,
+ * a version, and phi functions merge the versions reaching the entries of
+ * the BBs. A register read before being written stands for its value at
+ * the entry (or after a call for the variables): it is its own version.
+ *
+ * The quads are renamed in place and the phi functions are stored aside,
+ * by BB. As in global value numbering, the states are separate regions:
+ * the edges from a region to another are replaced by edges from a root
+ * BB, so that no value flows from a state to another. The BBs whose label
+ * address is taken (SETL, CALL) also hang from the root.
+ *
+ * The BBs, the dominator tree (Cooper, Harvey and Kennedy algorithm), the
+ * dominance frontiers and the uses of the versions are stored contiguously.
+ * The phi functions are only placed for the registers read in another BB
+ * than the one writing them (semi-pruned form).
+ *
+ * This is not a full SSA round trip: QuadProgram::restoreRegisters()
+ * gives back each version its original register and drops the phi
+ * functions, without lowering them to copies (the registers are allocated
+ * per BB and a copy could not carry a temporary to another BB). This is
+ * only valid if the versions of a register are never live at the same
+ * time, so the optimizations working on the SSA form must not move code:
+ * they may change the quads in place (keeping the written register),
+ * remove them (with SSAForm::removed) or fold the branches, but must not
+ * make a quad or a phi function read another version. SSAForm::inPlace()
+ * checks this restriction.
+ */
+
+/**
+ * Build the SSA form of a program.
+ * @param prog		Program (to allocate the versions).
+ * @param quads		Quads of the program, renamed in place.
+ * @param entries	Labels of the entries of the regions (states and
+ * 					epilogue).
+ */
+SSAForm::SSAForm(QuadProgram& prog, vector<Quad>& quads, const vector<Quad::lab_t>& entries)
+:	removed(quads.size(), false),
+	_quads(quads),
+	_base(prog.regCount())
+{
+	buildBlocks(prog, entries);
+	computeDominators();
+	placePhis(prog);
+	rename(prog);
+	findUses(prog);
+}
+
+
+/**
+ * Build the BBs of the regions and the edges between them.
+ * @param prog		Program.
+ * @param entries	Labels of the entries of the regions.
+ */
+void SSAForm::buildBlocks(QuadProgram& prog, const vector<Quad::lab_t>& entries) {
+	unique_ptr<CFG<Quad> > g(prog.makeCFG());
+	vector<bool> entry(prog.labCount(), false);
+	for(auto l: entries)
+		if(l < entry.size())
+			entry[l] = true;
+
+	// the labels whose address is taken may be reached from anywhere
+	vector<bool> taken(prog.labCount(), false);
+	for(const auto& q: _quads)
+		if(q.type == Quad::SETL)
+			taken[q.a] = true;
+		else if(q.type == Quad::CALL)
+			taken[q.label()] = true;
+
+	// number the BBs after the root and find their region
+	vector<uint32_t> index(g->basicBlocks().size(), none), region(1, none);
+	uint32_t r = 0;
+	_blocks.reserve(g->basicBlocks().size());
+	_blocks.resize(1);
+	for(auto bb: g->basicBlocks()) {
+		if(bb == g->entry() || bb == g->exit())
+			continue;
+		for(const auto& q: bb->instructions())
+			if(q.type != Quad::LAB)
+				break;
+			else if(entry[q.label()]) {
+				r++;
+				break;
+			}
+		index[bb->number()] = _blocks.size();
+		Block b;
+		b.first = bb->instructions().begin() - _quads.data();
+		b.last = bb->instructions().end() - _quads.data();
+		_blocks.push_back(b);
+		region.push_back(r);
+	}
+
+	// find the edges (to, from), the BBs entered from another region hanging from the root
+	vector<pair<uint32_t, uint32_t> > edges;
+	auto inside = [&](const BB<Quad> *bb, uint32_t b) {
+		return bb != nullptr && index[bb->number()] != none && region[index[bb->number()]] == region[b];
+	};
+	for(auto bb: g->basicBlocks()) {
+		auto b = index[bb->number()];
+		if(b == none)
+			continue;
+		if(inside(bb->next(), b)) {
+			_blocks[b].next = index[bb->next()->number()];
+			edges.push_back(make_pair(_blocks[b].next, b));
+		}
+		if(inside(bb->target(), b)) {
+			_blocks[b].target = index[bb->target()->number()];
+			edges.push_back(make_pair(_blocks[b].target, b));
+		}
+		bool open = bb->predecessors().empty();
+		for(auto p: bb->predecessors())
+			if(!inside(p, b))
+				open = true;
+		for(const auto& q: bb->instructions())
+			if(q.type != Quad::LAB)
+				break;
+			else if(taken[q.label()])
+				open = true;
+		if(open)
+			edges.push_back(make_pair(b, root));
+	}
+
+	// hang the cycles not reachable from the root
+	vector<bool> reached(_blocks.size(), false);
+	vector<uint32_t> todo;
+	auto reach = [&](uint32_t b) {
+		todo.push_back(b);
+		reached[b] = true;
+		while(!todo.empty()) {
+			const Block& x = _blocks[todo.back()];
+			todo.pop_back();
+			for(auto s: { x.next, x.target })
+				if(s != none && !reached[s]) {
+					reached[s] = true;
+					todo.push_back(s);
+				}
+		}
+	};
+	for(const auto& e: edges)
+		if(e.second == root && !reached[e.first])
+			reach(e.first);
+	for(uint32_t b = 1; b < _blocks.size(); b++)
+		if(!reached[b]) {
+			edges.push_back(make_pair(b, root));
+			reach(b);
+		}
+
+	// store the predecessors then the successors
+	sort(edges.begin(), edges.end());
+	edges.erase(unique(edges.begin(), edges.end()), edges.end());
+	for(size_t i = 0; i < edges.size(); ) {
+		auto b = edges[i].first;
+		_blocks[b].preds = _edges.size();
+		for(; i < edges.size() && edges[i].first == b; i++)
+			_edges.push_back(edges[i].second);
+		_blocks[b].preds_end = _edges.size();
+	}
+	for(auto& e: edges)
+		swap(e.first, e.second);
+	sort(edges.begin(), edges.end());
+	for(size_t i = 0; i < edges.size(); ) {
+		auto b = edges[i].first;
+		_blocks[b].succs = _edges.size();
+		for(; i < edges.size() && edges[i].first == b; i++)
+			_edges.push_back(edges[i].second);
+		_blocks[b].succs_end = _edges.size();
+	}
+}
+
+
+/**
+ * Compute the dominator tree and the dominance frontiers of the BBs.
+ */
+void SSAForm::computeDominators() {
+
+	// number the BBs in postorder
+	vector<uint32_t> order, po(_blocks.size());
+	vector<pair<uint32_t, uint32_t> > stack(1, make_pair(root, _blocks[root].succs));
+	vector<bool> seen(_blocks.size(), false);
+	seen[root] = true;
+	while(!stack.empty()) {
+		auto b = stack.back().first;
+		auto s = stack.back().second;
+		if(s == _blocks[b].succs_end) {
+			po[b] = order.size();
+			order.push_back(b);
+			stack.pop_back();
+			continue;
+		}
+		stack.back().second++;
+		if(!seen[_edges[s]]) {
+			seen[_edges[s]] = true;
+			stack.push_back(make_pair(_edges[s], _blocks[_edges[s]].succs));
+		}
+	}
+
+	// find the immediate dominators
+	auto intersect = [&](uint32_t a, uint32_t b) {
+		while(a != b) {
+			while(po[a] < po[b])
+				a = _blocks[a].idom;
+			while(po[b] < po[a])
+				b = _blocks[b].idom;
+		}
+		return a;
+	};
+	_blocks[root].idom = root;
+	for(bool changed = true; changed;) {
+		changed = false;
+		for(size_t i = order.size() - 1; i-- > 0;) {
+			Block& b = _blocks[order[i]];
+			uint32_t idom = none;
+			for(auto p: preds(order[i]))
+				if(_blocks[p].idom != none)
+					idom = idom == none ? p : intersect(p, idom);
+			if(idom != b.idom) {
+				b.idom = idom;
+				changed = true;
+			}
+		}
+	}
+
+	// store the children in the dominator tree
+	vector<pair<uint32_t, uint32_t> > pairs;
+	for(uint32_t b = 1; b < _blocks.size(); b++)
+		pairs.push_back(make_pair(_blocks[b].idom, b));
+	sort(pairs.begin(), pairs.end());
+	for(size_t i = 0; i < pairs.size(); ) {
+		auto b = pairs[i].first;
+		_blocks[b].children = _edges.size();
+		for(; i < pairs.size() && pairs[i].first == b; i++)
+			_edges.push_back(pairs[i].second);
+		_blocks[b].children_end = _edges.size();
+	}
+
+	// number the dominator tree
+	uint32_t n = 0;
+	stack.assign(1, make_pair(root, _blocks[root].children));
+	_blocks[root].pre = n++;
+	while(!stack.empty()) {
+		auto b = stack.back().first;
+		auto c = stack.back().second;
+		if(c == _blocks[b].children_end) {
+			_blocks[b].post = n++;
+			stack.pop_back();
+			continue;
+		}
+		stack.back().second++;
+		_blocks[_edges[c]].pre = n++;
+		stack.push_back(make_pair(_edges[c], _blocks[_edges[c]].children));
+	}
+
+	// compute the dominance frontiers
+	pairs.clear();
+	vector<uint32_t> last(_blocks.size(), none);
+	for(uint32_t b = 1; b < _blocks.size(); b++)
+		if(_blocks[b].preds_end - _blocks[b].preds >= 2)
+			for(auto p: preds(b))
+				for(auto x = p; x != _blocks[b].idom && last[x] != b; x = _blocks[x].idom) {
+					last[x] = b;
+					pairs.push_back(make_pair(x, b));
+				}
+	sort(pairs.begin(), pairs.end());
+	for(size_t i = 0; i < pairs.size(); ) {
+		auto b = pairs[i].first;
+		_blocks[b].frontier = _edges.size();
+		for(; i < pairs.size() && pairs[i].first == b; i++)
+			_edges.push_back(pairs[i].second);
+		_blocks[b].frontier_end = _edges.size();
+	}
+}
+
+
+/**
+ * Place the phi functions of the registers read in another BB than the
+ * ones writing them, at the iterated dominance frontiers of these BBs.
+ * @param prog	Program.
+ */
+void SSAForm::placePhis(QuadProgram& prog) {
+
+	// find the read registers and the BBs writing them
+	vector<uint32_t> written(_base, none);
+	vector<bool> global(_base, false);
+	vector<pair<Quad::reg_t, uint32_t> > defs;
+	auto write = [&](Quad::reg_t r, uint32_t b) {
+		if(written[r] != b) {
+			written[r] = b;
+			defs.push_back(make_pair(r, b));
+		}
+	};
+	for(uint32_t b = 1; b < _blocks.size(); b++)
+		for(size_t i = _blocks[b].first; i < _blocks[b].last; i++) {
+			const Quad& q = _quads[i];
+			if(q.readsA() && q.a >= Quad::HARD_COUNT && written[q.a] != b)
+				global[q.a] = true;
+			if(q.readsB() && q.b >= Quad::HARD_COUNT && written[q.b] != b)
+				global[q.b] = true;
+			if(q.type == Quad::CALL)
+				for(auto r: prog.variables())
+					write(r, b);
+			if(q.writes() && q.d >= Quad::HARD_COUNT)
+				write(q.d, b);
+		}
+	sort(defs.begin(), defs.end());
+
+	// place the phi functions
+	vector<pair<uint32_t, Quad::reg_t> > placed;
+	vector<uint32_t> has_phi(_blocks.size(), none), queued(_blocks.size(), none), todo;
+	for(size_t i = 0; i < defs.size(); ) {
+		auto r = defs[i].first;
+		for(; i < defs.size() && defs[i].first == r; i++)
+			if(global[r]) {
+				queued[defs[i].second] = r;
+				todo.push_back(defs[i].second);
+			}
+		while(!todo.empty()) {
+			auto b = todo.back();
+			todo.pop_back();
+			for(auto f: frontier(b))
+				if(has_phi[f] != r) {
+					has_phi[f] = r;
+					placed.push_back(make_pair(f, r));
+					if(queued[f] != r) {
+						queued[f] = r;
+						todo.push_back(f);
+					}
+				}
+		}
+	}
+
+	// store them by BB, with their arguments
+	sort(placed.begin(), placed.end());
+	for(size_t i = 0; i < placed.size(); ) {
+		auto b = placed[i].first;
+		_blocks[b].phis = _phis.size();
+		for(; i < placed.size() && placed[i].first == b; i++) {
+			_phis.push_back({ placed[i].second, b, uint32_t(_args.size()) });
+			_args.resize(_args.size() + _blocks[b].preds_end - _blocks[b].preds, placed[i].second);
+		}
+		_blocks[b].phis_end = _phis.size();
+	}
+}
+
+
+/**
+ * Give a new version to each written register, going down the dominator
+ * tree, and rename the uses accordingly.
+ * @param prog	Program (to allocate the versions).
+ */
+void SSAForm::rename(QuadProgram& prog) {
+	vector<Quad::reg_t> cur(_base);
+	for(Quad::reg_t r = 0; r < _base; r++)
+		cur[r] = r;
+	vector<pair<Quad::reg_t, Quad::reg_t> > undo;
+	auto define = [&](Quad::reg_t r, uint32_t site) {
+		auto v = prog.newReg();
+		_origin.push_back(r);
+		_def.push_back(site);
+		undo.push_back(make_pair(r, cur[r]));
+		cur[r] = v;
+		return v;
+	};
+
+	// visit the dominator tree, the second item of the stack being the undo size on exit
+	vector<pair<uint32_t, size_t> > stack(1, make_pair(root, size_t(none)));
+	while(!stack.empty()) {
+		auto b = stack.back().first;
+		auto mark = stack.back().second;
+		stack.pop_back();
+		if(mark != none) {
+			for(; undo.size() > mark; undo.pop_back())
+				cur[undo.back().first] = undo.back().second;
+			continue;
+		}
+		stack.push_back(make_pair(b, undo.size()));
+
+		// rename the phi functions and the quads
+		for(auto p = _blocks[b].phis; p < _blocks[b].phis_end; p++)
+			_phis[p].d = define(_phis[p].d, phi_site | p);
+		for(size_t i = _blocks[b].first; i < _blocks[b].last; i++) {
+			Quad& q = _quads[i];
+			if(q.readsA() && q.a >= Quad::HARD_COUNT)
+				q.a = cur[q.a];
+			if(q.readsB() && q.b >= Quad::HARD_COUNT)
+				q.b = cur[q.b];
+			if(q.type == Quad::CALL)
+				for(auto r: prog.variables())
+					define(r, none);
+			if(q.writes() && q.d >= Quad::HARD_COUNT)
+				q.d = define(q.d, i);
+		}
+
+		// set the arguments of the phi functions of the successors
+		for(auto s: succs(b)) {
+			auto ps = preds(s);
+			auto j = find(ps.begin(), ps.end(), b) - ps.begin();
+			for(auto p = _blocks[s].phis; p < _blocks[s].phis_end; p++)
+				_args[_phis[p].args + j] = cur[origin(_phis[p].d)];
+		}
+
+		for(auto c = _blocks[b].children_end; c > _blocks[b].children; c--)
+			stack.push_back(make_pair(_edges[c - 1], size_t(none)));
+	}
+}
+
+
+/**
+ * Check that the quads and the phi functions read the versions that the
+ * renaming gave them, that is, that no code was moved: the renaming is
+ * replayed over the quads (removed ones included) and each read is
+ * compared with the current version of its register.
+ * @param prog	Program.
+ * @return		True if the versions are in place, false else.
+ */
+bool SSAForm::inPlace(const QuadProgram& prog) const {
+	vector<Quad::reg_t> cur(_base);
+	for(Quad::reg_t r = 0; r < _base; r++)
+		cur[r] = r;
+	Quad::reg_t next = _base;
+	bool ok = true;
+	vector<pair<Quad::reg_t, Quad::reg_t> > undo;
+	auto define = [&](Quad::reg_t r, Quad::reg_t v) {
+		ok = ok && v == next;
+		next++;
+		undo.push_back(make_pair(r, cur[r]));
+		cur[r] = v;
+	};
+	auto read = [&](Quad::reg_t v) {
+		ok = ok && (v < Quad::HARD_COUNT || v == cur[origin(v)]);
+	};
+
+	// replay the visit of the dominator tree of rename()
+	vector<pair<uint32_t, size_t> > stack(1, make_pair(root, size_t(none)));
+	while(ok && !stack.empty()) {
+		auto b = stack.back().first;
+		auto mark = stack.back().second;
+		stack.pop_back();
+		if(mark != none) {
+			for(; undo.size() > mark; undo.pop_back())
+				cur[undo.back().first] = undo.back().second;
+			continue;
+		}
+		stack.push_back(make_pair(b, undo.size()));
+
+		for(const auto& p: phis(b))
+			define(origin(p.d), p.d);
+		for(size_t i = _blocks[b].first; i < _blocks[b].last; i++) {
+			const Quad& q = _quads[i];
+			if(!removed[i]) {
+				if(q.readsA())
+					read(q.a);
+				if(q.readsB())
+					read(q.b);
+			}
+			if(q.type == Quad::CALL)
+				for(auto r: prog.variables())
+					define(r, next);
+			if(q.writes() && q.d >= Quad::HARD_COUNT)
+				define(origin(q.d), q.d);
+		}
+		for(auto s: succs(b)) {
+			auto ps = preds(s);
+			auto j = find(ps.begin(), ps.end(), b) - ps.begin();
+			for(const auto& p: phis(s))
+				read(args(p).begin()[j]);
+		}
+
+		for(auto c = _blocks[b].children_end; c > _blocks[b].children; c--)
+			stack.push_back(make_pair(_edges[c - 1], size_t(none)));
+	}
+	return ok && next == _base + _origin.size();
+}
+
+
+/**
+ * Record the quads and phi functions using each version.
+ * @param prog	Program.
+ */
+void SSAForm::findUses(QuadProgram& prog) {
+	_uses.assign(prog.regCount() + 1, 0);
+	auto visit = [&](auto f) {
+		for(uint32_t b = 1; b < _blocks.size(); b++) {
+			for(const auto& p: phis(b))
+				for(auto a: args(p))
+					f(a, phi_site | (&p - _phis.data()));
+			for(size_t i = _blocks[b].first; i < _blocks[b].last; i++) {
+				const Quad& q = _quads[i];
+				if(q.readsA())
+					f(q.a, i);
+				if(q.readsB() && !(q.readsA() && q.a == q.b))
+					f(q.b, i);
+			}
+		}
+	};
+	visit([&](Quad::reg_t r, uint32_t) { _uses[r + 1]++; });
+	for(size_t r = 1; r < _uses.size(); r++)
+		_uses[r] += _uses[r - 1];
+	_use_sites.resize(_uses.back());
+	vector<uint32_t> next(_uses.begin(), _uses.end() - 1);
+	visit([&](Quad::reg_t r, uint32_t site) { _use_sites[next[r]++] = site; });
+}
+
+
+/**
+ * Print the SSA form, BB by BB.
+ * @param out	Stream to output to.
+ */
+void SSAForm::print(ostream& out) const {
+	auto name = [](uint32_t b) { return b == root ? string("ROOT") : "BB" + to_string(b); };
+	for(uint32_t b = 0; b < _blocks.size(); b++) {
+		if(b == root)
+			out << "ROOT" << endl;
+		else
+			out << "BB " << b << ": IDOM " << name(_blocks[b].idom) << endl;
+		for(const auto& p: phis(b)) {
+			out << '\t' << Quad::reg(p.d) << " <- phi(";
+			bool first = true;
+			for(auto a: args(p)) {
+				out << (first ? "" : ", ") << Quad::reg(a);
+				first = false;
+			}
+			out << ')' << endl;
+		}
+		for(size_t i = _blocks[b].first; i < _blocks[b].last; i++)
+			if(!removed[i])
+				out << '\t' << _quads[i] << endl;
+		if(b == root)
+			for(auto s: succs(b))
+				out << "\tSUCC " << name(s) << endl;
+		if(_blocks[b].next != none)
+			out << "\tNEXT " << name(_blocks[b].next) << endl;
+		if(_blocks[b].target != none)
+			out << "\tTARGET " << name(_blocks[b].target) << endl;
+		if(_blocks[b].frontier != _blocks[b].frontier_end) {
+			out << "\tFRONTIER";
+			for(auto f: frontier(b))
+				out << ' ' << name(f);
+			out << endl;
+		}
+	}
+}
+
+
+/**
+ * Put the program in SSA form.
+ * @param entries	Labels of the entries of the regions (states and
+ * 					epilogue).
+ * @return			SSA form (to delete after QuadProgram::restoreRegisters()).
+ */
+SSAForm *QuadProgram::makeSSA(const vector<Quad::lab_t>& entries) {
+	return new SSAForm(*this, _quads, entries);
+}
+
+
+/**
+ * Leave the SSA form by giving back the versions their original register,
+ * dropping the phi functions and removing the quads marked as removed.
+ * As no copy is inserted, the code must not have been moved in SSA form
+ * (see SSAForm).
+ * @param ssa	SSA form of the program.
+ */
+void QuadProgram::restoreRegisters(SSAForm& ssa) {
+	assert("code moved in SSA form" && ssa.inPlace(*this));
+	for(auto& q: _quads) {
+		if(q.writes())
+			q.d = ssa.origin(q.d);
+		if(q.readsA())
+			q.a = ssa.origin(q.a);
+		if(q.readsB())
+			q.b = ssa.origin(q.b);
+	}
+	_vreg = ssa._base;
+	if(find(ssa.removed.begin(), ssa.removed.end(), true) != ssa.removed.end())
+		rewrite(ssa.removed);
+}
@@ -0,0 +1,99 @@
+#ifndef IOC_SSA_HPP
+#define IOC_SSA_HPP
+
+#include <iostream>
+#include <vector>
+using namespace std;
+
+#include "Quad.hpp"
+
+class SSAForm {
+	friend class QuadProgram;
+public:
+	static constexpr uint32_t
+		none = ~uint32_t(0),
+		root = 0,
+		phi_site = uint32_t(1) << 31;
+
+	class Block {
+	public:
+		inline Block(): first(0), last(0), next(none), target(none), idom(none),
+			preds(0), preds_end(0), succs(0), succs_end(0), children(0), children_end(0),
+			frontier(0), frontier_end(0), phis(0), phis_end(0), pre(0), post(0) { }
+		size_t first, last;					// quads of the block
+		uint32_t next, target;				// successors by sequence and by branch
+		uint32_t idom;						// immediate dominator
+		uint32_t preds, preds_end;			// predecessors (in _edges)
+		uint32_t succs, succs_end;			// successors (in _edges)
+		uint32_t children, children_end;	// children in the dominator tree (in _edges)
+		uint32_t frontier, frontier_end;	// dominance frontier (in _edges)
+		uint32_t phis, phis_end;			// phi functions (in _phis)
+		uint32_t pre, post;					// numbers in the dominator tree
+	};
+
+	class Phi {
+	public:
+		Quad::reg_t d;
+		uint32_t block;
+		uint32_t args;						// one per predecessor (in _args)
+	};
+
+	SSAForm(QuadProgram& prog, vector<Quad>& quads, const vector<Quad::lab_t>& entries);
+	SSAForm(const SSAForm&) = delete;
+	SSAForm& operator=(const SSAForm&) = delete;
+
+	inline size_t blockCount() const { return _blocks.size(); }
+	inline const Block& block(uint32_t b) const { return _blocks[b]; }
+	inline Slice<uint32_t> preds(uint32_t b) const
+		{ return slice(_edges, _blocks[b].preds, _blocks[b].preds_end); }
+	inline Slice<uint32_t> succs(uint32_t b) const
+		{ return slice(_edges, _blocks[b].succs, _blocks[b].succs_end); }
+	inline Slice<uint32_t> children(uint32_t b) const
+		{ return slice(_edges, _blocks[b].children, _blocks[b].children_end); }
+	inline Slice<uint32_t> frontier(uint32_t b) const
+		{ return slice(_edges, _blocks[b].frontier, _blocks[b].frontier_end); }
+	inline bool dominates(uint32_t a, uint32_t b) const
+		{ return _blocks[a].pre <= _blocks[b].pre && _blocks[b].post <= _blocks[a].post; }
+
+	inline Slice<Phi> phis(uint32_t b) const
+		{ return slice(_phis, _blocks[b].phis, _blocks[b].phis_end); }
+	inline Slice<Quad::reg_t> args(const Phi& p) const
+		{ return slice(_args, p.args, p.args + _blocks[p.block].preds_end - _blocks[p.block].preds); }
+	inline const Phi& phi(uint32_t site) const { return _phis[site & ~phi_site]; }
+	static inline bool isPhi(uint32_t site) { return (site & phi_site) != 0; }
+
+	inline Quad& quad(size_t i) { return _quads[i]; }
+	inline const Quad& quad(size_t i) const { return _quads[i]; }
+	inline Quad::reg_t origin(Quad::reg_t v) const { return v < _base ? v : _origin[v - _base]; }
+	inline uint32_t def(Quad::reg_t v) const { return v < _base ? none : _def[v - _base]; }
+	inline Slice<uint32_t> uses(Quad::reg_t v) const
+		{ return slice(_use_sites, _uses[v], _uses[v + 1]); }
+
+	void print(ostream& out) const;
+	bool inPlace(const QuadProgram& prog) const;
+
+	vector<bool> removed;
+
+private:
+	template <class T>
+	static inline Slice<T> slice(const vector<T>& v, size_t b, size_t e)
+		{ return Slice<T>(v.data() + b, v.data() + e); }
+
+	void buildBlocks(QuadProgram& prog, const vector<Quad::lab_t>& entries);
+	void computeDominators();
+	void placePhis(QuadProgram& prog);
+	void rename(QuadProgram& prog);
+	void findUses(QuadProgram& prog);
+
+	vector<Quad>& _quads;
+	Quad::reg_t _base;
+	vector<Block> _blocks;
+	vector<uint32_t> _edges;
+	vector<Phi> _phis;
+	vector<Quad::reg_t> _args;
+	vector<Quad::reg_t> _origin;
+	vector<uint32_t> _def;
+	vector<uint32_t> _uses, _use_sites;
+};
+
+#endif	// IOC_SSA_HPP
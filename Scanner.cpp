@@ -0,0 +1,464 @@
+#include <climits>
+#include <cstring>
+#include "CompilationUnit.hpp"
+#include "Scanner.hpp"
+#include "parser.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define IOC_SCANNER_X86
+#	include <immintrin.h>
+#endif
+
+/**
+ * @class Scanner
+ * Hand-written scanner producing exactly the same token stream as the
+ * Flex scanner (lexer.ll): same tokens, same semantic values, same line
+ * counting and the same "bad character" error.
+ *
+ * The source is scanned in place. The long runs of the source (blanks,
+ * identifiers and comment bodies) are classified 16 bytes at a time with
+ * SSE2 or 32 bytes at a time with AVX2, the best kernels supported by the
+ * running processor being selected at construction. A scalar version of
+ * the kernels is used on the other processors and for the tails of the
+ * runs.
+ */
+
+/**
+ * @class Scanner::Kernels
+ * Set of the functions classifying the runs of characters. Each of them
+ * stops at the end of the source at the latest.
+ *
+ * blanks() skips the spaces, tabulations and new lines and counts the
+ * latter; ident() skips the characters of an identifier; find() looks
+ * for a character, counting the new lines before it.
+ */
+
+///
+static inline bool isBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\n';
+}
+
+///
+static inline bool isIdentStart(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+///
+static inline bool isIdent(char c) {
+	return isIdentStart(c) || (c >= '0' && c <= '9');
+}
+
+///
+static const char *scalarBlanks(const char *p, const char *e, int& lines) {
+	for(; p < e; p++)
+		if(*p == '\n')
+			lines++;
+		else if(*p != ' ' && *p != '\t')
+			break;
+	return p;
+}
+
+///
+static const char *scalarIdent(const char *p, const char *e) {
+	while(p < e && isIdent(*p))
+		p++;
+	return p;
+}
+
+///
+static const char *scalarFind(const char *p, const char *e, char c, int& lines) {
+	for(; p < e && *p != c; p++)
+		if(*p == '\n')
+			lines++;
+	return p;
+}
+
+static const Scanner::Kernels scalar_kernels = { scalarBlanks, scalarIdent, scalarFind };
+
+
+#ifdef IOC_SCANNER_X86
+
+/**
+ * Build the mask of the bytes of v in [lo, hi] (unsigned comparison).
+ */
+__attribute__((target("sse2")))
+static inline __m128i sse2In(__m128i v, char lo, char hi) {
+	__m128i d = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+	return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(hi - lo)), d);
+}
+
+///
+__attribute__((target("sse2")))
+static const char *sse2Blanks(const char *p, const char *e, int& lines) {
+	const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), nl = _mm_set1_epi8('\n');
+	while(e - p >= 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		__m128i n = _mm_cmpeq_epi8(v, nl);
+		unsigned nls = _mm_movemask_epi8(n);
+		unsigned blank = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)), n));
+		if(blank != 0xffff) {
+			unsigned k = __builtin_ctz(~blank);
+			lines += __builtin_popcount(nls & ((1u << k) - 1));
+			return p + k;
+		}
+		lines += __builtin_popcount(nls);
+		p += 16;
+	}
+	return scalarBlanks(p, e, lines);
+}
+
+///
+__attribute__((target("sse2")))
+static const char *sse2Ident(const char *p, const char *e) {
+	const __m128i lower = _mm_set1_epi8(0x20), under = _mm_set1_epi8('_');
+	while(e - p >= 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		__m128i m = _mm_or_si128(
+			_mm_or_si128(sse2In(_mm_or_si128(v, lower), 'a', 'z'), sse2In(v, '0', '9')),
+			_mm_cmpeq_epi8(v, under));
+		unsigned id = _mm_movemask_epi8(m);
+		if(id != 0xffff)
+			return p + __builtin_ctz(~id);
+		p += 16;
+	}
+	return scalarIdent(p, e);
+}
+
+///
+__attribute__((target("sse2")))
+static const char *sse2Find(const char *p, const char *e, char c, int& lines) {
+	const __m128i cc = _mm_set1_epi8(c), nl = _mm_set1_epi8('\n');
+	while(e - p >= 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, cc));
+		unsigned nls = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+		if(m != 0) {
+			unsigned k = __builtin_ctz(m);
+			lines += __builtin_popcount(nls & ((1u << k) - 1));
+			return p + k;
+		}
+		lines += __builtin_popcount(nls);
+		p += 16;
+	}
+	return scalarFind(p, e, c, lines);
+}
+
+static const Scanner::Kernels sse2_kernels = { sse2Blanks, sse2Ident, sse2Find };
+
+
+/**
+ * Build the mask of the bytes of v in [lo, hi] (unsigned comparison).
+ */
+__attribute__((target("avx2,popcnt")))
+static inline __m256i avx2In(__m256i v, char lo, char hi) {
+	__m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+	return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(hi - lo)), d);
+}
+
+///
+__attribute__((target("avx2,popcnt")))
+static const char *avx2Blanks(const char *p, const char *e, int& lines) {
+	const __m256i sp = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'), nl = _mm256_set1_epi8('\n');
+	while(e - p >= 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		__m256i n = _mm256_cmpeq_epi8(v, nl);
+		unsigned nls = _mm256_movemask_epi8(n);
+		unsigned blank = _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, tab)), n));
+		if(blank != 0xffffffff) {
+			unsigned k = __builtin_ctz(~blank);
+			lines += __builtin_popcount(nls & ((1u << k) - 1));
+			return p + k;
+		}
+		lines += __builtin_popcount(nls);
+		p += 32;
+	}
+	return sse2Blanks(p, e, lines);
+}
+
+///
+__attribute__((target("avx2,popcnt")))
+static const char *avx2Ident(const char *p, const char *e) {
+	const __m256i lower = _mm256_set1_epi8(0x20), under = _mm256_set1_epi8('_');
+	while(e - p >= 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		__m256i m = _mm256_or_si256(
+			_mm256_or_si256(avx2In(_mm256_or_si256(v, lower), 'a', 'z'), avx2In(v, '0', '9')),
+			_mm256_cmpeq_epi8(v, under));
+		unsigned id = _mm256_movemask_epi8(m);
+		if(id != 0xffffffff)
+			return p + __builtin_ctz(~id);
+		p += 32;
+	}
+	return sse2Ident(p, e);
+}
+
+///
+__attribute__((target("avx2,popcnt")))
+static const char *avx2Find(const char *p, const char *e, char c, int& lines) {
+	const __m256i cc = _mm256_set1_epi8(c), nl = _mm256_set1_epi8('\n');
+	while(e - p >= 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		unsigned m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, cc));
+		unsigned nls = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+		if(m != 0) {
+			unsigned k = __builtin_ctz(m);
+			lines += __builtin_popcount(nls & ((1u << k) - 1));
+			return p + k;
+		}
+		lines += __builtin_popcount(nls);
+		p += 32;
+	}
+	return sse2Find(p, e, c, lines);
+}
+
+static const Scanner::Kernels avx2_kernels = { avx2Blanks, avx2Ident, avx2Find };
+
+#endif	// IOC_SCANNER_X86
+
+
+/**
+ * Build a scanner on a source. The source must stay alive as long as
+ * the scanner is used.
+ * @param unit		Unit to record lines and to intern identifiers in.
+ * @param source	Source to scan.
+ * @param kind		Kernels to use (SIMD for the best supported ones);
+ * 					if not supported, the best supported ones are used.
+ */
+Scanner::Scanner(CompilationUnit& unit, const Source& source, kind_t kind):
+	_unit(unit),
+	_p(source.data()),
+	_end(source.data() + source.size()),
+	_kind(kind),
+	_k(&scalar_kernels)
+{
+	kind_t b = best();
+	if(_kind == FLEX || _kind == SIMD || (_kind == AVX2 && b != AVX2) || (_kind == SSE2 && b == SCALAR))
+		_kind = b;
+#	ifdef IOC_SCANNER_X86
+		if(_kind == AVX2)
+			_k = &avx2_kernels;
+		else if(_kind == SSE2)
+			_k = &sse2_kernels;
+#	endif
+}
+
+/**
+ * Get the best kernels supported by the running processor.
+ * @return	AVX2, SSE2 or SCALAR.
+ */
+Scanner::kind_t Scanner::best() {
+#	ifdef IOC_SCANNER_X86
+		if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+			return AVX2;
+		if(__builtin_cpu_supports("sse2"))
+			return SSE2;
+#	endif
+	return SCALAR;
+}
+
+/**
+ * Get the name of a kind of scanner.
+ * @param kind	Kind of scanner.
+ * @return		Kind name.
+ */
+const char *Scanner::name(kind_t kind) {
+	static const char *names[] = { "flex", "simd", "scalar", "sse2", "avx2" };
+	return names[kind];
+}
+
+/**
+ * Scan the next token.
+ * Throws a ParseException for a bad character.
+ * @param val	To store the semantic value in.
+ * @return		Token code, 0 at the end of the source.
+ */
+int Scanner::next(YYSTYPE *val) {
+
+	// skip blanks and comments
+	while(true) {
+		if(_p < _end && isBlank(*_p)) {
+			if(*_p != '\n' && !isBlank(_p[1])) {
+				_p++;
+				continue;
+			}
+			int lines = 0;
+			_p = _k->blanks(_p, _end, lines);
+			_unit.newLines(lines);
+		}
+		if(_p >= _end)
+			return 0;
+		if(_p[0] != '/' || (_p[1] != '/' && _p[1] != '*'))
+			break;
+		int lines = 0;
+		if(_p[1] == '/') {
+			_p = _k->find(_p + 2, _end, '\n', lines);
+			if(_p < _end) {
+				lines++;
+				_p++;
+			}
+		}
+		else {
+			const char *q = _p + 2;
+			while(true) {
+				q = _k->find(q, _end, '*', lines);
+				if(q >= _end || q[1] == '/')
+					break;
+				q++;
+			}
+			_p = q >= _end ? _end : q + 2;
+		}
+		_unit.newLines(lines);
+	}
+
+	// identifiers and keywords
+	char c = *_p;
+	if(isIdentStart(c)) {
+		const char *q = _k->ident(_p + 1, _end);
+		size_t len = q - _p;
+		int t = keyword(_p, len);
+		if(t == 0) {
+			val->ID = _unit.intern(_p, len);
+			t = ID;
+		}
+		_p = q;
+		return t;
+	}
+
+	// numbers
+	if(c >= '0' && c <= '9')
+		return number(val);
+
+	// symbols (the source is followed by two null characters)
+	switch(c) {
+	case '=': case '@': case '[': case ']': case ':': case '(': case ')':
+	case '&': case '|': case '^': case '+': case '%': case '/': case '~':
+	case '-': case '*':
+		_p++;
+		return c;
+	case '!':
+		if(_p[1] == '=') {
+			_p += 2;
+			return NE;
+		}
+		_p++;
+		return c;
+	case '<':
+	case '>':
+		if(_p[1] == c) {
+			if(_p[2] == c) {
+				_p += 3;
+				return c == '<' ? LT3 : GT3;
+			}
+			_p += 2;
+			return c == '<' ? LT2 : GT2;
+		}
+		if(_p[1] == '=') {
+			_p += 2;
+			return c == '<' ? LE : GE;
+		}
+		_p++;
+		return c;
+	case '.':
+		if(_p[1] == '.') {
+			_p += 2;
+			return DOTDOT;
+		}
+		break;
+	case '"': {
+			const char *q = _p + 1;
+			while(q < _end && *q != '"' && *q != '\n')
+				q++;
+			if(q < _end && *q == '"') {
+				val->STRING = _unit.intern(_p + 1, q - _p - 1);
+				_p = q + 1;
+				return STRING;
+			}
+		}
+		break;
+	}
+	throw ParseException(_unit.position(), "bad character");
+}
+
+/**
+ * Get the value of a digit.
+ * @param c		Digit character.
+ * @return		Digit value, 16 if c is not a digit.
+ */
+static inline int digit(char c) {
+	if(c >= '0' && c <= '9')
+		return c - '0';
+	else if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	else if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	else
+		return 16;
+}
+
+/**
+ * Scan a decimal, hexadecimal (0x) or binary (0b) integer. As strtol(),
+ * an overflowing value is saturated to LONG_MAX.
+ * @param val	To store the value in.
+ * @return		INT token.
+ */
+int Scanner::number(YYSTYPE *val) {
+	int base = 10;
+	if(_p[0] == '0' && _p[1] == 'x' && digit(_p[2]) < 16) {
+		base = 16;
+		_p += 2;
+	}
+	else if(_p[0] == '0' && _p[1] == 'b' && digit(_p[2]) < 2) {
+		base = 2;
+		_p += 2;
+	}
+	long v = 0;
+	bool overflow = false;
+	for(; _p < _end; _p++) {
+		int d = digit(*_p);
+		if(d >= base)
+			break;
+		if(v > (LONG_MAX - d) / base)
+			overflow = true;
+		else
+			v = v * base + d;
+	}
+	val->INT = overflow ? LONG_MAX : v;
+	return INT;
+}
+
+/**
+ * Look for a keyword.
+ * @param p		Identifier characters.
+ * @param len	Identifier length.
+ * @return		Keyword token or 0.
+ */
+int Scanner::keyword(const char *p, size_t len) const {
+	static const struct {
+		const char *name;
+		int token;
+	} keywords[] = {
+		{ "and", AND },
+		{ "auto", AUTO },
+		{ "const", CONST },
+		{ "else", ELSE },
+		{ "endif", ENDIF },
+		{ "goto", GOTO },
+		{ "if", IF },
+		{ "import", IMPORT },
+		{ "not", NOT },
+		{ "or", OR },
+		{ "reg", REG },
+		{ "sig", SIG },
+		{ "state", STATE },
+		{ "stop", STOP },
+		{ "then", THEN },
+		{ "var", VAR },
+		{ "when", WHEN }
+	};
+	if(len < 2 || len > 6)
+		return 0;
+	for(const auto& k: keywords)
+		if(k.name[0] == p[0] && strlen(k.name) == len && memcmp(k.name, p, len) == 0)
+			return k.token;
+	return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef IOC_SCANNER_HPP
+#define IOC_SCANNER_HPP
+
+#include <cstddef>
+using namespace std;
+
+class CompilationUnit;
+class Source;
+union YYSTYPE;
+
+class Scanner {
+public:
+	typedef enum {
+		FLEX,
+		SIMD,
+		SCALAR,
+		SSE2,
+		AVX2
+	} kind_t;
+
+	class Kernels {
+	public:
+		const char *(*blanks)(const char *p, const char *e, int& lines);
+		const char *(*ident)(const char *p, const char *e);
+		const char *(*find)(const char *p, const char *e, char c, int& lines);
+	};
+
+	Scanner(CompilationUnit& unit, const Source& source, kind_t kind = SIMD);
+	int next(YYSTYPE *val);
+	inline kind_t kind() const { return _kind; }
+
+	static kind_t best();
+	static const char *name(kind_t kind);
+
+private:
+	int number(YYSTYPE *val);
+	int keyword(const char *p, size_t len) const;
+
+	CompilationUnit& _unit;
+	const char *_p, *_end;
+	kind_t _kind;
+	const Kernels *_k;
+};
+
+#endif	// IOC_SCANNER_HPP
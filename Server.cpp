@@ -0,0 +1,340 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Server.hpp"
+
+/**
+ * @class Server
+ * Compilation server listening on a Unix domain socket. A client sends
+ * a request (its working directory, its command line arguments and
+ * possibly the text to compile instead of its standard input) and gets
+ * back the standard output, the error output and the exit code of the
+ * compilation.
+ *
+ * The requests are served one at a time, in the working directory of
+ * the client, by the same process: what the compiler keeps between two
+ * compilations (imported modules, ...) stays warm.
+ *
+ * The messages are made of 32-bit integers (native byte order: client
+ * and server run on the same machine) and of strings prefixed by their
+ * length:
+ * @li request: magic "IOCS", working directory, argument count,
+ * arguments, input flag, input text (if the flag is 1),
+ * @li response: standard output, error output, exit code.
+ */
+
+/**
+ * @class Server::Request
+ * Compilation request sent by a client.
+ */
+
+/**
+ * @class Server::Response
+ * Response of the server to a request. If stop is set, the server stops
+ * after sending the response.
+ */
+
+/**
+ * Largest string accepted in a message.
+ */
+static const uint32_t max_string = 1 << 30;
+
+/**
+ * Time (in seconds) after which the server drops a client that stops
+ * sending its request or reading the response.
+ */
+static const int client_timeout = 30;
+
+/**
+ * Send all the bytes of a buffer.
+ * @param fd	Socket.
+ * @param data	Buffer.
+ * @param size	Buffer size.
+ * @return		True for success, false else.
+ */
+static bool sendAll(int fd, const void *data, size_t size) {
+	auto p = static_cast<const char *>(data);
+	while(size != 0) {
+		auto n = send(fd, p, size, MSG_NOSIGNAL);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+/**
+ * Receive exactly the given number of bytes.
+ * @param fd	Socket.
+ * @param data	Buffer to store the bytes in.
+ * @param size	Number of bytes to receive.
+ * @return		True for success, false else.
+ */
+static bool recvAll(int fd, void *data, size_t size) {
+	auto p = static_cast<char *>(data);
+	while(size != 0) {
+		auto n = recv(fd, p, size, 0);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+///
+static bool sendInt(int fd, uint32_t x) {
+	return sendAll(fd, &x, sizeof(x));
+}
+
+///
+static bool recvInt(int fd, uint32_t& x) {
+	return recvAll(fd, &x, sizeof(x));
+}
+
+///
+static bool sendString(int fd, const string& s) {
+	return sendInt(fd, s.size()) && sendAll(fd, s.data(), s.size());
+}
+
+///
+static bool recvString(int fd, string& s) {
+	uint32_t n;
+	if(!recvInt(fd, n) || n > max_string)
+		return false;
+	s.resize(n);
+	return recvAll(fd, &s[0], n);
+}
+
+/**
+ * Build the address of a socket.
+ * @param path	Socket path.
+ * @param addr	Address to fill.
+ * @return		True for success, false if the path is too long.
+ */
+static bool makeAddress(const string& path, sockaddr_un& addr) {
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return false;
+	}
+	memcpy(addr.sun_path, path.c_str(), path.size());
+	return true;
+}
+
+/**
+ * Connect to a server.
+ * @param path	Socket path.
+ * @return		Socket or -1 (errno gives the cause).
+ */
+static int connectTo(const string& path) {
+	sockaddr_un addr;
+	if(!makeAddress(path, addr))
+		return -1;
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0)
+		return -1;
+	if(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+		int e = errno;
+		close(fd);
+		errno = e;
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * Test if the peer of a connected socket runs as the current user.
+ * @param fd	Connected socket.
+ * @return		True if it does, false else (errno is set to EACCES if
+ * 				the peer runs as another user).
+ */
+static bool isOwnPeer(int fd) {
+#ifdef SO_PEERCRED
+	ucred cred;
+	socklen_t size = sizeof(cred);
+	if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) < 0)
+		return false;
+	uid_t uid = cred.uid;
+#else
+	uid_t uid;
+	gid_t gid;
+	if(getpeereid(fd, &uid, &gid) < 0)
+		return false;
+#endif
+	if(uid != getuid()) {
+		errno = EACCES;
+		return false;
+	}
+	return true;
+}
+
+
+/**
+ * Build a server.
+ * @param path	Path of the socket.
+ */
+Server::Server(const string& path): _path(path), _fd(-1) {
+}
+
+///
+Server::~Server() {
+	if(_fd >= 0) {
+		close(_fd);
+		unlink(_path.c_str());
+	}
+}
+
+/**
+ * Create the socket and start listening. A socket file left by a dead
+ * server is replaced. The socket file is created accessible only by the
+ * current user (the umask is set around the bind so that no other user
+ * can connect before the permissions are fixed).
+ * @return	True for success, false else (errno gives the cause, EADDRINUSE
+ * 			if another server is listening on the socket).
+ */
+bool Server::listen() {
+	int fd = connectTo(_path);
+	if(fd >= 0) {
+		close(fd);
+		errno = EADDRINUSE;
+		return false;
+	}
+	unlink(_path.c_str());
+	sockaddr_un addr;
+	if(!makeAddress(_path, addr))
+		return false;
+	_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(_fd < 0)
+		return false;
+	mode_t mask = umask(077);
+	int r = bind(_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+	umask(mask);
+	if(r < 0 || ::listen(_fd, 16) < 0) {
+		int e = errno;
+		close(_fd);
+		_fd = -1;
+		errno = e;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Serve the requests until a response asks to stop. A client blocking
+ * the exchange for more than client_timeout seconds is dropped.
+ * @param handler	Function computing the response to a request.
+ */
+void Server::serve(const handler_t& handler) {
+	signal(SIGPIPE, SIG_IGN);
+	while(true) {
+		int fd = accept(_fd, nullptr, nullptr);
+		if(fd < 0) {
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			return;
+		}
+		timeval timeout = { client_timeout, 0 };
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		// read the request
+		Request request;
+		char magic[4];
+		uint32_t count, flag;
+		bool ok = recvAll(fd, magic, 4) && memcmp(magic, "IOCS", 4) == 0
+			&& recvString(fd, request.cwd) && recvInt(fd, count) && count < max_string / 4;
+		for(uint32_t i = 0; ok && i < count; i++) {
+			request.args.emplace_back();
+			ok = recvString(fd, request.args.back());
+		}
+		ok = ok && recvInt(fd, flag);
+		request.has_input = flag != 0;
+		if(ok && request.has_input)
+			ok = recvString(fd, request.input);
+		if(!ok) {
+			close(fd);
+			continue;
+		}
+
+		// process it
+		Response response;
+		handler(request, response);
+		sendString(fd, response.out)
+			&& sendString(fd, response.err)
+			&& sendInt(fd, response.code);
+		close(fd);
+		if(response.stop)
+			return;
+	}
+}
+
+/**
+ * Send a request to a server and output its response.
+ * @param path		Socket path.
+ * @param request	Request to send.
+ * @param out		Stream to output the standard output of the response to.
+ * @param err		Stream to output the error output of the response to.
+ * @return			Exit code of the response or -1 if the server cannot
+ * 					be reached or does not run as the current user (errno
+ * 					gives the cause).
+ */
+int Server::call(const string& path, const Request& request, ostream& out, ostream& err) {
+	signal(SIGPIPE, SIG_IGN);
+	int fd = connectTo(path);
+	if(fd < 0)
+		return -1;
+	if(!isOwnPeer(fd)) {
+		int e = errno;
+		close(fd);
+		errno = e;
+		return -1;
+	}
+	bool ok = sendAll(fd, "IOCS", 4)
+		&& sendString(fd, request.cwd)
+		&& sendInt(fd, request.args.size());
+	for(size_t i = 0; ok && i < request.args.size(); i++)
+		ok = sendString(fd, request.args[i]);
+	ok = ok && sendInt(fd, request.has_input ? 1 : 0);
+	if(ok && request.has_input)
+		ok = sendString(fd, request.input);
+	string o, e;
+	uint32_t code;
+	ok = ok && recvString(fd, o) && recvString(fd, e) && recvInt(fd, code);
+	close(fd);
+	if(!ok) {
+		errno = ECONNRESET;
+		return -1;
+	}
+	out << o << flush;
+	err << e << flush;
+	return int(code);
+}
+
+/**
+ * Get the default path of the server socket: $IOC_SOCKET, else
+ * $XDG_RUNTIME_DIR/ioc.sock, else /tmp/ioc-UID.sock.
+ * @return	Default socket path.
+ */
+string Server::defaultPath() {
+	const char *p = getenv("IOC_SOCKET");
+	if(p != nullptr && *p != '\0')
+		return p;
+	p = getenv("XDG_RUNTIME_DIR");
+	if(p != nullptr && *p != '\0')
+		return string(p) + "/ioc.sock";
+	return "/tmp/ioc-" + to_string(getuid()) + ".sock";
+}
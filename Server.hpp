@@ -0,0 +1,50 @@
+#ifndef IOC_SERVER_HPP
+#define IOC_SERVER_HPP
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+class Server {
+public:
+
+	class Request {
+	public:
+		inline Request(): has_input(false) { }
+		string cwd;
+		vector<string> args;
+		bool has_input;
+		string input;
+	};
+
+	class Response {
+	public:
+		inline Response(): code(0), stop(false) { }
+		string out;
+		string err;
+		int code;
+		bool stop;
+	};
+
+	typedef function<void(const Request& request, Response& response)> handler_t;
+
+	Server(const string& path);
+	Server(const Server&) = delete;
+	Server& operator=(const Server&) = delete;
+	~Server();
+
+	inline const string& path() const { return _path; }
+	bool listen();
+	void serve(const handler_t& handler);
+
+	static int call(const string& path, const Request& request, ostream& out, ostream& err);
+	static string defaultPath();
+
+private:
+	string _path;
+	int _fd;
+};
+
+#endif	// IOC_SERVER_HPP
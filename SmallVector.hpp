@@ -0,0 +1,77 @@
+#ifndef IOC_SMALL_VECTOR_HPP
+#define IOC_SMALL_VECTOR_HPP
+
+#include <cstddef>
+using namespace std;
+
+/**
+ * Vector storing its first N items in place: it only allocates memory
+ * when it grows past N items. T must be default-constructible and
+ * assignable.
+ */
+template <class T, size_t N>
+class SmallVector {
+public:
+	typedef T *iterator;
+	typedef const T *const_iterator;
+
+	inline SmallVector(): _data(_items), _size(0), _capacity(N) { }
+	SmallVector(const SmallVector&) = delete;
+	SmallVector& operator=(const SmallVector&) = delete;
+	inline ~SmallVector() { if(_data != _items) delete [] _data; }
+
+	inline size_t size() const { return _size; }
+	inline bool empty() const { return _size == 0; }
+	inline iterator begin() { return _data; }
+	inline iterator end() { return _data + _size; }
+	inline const_iterator begin() const { return _data; }
+	inline const_iterator end() const { return _data + _size; }
+	inline T& operator[](size_t i) { return _data[i]; }
+	inline const T& operator[](size_t i) const { return _data[i]; }
+	inline T& back() { return _data[_size - 1]; }
+	inline const T& back() const { return _data[_size - 1]; }
+
+	inline void push_back(const T& x) {
+		if(_size == _capacity)
+			grow();
+		_data[_size++] = x;
+	}
+
+	inline void pop_back() { _size--; }
+	inline void clear() { _size = 0; }
+
+	iterator insert(iterator pos, const T& x) {
+		size_t i = pos - _data;
+		if(_size == _capacity)
+			grow();
+		for(size_t j = _size; j > i; j--)
+			_data[j] = _data[j - 1];
+		_data[i] = x;
+		_size++;
+		return _data + i;
+	}
+
+	iterator erase(iterator pos) {
+		for(auto p = pos; p + 1 != end(); ++p)
+			*p = p[1];
+		_size--;
+		return pos;
+	}
+
+private:
+	void grow() {
+		_capacity *= 2;
+		T *data = new T[_capacity];
+		for(size_t i = 0; i < _size; i++)
+			data[i] = _data[i];
+		if(_data != _items)
+			delete [] _data;
+		_data = data;
+	}
+
+	T *_data;
+	size_t _size, _capacity;
+	T _items[N];
+};
+
+#endif	// IOC_SMALL_VECTOR_HPP
@@ -0,0 +1,177 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Source.hpp"
+
+/**
+ * @class Source
+ * Text of a source file ready to be scanned in place. Regular files are
+ * mapped in memory (privately: the file is never modified) and other
+ * inputs (standard input, pipes, strings) are read in a heap buffer.
+ *
+ * In both cases, the text is followed by two null characters as required
+ * by the Flex yy_scan_buffer() function. The buffer is writable because
+ * Flex temporarily puts a null character after each matched token: with
+ * a mapping, only the written pages are copied by the system.
+ */
+
+///
+Source::Source(): _data(nullptr), _size(0), _length(0) {
+}
+
+///
+Source::~Source() {
+	release();
+}
+
+/**
+ * Open a source file.
+ * @param path	Path of the file ("" for the standard input).
+ * @return		True for success, false else (errno gives the cause).
+ */
+bool Source::open(const string& path) {
+	release();
+	if(path == "")
+		return read(0);
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	if(fstat(fd, &st) < 0) {
+		close(fd);
+		return false;
+	}
+	if(!S_ISREG(st.st_mode)) {
+		bool r = read(fd);
+		close(fd);
+		return r;
+	}
+
+	// reserve zeroed memory including the two final null characters
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t length = (st.st_size + 2 + page - 1) / page * page;
+	void *base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(base == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	// map the file over it (end of the last file page is filled with zeroes)
+	if(st.st_size != 0
+	&& mmap(base, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(base, length);
+		close(fd);
+		return false;
+	}
+	close(fd);
+	_data = static_cast<char *>(base);
+	_size = st.st_size;
+	_length = length;
+	return true;
+}
+
+/**
+ * Read the whole content of a file descriptor in a heap buffer.
+ * @param fd	File descriptor to read.
+ * @return		True for success, false else.
+ */
+bool Source::read(int fd) {
+	size_t cap = 1 << 16;
+	_data = static_cast<char *>(malloc(cap));
+	_size = 0;
+	while(true) {
+		if(_size + 2 > cap) {
+			cap *= 2;
+			_data = static_cast<char *>(realloc(_data, cap));
+		}
+		ssize_t n = ::read(fd, _data + _size, cap - _size - 2);
+		if(n < 0) {
+			release();
+			return false;
+		}
+		if(n == 0)
+			break;
+		_size += n;
+	}
+	_data[_size] = '\0';
+	_data[_size + 1] = '\0';
+	return true;
+}
+
+/**
+ * Use a string as source text (the string is copied).
+ * @param text	Source text.
+ */
+void Source::assign(const string& text) {
+	release();
+	_data = static_cast<char *>(malloc(text.size() + 2));
+	memcpy(_data, text.data(), text.size());
+	_size = text.size();
+	_data[_size] = '\0';
+	_data[_size + 1] = '\0';
+}
+
+/**
+ * Write a file atomically. The data are first written in a temporary
+ * file then renamed so that concurrent compilations never see a partial
+ * file.
+ * @param path	Path of the file.
+ * @param data	Data to write.
+ * @return		True for success, false else.
+ */
+bool Source::write(const string& path, const string& data) {
+	string tmp = path + ".XXXXXX";
+	int fd = mkstemp(&tmp[0]);
+	if(fd < 0)
+		return false;
+	fchmod(fd, 0644);
+	size_t done = 0;
+	while(done < data.size()) {
+		auto n = ::write(fd, data.data() + done, data.size() - done);
+		if(n <= 0)
+			break;
+		done += n;
+	}
+	if(close(fd) < 0 || done != data.size() || rename(tmp.c_str(), path.c_str()) < 0) {
+		unlink(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Release the source text.
+ */
+void Source::release() {
+	if(_length != 0)
+		munmap(_data, _length);
+	else
+		free(_data);
+	_data = nullptr;
+	_size = 0;
+	_length = 0;
+}
+
+/**
+ * @fn const char *Source::data() const;
+ * Get the source text (followed by two null characters).
+ */
+
+/**
+ * @fn char *Source::buffer() const;
+ * Get the source text as a writable buffer (for the Flex scanner).
+ */
+
+/**
+ * @fn size_t Source::size() const;
+ * Get the size of the source text (without the final null characters).
+ */
+
+/**
+ * @fn bool Source::mapped() const;
+ * Test if the source text is mapped from a file.
+ */
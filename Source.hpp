@@ -0,0 +1,31 @@
+#ifndef IOC_SOURCE_HPP
+#define IOC_SOURCE_HPP
+
+#include <cstddef>
+#include <string>
+using namespace std;
+
+class Source {
+public:
+	Source();
+	Source(const Source&) = delete;
+	Source& operator=(const Source&) = delete;
+	~Source();
+
+	bool open(const string& path);
+	void assign(const string& text);
+	inline const char *data() const { return _data; }
+	inline char *buffer() const { return _data; }
+	inline size_t size() const { return _size; }
+	inline bool mapped() const { return _length != 0; }
+
+	static bool write(const string& path, const string& data);
+
+private:
+	bool read(int fd);
+	void release();
+	char *_data;
+	size_t _size, _length;
+};
+
+#endif	// IOC_SOURCE_HPP
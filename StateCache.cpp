@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cstring>
+#include "StateCache.hpp"
+
+/**
+ * @class StateCache
+ * Cache of the compiled states of automata, used for incremental
+ * recompilation. The states are identified by a structural hash of their
+ * AST (see State::hash()) and the cache records the basic blocks they are
+ * compiled to, after instruction selection and register allocation.
+ *
+ * The code of a state does not depend on its position in the program
+ * except for the labels it allocates for its own use (local labels): they
+ * are relocated when a state is reused at another position. The registers
+ * allocated by the state do not appear in the allocated code.
+ *
+ * The cache is bounded in number of states: when it is full, the least
+ * recently used half is removed.
+ */
+
+/**
+ * @class StateCache::Block
+ * Basic block of a compiled state: allocated instructions, labels defined
+ * at the start of the block, label of the branch ending the block (if any)
+ * and how the block continues (with the following block or with the exit
+ * of the program).
+ */
+
+/**
+ * @class StateCache::Entry
+ * Compiled state: its blocks, the first local label (base) and the numbers
+ * of labels and of registers allocated by the state.
+ */
+
+/**
+ * Build a state cache.
+ * @param capacity	Maximal number of states.
+ */
+StateCache::StateCache(size_t capacity): _capacity(capacity), _clock(0) {
+}
+
+/**
+ * Look for a state. A found state becomes the most recently used one.
+ * @param key	State key (hash of the state).
+ * @return		Found entry or a null pointer.
+ */
+shared_ptr<const StateCache::Entry> StateCache::find(const string& key) {
+	lock_guard<mutex> lock(_mutex);
+	auto i = _items.find(key);
+	if(i == _items.end())
+		return nullptr;
+	i->second.used = ++_clock;
+	return i->second.entry;
+}
+
+/**
+ * Add a state, possibly removing the least recently used ones.
+ * @param key	State key.
+ * @param entry	Compiled state.
+ */
+void StateCache::put(const string& key, shared_ptr<const Entry> entry) {
+	lock_guard<mutex> lock(_mutex);
+	if(_items.size() >= _capacity) {
+		vector<uint64_t> uses;
+		for(const auto& i: _items)
+			uses.push_back(i.second.used);
+		auto mid = uses.begin() + uses.size() / 2;
+		nth_element(uses.begin(), mid, uses.end());
+		auto limit = *mid;
+		for(auto i = _items.begin(); i != _items.end(); )
+			if(i->second.used <= limit)
+				i = _items.erase(i);
+			else
+				++i;
+	}
+	_items[key] = { entry, ++_clock };
+}
+
+/**
+ * Get the number of states in the cache.
+ * @return	Number of states.
+ */
+size_t StateCache::size() {
+	lock_guard<mutex> lock(_mutex);
+	return _items.size();
+}
+
+/**
+ * Remove all the states.
+ */
+void StateCache::clear() {
+	lock_guard<mutex> lock(_mutex);
+	_items.clear();
+}
+
+/**
+ * Test if a parameter of an instruction is a label.
+ * @param inst	Instruction.
+ * @param i		Parameter index.
+ * @return		True if the parameter is output as a label ("L%i").
+ */
+static bool isLabel(const Inst& inst, int i) {
+	for(auto p = strstr(inst.format(), "L%"); p != nullptr; p = strstr(p + 2, "L%"))
+		if(p[2] == '0' + i)
+			return true;
+	return false;
+}
+
+/**
+ * Relocate the local labels of a block.
+ * @param block	Block to relocate.
+ * @param from	First local label in the block.
+ * @param count	Number of local labels.
+ * @param to	New first local label.
+ */
+void StateCache::relocate(Block& block, Quad::lab_t from, unsigned count, Quad::lab_t to) {
+	auto fix = [from, count, to](Quad::lab_t l) {
+		return l >= from && l < from + count ? l - from + to : l;
+	};
+	for(auto& l: block.labels)
+		l = fix(l);
+	if(block.branch)
+		block.target = fix(block.target);
+	for(auto& inst: block.insts)
+		for(int i = 0; i < Inst::param_num; i++)
+			if(inst[i].type() == Param::CST && isLabel(inst, i))
+				inst[i] = Param::cst(fix(uint32_t(inst[i].value())));
+}
+
+/**
+ * Get the cache shared by the compilations of the process.
+ * @return	Global state cache.
+ */
+StateCache& StateCache::global() {
+	static StateCache cache;
+	return cache;
+}
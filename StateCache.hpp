@@ -0,0 +1,59 @@
+#ifndef IOC_STATE_CACHE_HPP
+#define IOC_STATE_CACHE_HPP
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "Inst.hpp"
+#include "Quad.hpp"
+
+class StateCache {
+public:
+	static constexpr size_t default_capacity = 1 << 16;
+
+	class Block {
+	public:
+		inline Block(): branch(false), target(0), next(false), exit(false) { }
+		vector<Inst> insts;
+		vector<Quad::lab_t> labels;
+		bool branch;
+		Quad::lab_t target;
+		bool next;
+		bool exit;
+	};
+
+	class Entry {
+	public:
+		inline Entry(): base(0), labs(0), regs(0) { }
+		Quad::lab_t base;
+		unsigned labs, regs;
+		vector<Block> blocks;
+	};
+
+	StateCache(size_t capacity = default_capacity);
+	shared_ptr<const Entry> find(const string& key);
+	void put(const string& key, shared_ptr<const Entry> entry);
+	size_t size();
+	void clear();
+
+	static void relocate(Block& block, Quad::lab_t from, unsigned count, Quad::lab_t to);
+	static StateCache& global();
+
+private:
+	class Item {
+	public:
+		shared_ptr<const Entry> entry;
+		uint64_t used;
+	};
+
+	mutex _mutex;
+	map<string, Item> _items;
+	size_t _capacity;
+	uint64_t _clock;
+};
+
+#endif	// IOC_STATE_CACHE_HPP
@@ -0,0 +1,112 @@
+#include <cstring>
+#include "SymbolTable.hpp"
+
+/**
+ * @class SymbolTable
+ * Interning table for identifiers: each different name gets a small
+ * integer identifier, allocated in order from 0, so that the rest of
+ * the compiler can compare names and index tables by identifier.
+ *
+ * Names are looked up in an open-addressing hash table with linear
+ * probing whose load is kept below 1/2.
+ */
+
+/**
+ * Initial number of slots (must be a power of 2).
+ */
+static const size_t initial_slots = 256;
+
+///
+SymbolTable::SymbolTable(): _slots(initial_slots, none) {
+}
+
+/**
+ * FNV-1a hash of a name.
+ * @param name	Name characters.
+ * @param len	Name length.
+ * @return		Hash value.
+ */
+uint32_t SymbolTable::hash(const char *name, size_t len) {
+	uint32_t h = 2166136261u;
+	for(size_t i = 0; i < len; i++) {
+		h ^= static_cast<unsigned char>(name[i]);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/**
+ * Find the slot of a name.
+ * @param name	Name characters.
+ * @param len	Name length.
+ * @param h		Hash of the name.
+ * @return		Slot containing the name or first empty slot of its probe sequence.
+ */
+size_t SymbolTable::lookup(const char *name, size_t len, uint32_t h) const {
+	size_t mask = _slots.size() - 1;
+	for(size_t i = h & mask; ; i = (i + 1) & mask) {
+		id_t id = _slots[i];
+		if(id == none)
+			return i;
+		if(_hashes[id] == h && _names[id].size() == len
+		&& memcmp(_names[id].data(), name, len) == 0)
+			return i;
+	}
+}
+
+/**
+ * Double the number of slots and re-insert the names.
+ */
+void SymbolTable::grow() {
+	vector<id_t> slots(_slots.size() * 2, none);
+	size_t mask = slots.size() - 1;
+	for(id_t id = 0; id < _names.size(); id++) {
+		size_t i = _hashes[id] & mask;
+		while(slots[i] != none)
+			i = (i + 1) & mask;
+		slots[i] = id;
+	}
+	_slots.swap(slots);
+}
+
+/**
+ * Get the identifier of a name, creating it if needed.
+ * @param name	Name characters.
+ * @param len	Name length.
+ * @return		Name identifier.
+ */
+SymbolTable::id_t SymbolTable::intern(const char *name, size_t len) {
+	uint32_t h = hash(name, len);
+	size_t i = lookup(name, len, h);
+	if(_slots[i] != none)
+		return _slots[i];
+	id_t id = _names.size();
+	_names.emplace_back(name, len);
+	_hashes.push_back(h);
+	_slots[i] = id;
+	if(_names.size() * 2 > _slots.size())
+		grow();
+	return id;
+}
+
+/**
+ * Look for the identifier of a name without creating it.
+ * @param name	Name characters.
+ * @param len	Name length.
+ * @return		Name identifier or SymbolTable::none.
+ */
+SymbolTable::id_t SymbolTable::find(const char *name, size_t len) const {
+	return _slots[lookup(name, len, hash(name, len))];
+}
+
+/**
+ * @fn const string& SymbolTable::name(id_t id) const;
+ * Get the name of an identifier.
+ * @param id	Name identifier.
+ * @return		Corresponding name.
+ */
+
+/**
+ * @fn size_t SymbolTable::size() const;
+ * Get the number of interned names.
+ */
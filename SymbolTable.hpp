@@ -0,0 +1,33 @@
+#ifndef IOC_SYMBOL_TABLE_HPP
+#define IOC_SYMBOL_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+class SymbolTable {
+public:
+	typedef uint32_t id_t;
+	static constexpr id_t none = UINT32_MAX;
+
+	SymbolTable();
+	id_t intern(const char *name, size_t len);
+	inline id_t intern(const string& name) { return intern(name.data(), name.size()); }
+	id_t find(const char *name, size_t len) const;
+	inline id_t find(const string& name) const { return find(name.data(), name.size()); }
+	inline const string& name(id_t id) const { return _names[id]; }
+	inline size_t size() const { return _names.size(); }
+
+private:
+	static uint32_t hash(const char *name, size_t len);
+	size_t lookup(const char *name, size_t len, uint32_t h) const;
+	void grow();
+
+	vector<string> _names;
+	vector<uint32_t> _hashes;
+	vector<id_t> _slots;
+};
+
+#endif	// IOC_SYMBOL_TABLE_HPP
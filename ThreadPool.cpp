@@ -0,0 +1,160 @@
+#include "ThreadPool.hpp"
+
+/**
+ * Pool and index of the queue of the calling thread: the workers of a pool
+ * own its queues 1 to n-1, all other threads (including the workers of
+ * other pools) share its queue 0.
+ */
+static thread_local const ThreadPool *queue_pool = nullptr;
+static thread_local unsigned queue_index = 0;
+
+/**
+ * @class ThreadPool
+ * Work-stealing pool of threads. Each thread owns a queue of tasks that it
+ * consumes from the front, in the order of the indexes, while idle threads
+ * steal from the back of the other queues: a pool of one thread calls the
+ * jobs in order. The thread calling parallelFor() takes part in the work
+ * so that parallel loops can be nested without dead-lock, in the same pool
+ * or in a pool created by a job of another.
+ */
+
+/**
+ * Build the thread pool.
+ * @param workers	Number of threads executing the tasks, including the
+ * 					calling thread (0 to use the hardware concurrency).
+ */
+ThreadPool::ThreadPool(unsigned workers): _queued(0), _stop(false) {
+	if(workers == 0)
+		workers = thread::hardware_concurrency();
+	if(workers == 0)
+		workers = 1;
+	_queues = vector<Queue>(workers);
+	for(unsigned i = 1; i < workers; i++)
+		_threads.push_back(thread(&ThreadPool::work, this, i));
+}
+
+///
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<mutex> guard(_lock);
+		_stop = true;
+	}
+	_wake.notify_all();
+	for(auto& t: _threads)
+		t.join();
+}
+
+/**
+ * Call the job for each index in [0, count[ and wait for the end of all calls.
+ * The indexes are spread in contiguous ranges over the thread queues. If a job
+ * throws an exception, the first one is re-thrown once all jobs are done.
+ * @param count		Number of job calls.
+ * @param job		Job to call.
+ */
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& job) {
+	if(count == 0)
+		return;
+
+	// dispatch the tasks
+	Batch batch(job, count);
+	size_t n = _queues.size();
+	_queued += count;
+	for(size_t q = 0; q < n; q++) {
+		size_t b = count * q / n, e = count * (q + 1) / n;
+		if(b == e)
+			continue;
+		lock_guard<mutex> guard(_queues[q].lock);
+		for(size_t i = b; i < e; i++)
+			_queues[q].tasks.push_back(Task(&batch, i));
+	}
+	{
+		lock_guard<mutex> guard(_lock);
+	}
+	_wake.notify_all();
+
+	// help until the batch is done
+	while(batch.pending != 0) {
+		Task task;
+		if(take(queue_pool == this ? queue_index : 0, task))
+			execute(task);
+		else {
+			unique_lock<mutex> guard(_lock);
+			_wake.wait(guard, [&] { return batch.pending == 0 || _queued != 0; });
+		}
+	}
+
+	if(batch.error)
+		rethrow_exception(batch.error);
+}
+
+/**
+ * Main loop of a worker thread.
+ * @param index		Index of the worker queue.
+ */
+void ThreadPool::work(unsigned index) {
+	queue_pool = this;
+	queue_index = index;
+	while(true) {
+		Task task;
+		if(take(index, task))
+			execute(task);
+		else {
+			unique_lock<mutex> guard(_lock);
+			_wake.wait(guard, [&] { return _stop || _queued != 0; });
+			if(_stop)
+				return;
+		}
+	}
+}
+
+/**
+ * Take a task from the own queue or steal it from another queue.
+ * @param index		Index of the own queue.
+ * @param task		Filled with the taken task.
+ * @return			True if a task has been found, false else.
+ */
+bool ThreadPool::take(unsigned index, Task& task) {
+	{
+		auto& q = _queues[index];
+		lock_guard<mutex> guard(q.lock);
+		if(!q.tasks.empty()) {
+			task = q.tasks.front();
+			q.tasks.pop_front();
+			_queued--;
+			return true;
+		}
+	}
+	for(size_t i = 1; i < _queues.size(); i++) {
+		auto& q = _queues[(index + i) % _queues.size()];
+		lock_guard<mutex> guard(q.lock);
+		if(!q.tasks.empty()) {
+			task = q.tasks.back();
+			q.tasks.pop_back();
+			_queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Execute a task and signal the end of its batch.
+ * @param task	Task to execute.
+ */
+void ThreadPool::execute(const Task& task) {
+	auto batch = task.batch;
+	try {
+		batch->job(task.index);
+	}
+	catch(...) {
+		lock_guard<mutex> guard(batch->lock);
+		if(!batch->error)
+			batch->error = current_exception();
+	}
+	if(batch->pending.fetch_sub(1) == 1) {
+		{
+			lock_guard<mutex> guard(_lock);
+		}
+		_wake.notify_all();
+	}
+}
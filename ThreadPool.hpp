@@ -0,0 +1,59 @@
+#ifndef IOC_THREAD_POOL_HPP
+#define IOC_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+class ThreadPool {
+public:
+	ThreadPool(unsigned workers = 0);
+	~ThreadPool();
+	inline unsigned size() const { return _queues.size(); }
+	void parallelFor(size_t count, const function<void(size_t)>& job);
+
+private:
+
+	class Batch {
+	public:
+		inline Batch(const function<void(size_t)>& job_, size_t count)
+			: job(job_), pending(count) {}
+		const function<void(size_t)>& job;
+		atomic<size_t> pending;
+		mutex lock;
+		exception_ptr error;
+	};
+
+	class Task {
+	public:
+		inline Task(): batch(nullptr), index(0) {}
+		inline Task(Batch *batch_, size_t index_): batch(batch_), index(index_) {}
+		Batch *batch;
+		size_t index;
+	};
+
+	class Queue {
+	public:
+		mutex lock;
+		deque<Task> tasks;
+	};
+
+	void work(unsigned index);
+	bool take(unsigned index, Task& task);
+	void execute(const Task& task);
+
+	vector<Queue> _queues;
+	vector<thread> _threads;
+	mutex _lock;
+	condition_variable _wake, _done;
+	atomic<size_t> _queued;
+	bool _stop;
+};
+
+#endif	// IOC_THREAD_POOL_HPP
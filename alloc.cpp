@@ -0,0 +1,44 @@
+#include <cstdlib>
+#include <new>
+#include "Report.hpp"
+
+/*
+ * Replacement of the global allocation operators counting the heap
+ * allocations for the time reports (see Report::allocations()). It is
+ * linked in the programs (ioc, bench) but not in the library, whose
+ * users keep their own allocator.
+ */
+
+/**
+ * Number of heap allocations performed by the calling thread.
+ */
+static thread_local size_t alloc_count = 0;
+
+/**
+ * Get the number of heap allocations of the calling thread.
+ * @return	Number of allocations.
+ */
+static size_t countAllocations() {
+	return alloc_count;
+}
+
+static bool installed = (Report::setAllocationCounter(countAllocations), true);
+
+///
+void *operator new(size_t size) {
+	alloc_count++;
+	void *p = malloc(size == 0 ? 1 : size);
+	if(p == nullptr)
+		throw bad_alloc();
+	return p;
+}
+
+///
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+///
+void operator delete(void *p, size_t) noexcept {
+	free(p);
+}
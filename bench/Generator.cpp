@@ -0,0 +1,165 @@
+#include <sstream>
+#include "Generator.hpp"
+
+/**
+ * @class Generator
+ * Generator of synthetic IOML automata used to measure the scaling of ioc.
+ * The generated sources are always valid and only depend on the parameters
+ * and on the random seed.
+ */
+
+static const char *binops[] = { "+", "-", "*", "&", "|", "^", "<<", ">>" };
+static const char *comps[] = { "=", "!=", "<", "<=", ">", ">=" };
+
+///
+Generator::Generator():
+	states(100),
+	whens(2),
+	stmts(4),
+	depth(3),
+	decls(16),
+	vars(4),
+	seed(1),
+	_state(1)
+{ }
+
+/**
+ * Get a pseudo-random number.
+ * @param n		Upper bound (excluded).
+ * @return		Number in [0, n[.
+ */
+uint32_t Generator::random(uint32_t n) {
+	_state = _state * 1103515245 + 12345;
+	return (_state >> 8) % n;
+}
+
+/**
+ * Generate an expression tree.
+ * @param out	Stream to output to.
+ * @param depth	Depth of the tree.
+ */
+void Generator::genExpr(ostream& out, int depth) {
+	if(depth <= 0)
+		switch(random(4)) {
+		case 0:	out << random(256); break;
+		case 1:	out << "C" << random(decls); break;
+		case 2:	out << "V" << random(vars); break;
+		case 3:	out << "R" << random(decls) << "[" << random(16) + 8 << ".." << random(8) << "]"; break;
+		}
+	else {
+		auto op = random(sizeof(binops) / sizeof(binops[0]));
+		out << "(";
+		genExpr(out, depth - 1);
+		out << " " << binops[op] << " ";
+		if(op >= 6)
+			out << random(16);
+		else
+			genExpr(out, depth - 1 - random(2));
+		out << ")";
+	}
+}
+
+/**
+ * Generate a condition.
+ * @param out	Stream to output to.
+ */
+void Generator::genCond(ostream& out) {
+	genExpr(out, depth / 2);
+	out << " " << comps[random(sizeof(comps) / sizeof(comps[0]))] << " ";
+	genExpr(out, depth / 2);
+	if(random(4) == 0) {
+		out << " and not ";
+		genExpr(out, 0);
+		out << " = 0";
+	}
+}
+
+/**
+ * Generate a statement.
+ * @param out		Stream to output to.
+ * @param indent	Indentation level.
+ * @param nest		Allowed nesting of if statements.
+ */
+void Generator::genStmt(ostream& out, int indent, int nest) {
+	string tabs(indent, '\t');
+	switch(random(nest > 0 ? 4 : 3)) {
+	case 0:
+		out << tabs << "V" << random(vars) << " = ";
+		genExpr(out, depth);
+		out << "\n";
+		break;
+	case 1:
+		out << tabs << "R" << random(decls) << " = ";
+		genExpr(out, depth);
+		out << "\n";
+		break;
+	case 2: {
+			int lo = random(16);
+			out << tabs << "R" << random(decls) << "[" << lo + random(8) << ".." << lo << "] = ";
+			genExpr(out, depth - 1);
+			out << "\n";
+		}
+		break;
+	case 3:
+		out << tabs << "if ";
+		genCond(out);
+		out << " then\n";
+		genStmt(out, indent + 1, nest - 1);
+		genStmt(out, indent + 1, nest - 1);
+		if(random(2) == 0) {
+			out << tabs << "else\n";
+			genStmt(out, indent + 1, nest - 1);
+		}
+		out << tabs << "endif\n";
+		break;
+	}
+}
+
+/**
+ * Generate the automaton.
+ * @param out	Stream to output to.
+ */
+void Generator::generate(ostream& out) {
+	_state = seed;
+	out << "/* generated: " << states << " states, " << whens << " whens, "
+		<< stmts << " statements, depth " << depth << " */\n\n";
+
+	// declarations
+	for(int i = 0; i < decls; i++)
+		out << "const C" << i << " = " << random(1 << 16) << "\n";
+	for(int i = 0; i < decls; i++)
+		out << "reg R" << i << " @ 0x40020000 + " << i << " * 4\n";
+	for(int i = 0; i < whens; i++)
+		out << "sig S" << i << " @ R" << i % decls << "[" << i % 32 << "]\n";
+	for(int i = 0; i < vars; i++)
+		out << "var V" << i << "\n";
+
+	// automaton
+	out << "\nauto A\n";
+	for(int i = 0; i < vars; i++)
+		out << "\tV" << i << " = 0\n";
+	for(int s = 0; s < states; s++) {
+		out << "\n\tstate s" << s << ":\n";
+		for(int i = 0; i < stmts; i++)
+			genStmt(out, 2, 1);
+		for(int w = 0; w < whens; w++) {
+			out << "\t\twhen " << (random(2) == 0 ? "!" : "") << "S" << w << ":\n";
+			if(random(2) == 0)
+				genStmt(out, 3, 0);
+			if(s == states - 1 && w == whens - 1)
+				out << "\t\t\tstop\n";
+			else
+				out << "\t\t\tgoto s" << random(states) << "\n";
+		}
+	}
+}
+
+/**
+ * Generate the automaton in a string.
+ * @return	Generated source.
+ */
+string Generator::generate() {
+	ostringstream out;
+	generate(out);
+	return out.str();
+}
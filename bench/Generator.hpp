@@ -0,0 +1,32 @@
+#ifndef IOC_BENCH_GENERATOR_HPP
+#define IOC_BENCH_GENERATOR_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+using namespace std;
+
+class Generator {
+public:
+	Generator();
+
+	int states;			// number of states
+	int whens;			// number of when per state
+	int stmts;			// number of statements per state
+	int depth;			// depth of the expression trees
+	int decls;			// number of reg and const declarations
+	int vars;			// number of variables
+	uint32_t seed;		// random seed
+
+	void generate(ostream& out);
+	string generate();
+
+private:
+	uint32_t random(uint32_t n);
+	void genExpr(ostream& out, int depth);
+	void genCond(ostream& out);
+	void genStmt(ostream& out, int indent, int nest);
+	uint32_t _state;
+};
+
+#endif	// IOC_BENCH_GENERATOR_HPP
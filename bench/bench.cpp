@@ -0,0 +1,319 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "Compiler.hpp"
+#include "Report.hpp"
+#include "Lexer.hpp"
+#include "Generator.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ * Token scanned by a scanner, with its value and its line.
+ */
+class Token {
+public:
+	int token;
+	long value;
+	int line;
+	inline bool operator==(const Token& t) const
+		{ return token == t.token && value == t.value && line == t.line; }
+};
+
+/**
+ * Scan a source with the Flex scanner or with a hand-written scanner.
+ * @param text		Source to scan.
+ * @param name		Source name.
+ * @param kind		Kind of scanner.
+ * @param tokens	If not null, to store the scanned tokens in.
+ * @return			Number of scanned tokens.
+ */
+static size_t scan(const Source& text, const string& name, Scanner::kind_t kind, vector<Token> *tokens = nullptr) {
+	CompilationUnit unit(name);
+	CompilationUnit::Scope scope(unit);
+	YYSTYPE val;
+	size_t n = 0;
+	if(kind == Scanner::FLEX) {
+		yyscan_t scanner;
+		yylex_init_extra(&unit, &scanner);
+		auto buffer = yy_scan_buffer(text.buffer(), text.size() + 2, scanner);
+		for(int t = yylex(&val, scanner); t != 0; t = yylex(&val, scanner)) {
+			n++;
+			if(tokens != nullptr)
+				tokens->push_back({ t, t == ID ? long(val.ID) : t == STRING ? long(val.STRING) : t == INT ? val.INT : 0, unit.line() });
+		}
+		yy_delete_buffer(buffer, scanner);
+		yylex_destroy(scanner);
+	}
+	else {
+		Scanner scanner(unit, text, kind);
+		for(int t = scanner.next(&val); t != 0; t = scanner.next(&val)) {
+			n++;
+			if(tokens != nullptr)
+				tokens->push_back({ t, t == ID ? long(val.ID) : t == STRING ? long(val.STRING) : t == INT ? val.INT : 0, unit.line() });
+		}
+	}
+	return n;
+}
+
+/**
+ * Get the kinds of scanner to measure: Flex and the hand-written scanner
+ * with each kernel supported by the processor.
+ * @return	Kinds of scanner.
+ */
+static vector<Scanner::kind_t> scanners() {
+	vector<Scanner::kind_t> kinds = { Scanner::FLEX, Scanner::SCALAR };
+	if(Scanner::best() != Scanner::SCALAR)
+		kinds.push_back(Scanner::SSE2);
+	if(Scanner::best() == Scanner::AVX2)
+		kinds.push_back(Scanner::AVX2);
+	return kinds;
+}
+
+/**
+ * Check that the hand-written scanners produce the same token stream
+ * as the Flex scanner.
+ * @param source	Source text.
+ * @param name		Source name.
+ * @return			True if all token streams are the same.
+ */
+static bool checkScanners(const string& source, const string& name) {
+	Source text;
+	text.assign(source);
+	vector<Token> ref;
+	scan(text, name, Scanner::FLEX, &ref);
+	for(auto kind: scanners()) {
+		vector<Token> tokens;
+		scan(text, name, kind, &tokens);
+		if(tokens != ref) {
+			cerr << "ERROR: " << Scanner::name(kind) << " scanner differs from flex on " << name << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Count the instructions of a CFG.
+ * @param g	CFG to count in.
+ * @return	Number of instructions.
+ */
+static size_t countInstructions(const CFG<Inst>& g) {
+	size_t n = 0;
+	for(auto bb: g.basicBlocks())
+		n += bb->instructions().size();
+	return n;
+}
+
+/**
+ * Measure the phases of the compilation of a source. If a pool is given,
+ * the generation, the selection and the allocation are also measured on
+ * the pool and their assembly is checked against the sequential one.
+ * @param source	Source text.
+ * @param name		Source name.
+ * @param pool		Pool of threads (nullptr for sequential phases only).
+ * @param ok		Set to false if the parallel phases give another assembly.
+ * @return			Report of the phases.
+ */
+static Report measure(const string& source, const string& name, ThreadPool *pool, bool& ok) {
+	Report report(name);
+
+	// lexing alone, with each scanner
+	{
+		Source text;
+		text.assign(source);
+		for(auto kind: scanners()) {
+			report.start(kind == Scanner::FLEX ? "lex" : string("lex-") + Scanner::name(kind));
+			size_t tokens = scan(text, name, kind);
+			report.stop(tokens, "tokens");
+		}
+	}
+
+	// whole compilation
+	CompilationUnit unit(name);
+	CompilationUnit::Scope scope(unit);
+	Source text;
+	text.assign(source);
+	report.start("parse");
+	unit.parse(text);
+	report.stop(unit.nodeCount(), "nodes");
+
+	report.start("gen");
+	QuadProgram quads;
+	for(auto d: unit.declarations())
+		if(d->type() == Declaration::VAR)
+			quads.declare(d->name());
+	unit.automaton()->gen(quads);
+	report.stop(quads.count(), "quads");
+
+	report.start("cfg");
+	unique_ptr<CFG<Quad> > cfg(quads.makeCFG());
+	report.stop(cfg->basicBlocks().size(), "BBs");
+
+	report.start("select");
+	unique_ptr<CFG<Inst> > inst_cfg(selectInstructions(cfg.get()));
+	report.stop(countInstructions(*inst_cfg), "insts");
+
+	report.start("alloc");
+	allocRegisters(*inst_cfg, quads);
+	report.stop(countInstructions(*inst_cfg), "insts");
+
+	// same phases on the pool of threads
+	if(pool != nullptr) {
+		report.start("gen-mt");
+		QuadProgram par_quads;
+		for(auto d: unit.declarations())
+			if(d->type() == Declaration::VAR)
+				par_quads.declare(d->name());
+		unit.automaton()->gen(par_quads, pool);
+		report.stop(par_quads.count(), "quads");
+
+		report.start("select-mt");
+		unique_ptr<CFG<Quad> > par_quads_cfg(par_quads.makeCFG());
+		unique_ptr<CFG<Inst> > par_cfg(selectInstructions(par_quads_cfg.get(), pool));
+		report.stop(countInstructions(*par_cfg), "insts");
+
+		report.start("alloc-mt");
+		allocRegisters(*par_cfg, par_quads, pool);
+		report.stop(countInstructions(*par_cfg), "insts");
+
+		ostringstream seq_out, par_out;
+		outputAssembly(*inst_cfg, seq_out);
+		outputAssembly(*par_cfg, par_out);
+		if(seq_out.str() != par_out.str()) {
+			cerr << "ERROR: parallel selection and allocation differ on " << name << endl;
+			ok = false;
+		}
+	}
+
+	return report;
+}
+
+/**
+ * Print help message.
+ */
+void printHelp() {
+	cerr << "SYNTAX: bench [options]\n"
+		 << "Measure the compilation throughput of ioc on synthetic automata.\n"
+		 << "Options may be:\n"
+		 << "-h, --help     	- display this message.\n"
+		 << "-sizes N,...   	- numbers of states (default 1000,10000,100000).\n"
+		 << "-whens N       	- number of when per state (default 2).\n"
+		 << "-stmts N       	- number of statements per state (default 4).\n"
+		 << "-depth N       	- depth of expressions (default 3).\n"
+		 << "-decls N       	- number of reg and const declarations (default 16).\n"
+		 << "-repeat N      	- number of runs per size, the best is kept (default 3).\n"
+		 << "-threads N     	- threads of the parallel gen, select and alloc (default 0 for all cores, 1 to skip).\n"
+		 << "-json          	- output one JSON report per size.\n";
+}
+
+/**
+ * Benchmark entry.
+ */
+int main(int argc, const char **argv) {
+	Generator gen;
+	vector<int> sizes = { 1000, 10000, 100000 };
+	int repeat = 3;
+	unsigned threads = 0;
+	bool json = false;
+
+	// parse arguments
+	for(int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if(arg == "-h" || arg == "--help") {
+			printHelp();
+			return 1;
+		}
+		else if(arg == "-json") {
+			json = true;
+			continue;
+		}
+		if(i + 1 >= argc) {
+			printHelp();
+			cerr << "ERROR: bad argument " << arg << endl;
+			return 2;
+		}
+		string val = argv[++i];
+		if(arg == "-sizes") {
+			sizes.clear();
+			istringstream in(val);
+			string n;
+			while(getline(in, n, ','))
+				sizes.push_back(atoi(n.c_str()));
+		}
+		else if(arg == "-whens")
+			gen.whens = atoi(val.c_str());
+		else if(arg == "-stmts")
+			gen.stmts = atoi(val.c_str());
+		else if(arg == "-depth")
+			gen.depth = atoi(val.c_str());
+		else if(arg == "-decls")
+			gen.decls = atoi(val.c_str());
+		else if(arg == "-repeat")
+			repeat = atoi(val.c_str());
+		else if(arg == "-threads")
+			threads = atoi(val.c_str());
+		else {
+			printHelp();
+			cerr << "ERROR: unknown argument " << arg << endl;
+			return 2;
+		}
+	}
+
+	// perform the measures
+	unique_ptr<ThreadPool> pool;
+	if(threads != 1)
+		pool.reset(new ThreadPool(threads));
+	vector<Report> reports;
+	for(auto size: sizes) {
+		gen.states = size;
+		string source = gen.generate();
+		string name = "states=" + to_string(size);
+		if(!checkScanners(source, name))
+			return 1;
+		bool ok = true;
+		Report best = measure(source, name, pool.get(), ok);
+		for(int i = 1; i < repeat; i++)
+			best.keepFastest(measure(source, name, pool.get(), ok));
+		if(!ok)
+			return 1;
+		reports.push_back(best);
+		if(json)
+			best.printJSON(cout);
+	}
+	if(json)
+		return 0;
+
+	// display the scaling: exponent k of time ~ size^k between successive sizes
+	cout << left << setw(10) << "states" << setw(12) << "phase"
+		 << right << setw(12) << "time (ms)" << setw(10) << "allocs" << setw(10) << "allocs/q" << setw(18) << "items"
+		 << setw(22) << "throughput" << setw(10) << "scaling" << "\n";
+	for(size_t i = 0; i < reports.size(); i++) {
+		size_t quads = 0;
+		for(const auto& p: reports[i].phases())
+			if(p.name == "gen")
+				quads = p.items;
+		for(size_t j = 0; j < reports[i].phases().size(); j++) {
+			const auto& p = reports[i].phases()[j];
+			cout << left << setw(10) << sizes[i] << setw(12) << p.name
+				 << right << fixed << setprecision(3) << setw(12) << p.wall * 1000 << setw(10) << p.allocs
+				 << setw(10) << setprecision(2) << (quads != 0 ? double(p.allocs) / quads : 0) << setprecision(3)
+				 << setw(11) << p.items << " " << left << setw(6) << p.unit << right
+				 << setw(12) << setprecision(0) << (p.wall > 0 ? p.items / p.wall : 0) << " " << left << setw(9) << (p.unit + "/s") << right;
+			if(i == 0 || p.wall <= 0 || reports[i - 1].phases()[j].wall <= 0)
+				cout << setw(10) << "-";
+			else
+				cout << setw(10) << setprecision(2)
+					 << log(p.wall / reports[i - 1].phases()[j].wall) / log(double(sizes[i]) / sizes[i - 1]);
+			cout << "\n";
+		}
+	}
+	for(size_t i = 0; i < reports.size(); i++)
+		cout << "peak RSS (states=" << sizes[i] << "): " << reports[i].peakRSS() << " KiB\n";
+	cout << "(allocs/q: heap allocations of the phase per generated quad)\n";
+	cout << "(scaling: exponent k such that time grows as states^k, 1 is linear)" << endl;
+	return 0;
+}
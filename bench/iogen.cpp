@@ -0,0 +1,66 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "Generator.hpp"
+
+/**
+ * Print help message.
+ */
+void printHelp() {
+	cerr << "SYNTAX: iogen [options]\n"
+		 << "Generate a synthetic IOML automaton on the standard output.\n"
+		 << "Options may be:\n"
+		 << "-h, --help     	- display this message.\n"
+		 << "-states N      	- number of states (default 100).\n"
+		 << "-whens N       	- number of when per state (default 2).\n"
+		 << "-stmts N       	- number of statements per state (default 4).\n"
+		 << "-depth N       	- depth of expressions (default 3).\n"
+		 << "-decls N       	- number of reg and const declarations (default 16).\n"
+		 << "-vars N        	- number of variables (default 4).\n"
+		 << "-seed N        	- random seed (default 1).\n";
+}
+
+/**
+ * Generator entry.
+ */
+int main(int argc, const char **argv) {
+	Generator gen;
+	for(int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if(arg == "-h" || arg == "--help") {
+			printHelp();
+			return 1;
+		}
+		if(i + 1 >= argc) {
+			printHelp();
+			cerr << "ERROR: bad argument " << arg << endl;
+			return 2;
+		}
+		int n = atoi(argv[++i]);
+		if(arg == "-states")
+			gen.states = n;
+		else if(arg == "-whens")
+			gen.whens = n;
+		else if(arg == "-stmts")
+			gen.stmts = n;
+		else if(arg == "-depth")
+			gen.depth = n;
+		else if(arg == "-decls")
+			gen.decls = n;
+		else if(arg == "-vars")
+			gen.vars = n;
+		else if(arg == "-seed")
+			gen.seed = n;
+		else {
+			printHelp();
+			cerr << "ERROR: unknown argument " << arg << endl;
+			return 2;
+		}
+	}
+	if(gen.states < 1 || gen.decls < 1 || gen.vars < 1 || gen.whens < 0 || gen.stmts < 0 || gen.depth < 0) {
+		cerr << "ERROR: bad generation parameters." << endl;
+		return 2;
+	}
+	gen.generate(cout);
+	return 0;
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <memory>
+#include "Quad.hpp"
+
+/*
+ * Dead code elimination of the quadruplets: a SETI, a SETL or a pure
+ * operation whose result is not live after it is removed.
+ *
+ * Only the virtual registers are considered: the hardware registers and
+ * the variables are live everywhere, so STORE, LOAD (the memory is made
+ * of hardware registers), POP, the calls and the branches are always
+ * kept. Few virtual registers live through the BBs, so their liveness is
+ * computed by path exploration, going up from their uses through the
+ * predecessors until a BB writing them, instead of with sets per BB.
+ *
+ * Removing a quad may make the registers it read dead in other BBs: if
+ * some registers live through the BBs, the analysis is performed again
+ * until nothing more is removed.
+ */
+
+/**
+ * Test if a quad only computes its result.
+ * @param q	Quad to test.
+ * @return	True if q can be removed when its result is not used.
+ */
+static inline bool isPure(const Quad& q) {
+	return q.type >= Quad::SETI && q.type <= Quad::ROR;
+}
+
+
+/**
+ * Perform dead code elimination on the program (see above).
+ * @return	Number of removed quads.
+ */
+size_t QuadProgram::eliminateDeadCode() {
+	unique_ptr<CFG<Quad> > g(makeCFG());
+
+	// find the BBs and their quads
+	vector<const BB<Quad> *> bbs(g->basicBlocks().size());
+	for(auto bb: g->basicBlocks())
+		bbs[bb->number()] = bb;
+	auto code = [&](const BB<Quad> *bb) { return bb != g->entry() && bb != g->exit(); };
+	auto first = [&](const BB<Quad> *bb) { return size_t(bb->instructions().begin() - _quads.data()); };
+	auto last = [&](const BB<Quad> *bb) { return size_t(bb->instructions().end() - _quads.data()); };
+	vector<bool> temp(_vreg, true);
+	for(Quad::reg_t r = 0; r < Quad::HARD_COUNT && r < _vreg; r++)
+		temp[r] = false;
+	for(auto r: _vars)
+		temp[r] = false;
+
+	vector<bool> removed(_quads.size(), false);
+	vector<uint32_t> stamp(_vreg, 0), used(_vreg, 0), mark(bbs.size(), 0);
+	vector<pair<Quad::reg_t, uint32_t> > uses, defs, outs;
+	vector<uint32_t> out_begin(bbs.size() + 1), todo;
+	uint32_t s = 0, m = 0;
+	size_t total = 0, count;
+	do {
+		count = 0;
+
+		// find the registers used before written and the written registers of the BBs
+		uses.clear();
+		defs.clear();
+		for(auto bb: bbs) {
+			if(!code(bb))
+				continue;
+			s++;
+			for(size_t i = first(bb); i < last(bb); i++) {
+				const Quad& q = _quads[i];
+				if(removed[i])
+					continue;
+				for(auto r: { q.readsA() ? q.a : 0, q.readsB() ? q.b : 0 })
+					if(temp[r] && stamp[r] != s && used[r] != s) {
+						used[r] = s;
+						uses.push_back(make_pair(r, bb->number()));
+					}
+				if(q.writes() && temp[q.d] && stamp[q.d] != s) {
+					stamp[q.d] = s;
+					defs.push_back(make_pair(q.d, bb->number()));
+				}
+			}
+		}
+		sort(defs.begin(), defs.end());
+
+		// find the registers live at the exit of the BBs
+		outs.clear();
+		for(const auto& u: uses) {
+			m++;
+			todo.push_back(u.second);
+			while(!todo.empty()) {
+				auto bb = bbs[todo.back()];
+				todo.pop_back();
+				for(auto p: bb->predecessors()) {
+					if(mark[p->number()] == m)
+						continue;
+					mark[p->number()] = m;
+					outs.push_back(make_pair(p->number(), u.first));
+					if(!binary_search(defs.begin(), defs.end(), make_pair(u.first, uint32_t(p->number()))))
+						todo.push_back(p->number());
+				}
+			}
+		}
+		sort(outs.begin(), outs.end());
+		fill(out_begin.begin(), out_begin.end(), 0);
+		for(const auto& o: outs)
+			out_begin[o.first + 1]++;
+		for(size_t i = 1; i < out_begin.size(); i++)
+			out_begin[i] += out_begin[i - 1];
+
+		// remove the quads whose result is not live
+		for(auto bb: bbs) {
+			if(!code(bb))
+				continue;
+			s++;
+			for(auto o = out_begin[bb->number()]; o < out_begin[bb->number() + 1]; o++)
+				stamp[outs[o].second] = s;
+			for(size_t i = last(bb); i > first(bb); i--) {
+				const Quad& q = _quads[i - 1];
+				if(removed[i - 1])
+					continue;
+				if(isPure(q) && temp[q.d] && stamp[q.d] != s) {
+					removed[i - 1] = true;
+					count++;
+					continue;
+				}
+				if(q.writes())
+					stamp[q.d] = 0;
+				if(q.readsA())
+					stamp[q.a] = s;
+				if(q.readsB())
+					stamp[q.b] = s;
+			}
+		}
+		total += count;
+	} while(count != 0 && !outs.empty());
+
+	g.reset();
+	if(total != 0)
+		rewrite(removed);
+	return total;
+}
@@ -1,45 +1,58 @@
 #include "AST.hpp"
 
 ///
-optional<value_t> ConstExpr::eval() const {
-	return _val;
-}
+optional<value_t> ExprPool::eval(index_t i) const {
+	switch(op(i)) {
 
-///
-optional<value_t> MemExpr::eval() const {
-	switch(_dec->type()) {
-	case Declaration::CST:
-		return static_cast<ConstDecl *>(_dec)->value();
-	default:
-		return {};
-	}
-}
+	case CST:
+		return value(i);
 
+	case MEM:
+		switch(declaration(i)->type()) {
+		case Declaration::CST:
+			return static_cast<ConstDecl *>(declaration(i))->value();
+		default:
+			return {};
+		}
 
-///
-optional<value_t> UnopExpr::eval() const {
-	auto a = _arg->eval();
-	if(!a)
-		return {};
-	switch(_op) {
-		case NEG: 
-			return -*a;
-		case INV: 
-			return ~*a;
-	default: 
-		return {};
+	case NEG:
+	case INV: {
+			auto a = eval(_arg1[i]);
+			if(!a)
+				return {};
+			if(op(i) == NEG)
+				return -*a;
+			else
+				return ~*a;
+		}
+
+	/// BitField takes three expressions: the expression to extract the bitfield from, the high bit, and the low bit.
+	/// It evaluates the expression, the high bit, and the low bit, and then extracts the bitfield from the expression.
+	case BITFIELD: {
+			auto e = eval(_arg1[i]);
+			if(!e)
+				return {};
+			auto h = eval(_arg2[i]);
+			if(!h)
+				return {};
+			auto l = eval(_arg3[i]);
+			if(!l)
+				return {};
+			return (*e >> *l) & ((1 << (*h - *l + 1)) - 1);
+		}
+
+	default:
+		break;
 	}
-}
 
-///
-optional<value_t> BinopExpr::eval() const {
-	auto a1 = _arg1->eval();
+	// binary operations
+	auto a1 = eval(_arg1[i]);
 	if(!a1)
 		return {};
-	auto a2 = _arg2->eval();
+	auto a2 = eval(_arg2[i]);
 	if(!a2)
 		return {};
-	switch(_op) {
+	switch(op(i)) {
 	case ADD:
 		return *a1 + *a2;
 	case SUB:
@@ -68,19 +81,3 @@ optional<value_t> BinopExpr::eval() const {
 		return {};
 	}
 }
-
-/// BitFieldExpr takes three expressions: the expression to extract the bitfield from, the high bit, and the low bit.
-/// It evaluates the expression, the high bit, and the low bit, and then extracts the bitfield from the expression.
-optional<value_t> BitFieldExpr::eval() const {
-	auto e = _expr->eval();
-	if(!e)
-		return {};
-	auto h = _hi->eval();
-	if(!h)
-		return {};
-	auto l = _lo->eval();
-	if(!l)
-		return {};
-
-	return (*e >> *l) & ((1 << (*h - *l + 1)) - 1);
-}
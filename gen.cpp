@@ -1,5 +1,6 @@
 #include "AST.hpp"
 #include "Quad.hpp"
+#include "ThreadPool.hpp"
 
 #include <assert.h>
 
@@ -9,67 +10,70 @@ const Quad::lab_t
     field_set_call = 100001;
 
 ///
-/// Génération d'une constante
-Quad::reg_t ConstExpr::gen(QuadProgram& prog) {
-    auto r = prog.newReg();
-    prog.emit(Quad::seti(r, _val));
-    return r;
-}
-
-///
-/// Génération d'un accès mémoire
-Quad::reg_t MemExpr::gen(QuadProgram& prog) {
-    switch(_dec->type()) {
+/// Génération d'une expression : parcours par indices dans le pool
+Quad::reg_t ExprPool::gen(index_t i, QuadProgram& prog) const {
+    switch(op(i)) {
 
-    case Declaration::CST: {
+    // constante
+    case CST: {
             auto r = prog.newReg();
-            prog.emit(Quad::seti(r, static_cast<ConstDecl *>(_dec)->value()));
+            prog.emit(Quad::seti(r, value(i)));
             return r;
         }
 
-    case Declaration::VAR:
-        return prog.regFor(static_cast<VarDecl *>(_dec)->name());
-
-    case Declaration::REG: {
-            auto ra = prog.newReg(); // address
-            auto rd = prog.newReg(); // data
-            prog.emit(Quad::seti(ra, static_cast<RegDecl *>(_dec)->address()));
-            prog.emit(Quad::load(rd, ra));
-            return rd;
+    // accès mémoire
+    case MEM: {
+            auto dec = declaration(i);
+            switch(dec->type()) {
+
+            case Declaration::CST: {
+                    auto r = prog.newReg();
+                    prog.emit(Quad::seti(r, static_cast<ConstDecl *>(dec)->value()));
+                    return r;
+                }
+
+            case Declaration::VAR:
+                return prog.regFor(static_cast<VarDecl *>(dec)->name());
+
+            case Declaration::REG: {
+                    auto ra = prog.newReg(); // address
+                    auto rd = prog.newReg(); // data
+                    prog.emit(Quad::seti(ra, static_cast<RegDecl *>(dec)->address()));
+                    prog.emit(Quad::load(rd, ra));
+                    return rd;
+                }
+
+            default:
+                assert(false);
+                return 0;
+            }
         }
 
-    default:
-        assert(false);
-        return 0;
-    }
-}
+    // champ de bits
+    case BITFIELD:
+        return genBitField(i, prog);
 
-///
-/// Génération d'une opération unaire
-Quad::reg_t UnopExpr::gen(QuadProgram& prog) {
-    auto ro = _arg->gen(prog);
-    auto r = prog.newReg();
-    switch(_op) {
+    // opérations unaires
     case NEG:
-        prog.emit(Quad::neg(r, ro));
-        break;
-    case INV:
-        prog.emit(Quad::inv(r, ro));
-        break;
+    case INV: {
+            auto ro = gen(_arg1[i], prog);
+            auto r = prog.newReg();
+            if(op(i) == NEG)
+                prog.emit(Quad::neg(r, ro));
+            else
+                prog.emit(Quad::inv(r, ro));
+            return r;
+        }
+
     default:
-        assert(false);
         break;
     }
-    return r;
-}
 
-///
-/// Génération d'une opération binaire
-Quad::reg_t BinopExpr::gen(QuadProgram& prog) {
-    auto r1 = _arg1->gen(prog);
-    auto r2 = _arg2->gen(prog);
+    // opérations binaires
+    auto r1 = gen(_arg1[i], prog);
+    auto r2 = gen(_arg2[i], prog);
     auto rd = prog.newReg();
-    switch(_op) {
+    switch(op(i)) {
     case ADD:
         prog.emit(Quad::add(rd, r1, r2));
         break;
@@ -115,12 +119,12 @@ Quad::reg_t BinopExpr::gen(QuadProgram& prog) {
 
 ///
 /// Génération d'une expression de champ de bits
-Quad::reg_t BitFieldExpr::gen(QuadProgram& prog) {
-    auto expr_reg = _expr->gen(prog);
+Quad::reg_t ExprPool::genBitField(index_t i, QuadProgram& prog) const {
+    auto expr_reg = gen(_arg1[i], prog);
     auto result_reg = prog.newReg();
 
-    auto hi_val_opt = _hi->eval();
-    auto lo_val_opt = _lo->eval();
+    auto hi_val_opt = eval(_arg2[i]);
+    auto lo_val_opt = eval(_arg3[i]);
 
     if (hi_val_opt && lo_val_opt) { // Both `hi` and `lo` are constants.
         int hi_val = *hi_val_opt;
@@ -158,8 +162,8 @@ Quad::reg_t BitFieldExpr::gen(QuadProgram& prog) {
             prog.emit(Quad::and_(result_reg, shifted_reg, mask_reg));
         }
     } else { // At least one of `hi` or `lo` is dynamic.
-        auto hi_reg = _hi->gen(prog);
-        auto lo_reg = _lo->gen(prog);
+        auto hi_reg = gen(_arg2[i], prog);
+        auto lo_reg = gen(_arg3[i], prog);
 
         auto diff_reg = prog.newReg();
         auto one_reg = prog.newReg();
@@ -184,8 +188,8 @@ Quad::reg_t BitFieldExpr::gen(QuadProgram& prog) {
 ///
 /// Génération d'une comparaison
 void CompCond::gen(Quad::lab_t lab_true, Quad::lab_t lab_false, QuadProgram& prog) const {
-    auto a1 = _arg1->gen(prog);
-    auto a2 = _arg2->gen(prog);
+    auto a1 = _arg1.gen(prog);
+    auto a2 = _arg2.gen(prog);
     switch(_comp) {
     case EQ: prog.emit(Quad::goto_eq(lab_true, a1, a2)); break;
     case NE: prog.emit(Quad::goto_ne(lab_true, a1, a2)); break;
@@ -231,10 +235,10 @@ void NOPStatement::gen(AutoDecl& automaton, QuadProgram& prog) const {
 }
 
 ///
-/// Génération d'une séquence d'instructions
-void SeqStatement::gen(AutoDecl& automaton, QuadProgram& prog) const {
-    _stmt1->gen(automaton, prog);
-    _stmt2->gen(automaton, prog);
+/// Génération d'un bloc d'instructions
+void BlockStatement::gen(AutoDecl& automaton, QuadProgram& prog) const {
+    for(auto s: _stmts)
+        s->gen(automaton, prog);
 }
 
 ///
@@ -258,7 +262,7 @@ void IfStatement::gen(AutoDecl& automaton, QuadProgram& prog) const {
 /// Génération d'une instruction d'affectation
 void SetStatement::gen(AutoDecl& automaton, QuadProgram& prog) const {
     prog.comment(pos);
-    auto r = _expr->gen(prog);
+    auto r = _expr.gen(prog);
     switch(_dec->type()) {
     case Declaration::VAR:
         prog.emit(Quad::set(prog.regFor(static_cast<VarDecl *>(_dec)->name()), r));
@@ -279,9 +283,9 @@ void SetStatement::gen(AutoDecl& automaton, QuadProgram& prog) const {
 /// Génération d'une affectation de champ de bits
 void SetFieldStatement::gen(AutoDecl& automaton, QuadProgram& prog) const {
     prog.comment(pos);
-    auto hi_reg = _hi->gen(prog);
-    auto lo_reg = _lo->gen(prog);
-    auto value_reg = _expr->gen(prog);
+    auto hi_reg = _hi.gen(prog);
+    auto lo_reg = _lo.gen(prog);
+    auto value_reg = _expr.gen(prog);
 
     Quad::reg_t e_reg;
     Quad::reg_t addr_reg;
@@ -298,9 +302,9 @@ void SetFieldStatement::gen(AutoDecl& automaton, QuadProgram& prog) const {
         return;
     }
 
-    auto hi_val_opt = _hi->eval();
-    auto lo_val_opt = _lo->eval();
-    auto value_val_opt = _expr->eval();
+    auto hi_val_opt = _hi.eval();
+    auto lo_val_opt = _lo.eval();
+    auto value_val_opt = _expr.eval();
 
     if (e_reg == value_reg) {
         auto temp_value_reg = prog.newReg();
@@ -313,9 +317,10 @@ void SetFieldStatement::gen(AutoDecl& automaton, QuadProgram& prog) const {
         int lo_val = *lo_val_opt;
         int value_val = *value_val_opt;
 
-        // mask
+        // mask (shifts of 32 bits or more give 0 instead of being undefined)
+        auto shl = [](uint32_t x, int n) { return n < 0 || n >= 32 ? 0u : x << n; };
         int num_bits = hi_val - lo_val + 1;
-        int mask_val = ((1 << num_bits) - 1) << lo_val;
+        int mask_val = shl(shl(1, num_bits) - 1, lo_val);
         auto mask_reg = prog.newReg();
         prog.emit(Quad::seti(mask_reg, mask_val));
 
@@ -325,8 +330,8 @@ void SetFieldStatement::gen(AutoDecl& automaton, QuadProgram& prog) const {
         prog.emit(Quad::and_(e_reg, e_reg, inv_mask_reg));
 
         // Prepare the value to set
-        int value_mask = (1 << num_bits) - 1;
-        int aligned_value = (value_val & value_mask) << lo_val;
+        int value_mask = shl(1, num_bits) - 1;
+        int aligned_value = shl(value_val & value_mask, lo_val);
         auto aligned_value_reg = prog.newReg();
         prog.emit(Quad::seti(aligned_value_reg, aligned_value));
 
@@ -428,14 +433,40 @@ void State::gen(AutoDecl& automaton, QuadProgram& prog) {
 }
 
 ///
-/// Génération de l'automate
-void AutoDecl::gen(QuadProgram& prog) {
+/// Génération de l'automate : avec un pool de threads, chaque état est
+/// généré dans sa propre partie du programme, puis les parties sont
+/// ajoutées dans l'ordre des états (même résultat qu'en séquentiel).
+void AutoDecl::gen(QuadProgram& prog, ThreadPool *pool) {
+    genPrologue(prog);
+    if(pool == nullptr)
+        for(auto state: _states)
+            state->gen(*this, prog);
+    else {
+        vector<QuadProgram> parts;
+        parts.reserve(_states.size());
+        for(size_t i = 0; i < _states.size(); i++)
+            parts.push_back(prog.fork());
+        pool->parallelFor(_states.size(), [&](size_t i) {
+            _states[i]->gen(*this, parts[i]);
+        });
+        for(auto& part: parts)
+            prog.append(part);
+    }
+    genEpilogue(prog);
+}
+
+///
+/// Génération du début de l'automate : étiquettes et initialisation
+void AutoDecl::genPrologue(QuadProgram& prog) {
     _stop_label = prog.newLab();
     for(auto state: _states)
         state->setLabel(prog.newLab());
     _init->gen(*this, prog);
-    for(auto state: _states)
-        state->gen(*this, prog);
+}
+
+///
+/// Génération de la fin de l'automate : arrêt
+void AutoDecl::genEpilogue(QuadProgram& prog) {
     prog.emit(Quad::lab(_stop_label));
     prog.emit(Quad::return_());
 }
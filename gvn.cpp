@@ -0,0 +1,779 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include "Quad.hpp"
+
+/*
+ * Global value numbering with partial redundancy elimination (GVN-PRE)
+ * of the quadruplets, performed on the CFG of each state (the prologue,
+ * each state and the epilogue are separate regions, the values are never
+ * carried from one to another).
+ *
+ * In a BB, the values are numbered as expressions over constants, labels
+ * and values of the variables at the entry of the BB: the same expression
+ * denotes the same value in all the BBs of the region (as long as the
+ * variables it uses are not written on the way). LOAD and POP give
+ * unknown values: the memory accesses are never moved or merged.
+ *
+ * An expression is available at the entry of a BB if it is computed on
+ * all the paths reaching it without writes of its variables. Its
+ * computations in the BB are then redundant: the value is taken from a
+ * carrier variable written by the other computations. If the expression
+ * is available on some predecessors only, it is first computed at the
+ * end of the others when they have no other successor and when they are
+ * not more numerous than the ones where it is available (typically, the
+ * entry of a polling loop, the value coming from its back edge). The BBs
+ * that cannot be reached from the entries of the region are left as is.
+ *
+ * The carriers are declared as variables: as the registers are allocated
+ * per BB, a carrier is stored at the end of the BBs writing it and loaded
+ * from the stack by the BBs reading it. Hence only the expressions taking
+ * at least min_cost quads to be computed are considered, and an expression
+ * is only carried if the quads its carrier saves in the BBs reading it
+ * outweigh the loads, the stores, the copies and the inserted computations
+ * it costs. The carriers are shared by the regions (the code of a state
+ * does not depend on the others, as needed by the incremental compilation).
+ */
+
+/**
+ * Minimal number of quads to compute an expression to carry it.
+ */
+static const unsigned min_cost = 3;
+
+/**
+ * Table of the expressions of a region. An expression is an operation
+ * over other expressions, a constant (SETI), a label (SETL) or the value
+ * of a variable at the entry of a BB (NOP). The expressions and their
+ * variables are stored contiguously and found by open addressing: the
+ * table is cleared for each region without releasing its memory.
+ */
+class ExprTable {
+public:
+	static constexpr uint32_t none = ~uint32_t(0);
+
+	class Expr {
+	public:
+		Quad::type_t op;
+		uint32_t a, b;
+		unsigned cost;					// quads to compute it
+		unsigned ops;					// operations among them
+		uint32_t vars, vars_end;		// used variables (sorted)
+	};
+
+	inline ExprTable(): _slots(16, none) { }
+	inline size_t size() const { return _exprs.size(); }
+	inline const Expr& operator[](uint32_t i) const { return _exprs[i]; }
+	inline Slice<Quad::reg_t> vars(uint32_t i) const
+		{ return Slice<Quad::reg_t>(_vars.data() + _exprs[i].vars, _vars.data() + _exprs[i].vars_end); }
+
+	/// Remove all the expressions.
+	void clear() {
+		if(!_exprs.empty())
+			fill(_slots.begin(), _slots.end(), none);
+		_exprs.clear();
+		_vars.clear();
+	}
+
+	/**
+	 * Get an expression, creating it if needed.
+	 * @param op	Operation.
+	 * @param a		First argument (constant, label, variable or expression).
+	 * @param b		Second argument (expression of binary operations).
+	 * @return		Expression index.
+	 */
+	uint32_t get(Quad::type_t op, uint32_t a, uint32_t b = 0) {
+		if(op == Quad::ADD || op == Quad::MUL || op == Quad::AND || op == Quad::OR || op == Quad::XOR)
+			if(b < a)
+				swap(a, b);
+
+		// look for the expression
+		size_t mask = _slots.size() - 1;
+		size_t i = hash(op, a, b) & mask;
+		for(; _slots[i] != none; i = (i + 1) & mask) {
+			const Expr& e = _exprs[_slots[i]];
+			if(e.op == op && e.a == a && e.b == b)
+				return _slots[i];
+		}
+
+		// create it
+		Expr e;
+		e.op = op;
+		e.a = a;
+		e.b = b;
+		e.vars = _vars.size();
+		switch(op) {
+		case Quad::NOP:
+			e.cost = 0;
+			e.ops = 0;
+			_vars.push_back(a);
+			break;
+		case Quad::SETI:
+		case Quad::SETL:
+			e.cost = 1;
+			e.ops = 0;
+			break;
+		case Quad::NEG:
+		case Quad::INV:
+			e.cost = 1 + _exprs[a].cost;
+			e.ops = 1 + _exprs[a].ops;
+			for(auto j = _exprs[a].vars; j < _exprs[a].vars_end; j++)
+				_vars.push_back(_vars[j]);
+			break;
+		default: {
+				e.cost = 1 + _exprs[a].cost + _exprs[b].cost;
+				e.ops = 1 + _exprs[a].ops + _exprs[b].ops;
+				auto j = _exprs[a].vars, k = _exprs[b].vars;
+				while(j < _exprs[a].vars_end || k < _exprs[b].vars_end)
+					if(k == _exprs[b].vars_end || (j < _exprs[a].vars_end && _vars[j] < _vars[k]))
+						_vars.push_back(_vars[j++]);
+					else if(j == _exprs[a].vars_end || _vars[k] < _vars[j])
+						_vars.push_back(_vars[k++]);
+					else {
+						_vars.push_back(_vars[j++]);
+						k++;
+					}
+			}
+			break;
+		}
+		e.vars_end = _vars.size();
+		_slots[i] = _exprs.size();
+		_exprs.push_back(e);
+
+		// grow the slots if needed
+		if(2 * _exprs.size() > _slots.size()) {
+			_slots.assign(2 * _slots.size(), none);
+			mask = _slots.size() - 1;
+			for(uint32_t x = 0; x < _exprs.size(); x++) {
+				size_t j = hash(_exprs[x].op, _exprs[x].a, _exprs[x].b) & mask;
+				while(_slots[j] != none)
+					j = (j + 1) & mask;
+				_slots[j] = x;
+			}
+		}
+		return _exprs.size() - 1;
+	}
+
+private:
+	static inline size_t hash(uint32_t op, uint32_t a, uint32_t b)
+		{ return (((uint64_t(op) << 56) ^ (uint64_t(a) << 28) ^ b) * 0x9e3779b97f4a7c15ULL) >> 32; }
+	vector<Expr> _exprs;
+	vector<Quad::reg_t> _vars;
+	vector<uint32_t> _slots;
+};
+
+
+/**
+ * Elimination of the redundancies of a program (see above): the quads to
+ * remove and to insert are computed from the CFG and applied afterwards
+ * with QuadProgram::rewrite(). The regions are processed one after the
+ * other, the data of a region being stored contiguously.
+ */
+class RedundancyEliminator {
+public:
+	RedundancyEliminator(QuadProgram& prog, vector<Quad>& quads, CFG<Quad>& g, const vector<Quad::lab_t>& entries);
+	size_t run();
+	vector<bool> removed;
+	vector<pair<size_t, Quad> > inserted;
+
+private:
+
+	class Occurrence {
+	public:
+		size_t quad;
+		uint32_t expr;
+	};
+
+	class Block {
+	public:
+		inline Block(): first(0), last(0), preds(0), preds_end(0), succs(0),
+			open(false), reached(false), kill_all(false), occs(0), occs_end(0), writes(0), writes_end(0) { }
+		size_t first, last;				// quads of the block
+		uint32_t preds, preds_end;		// predecessors (in _preds)
+		unsigned succs;					// number of successors
+		bool open;						// entered from outside the region
+		bool reached;					// reachable from the entries of the region
+		bool kill_all;					// all variables may be written
+		uint32_t occs, occs_end;		// computed expressions (in _occs)
+		uint32_t writes, writes_end;	// written variables (in _writes)
+	};
+
+	// sets of expressions of a block
+	typedef enum {
+		OCC,		// computed in the block
+		KILL,		// using a variable written in the block
+		INS,		// inserted at the end of the block
+		IN,			// available at the entry
+		OUT,		// available at the exit
+		SET_COUNT
+	} set_t;
+	inline uint64_t *set(size_t b, set_t s) { return &_sets[((b - _begin) * SET_COUNT + s) * _words]; }
+	static inline bool test(const uint64_t *s, uint32_t e) { return (s[e >> 6] >> (e & 63)) & 1; }
+	static inline void add(uint64_t *s, uint32_t e) { s[e >> 6] |= uint64_t(1) << (e & 63); }
+
+	void analyze(Block& b);
+	void findReached();
+	void computeAvailability();
+	bool insert();
+	unsigned freed(size_t i) const;
+	bool pays(uint32_t e);
+	size_t eliminate();
+	Quad::reg_t emit(uint32_t e, Quad::reg_t to, size_t pos);
+	void release(const Quad& q);
+	inline bool isLocal(Quad::reg_t r) const
+		{ return r >= Quad::HARD_COUNT && !_var[r] && _defs[r] == 1 && !_shared[r]; }
+
+	QuadProgram& _prog;
+	vector<Quad>& _quads;
+	vector<Block> _blocks;
+	vector<uint32_t> _preds;
+	vector<bool> _starts;				// blocks starting a region
+
+	// current region
+	size_t _begin, _end;
+	ExprTable _table;
+	vector<Occurrence> _occs;
+	vector<Quad::reg_t> _writes;
+	size_t _words;
+	vector<uint64_t> _sets;
+
+	// registers of the program
+	unsigned _reg_count;
+	vector<bool> _var, _shared;
+	vector<uint8_t> _defs;
+	vector<uint32_t> _uses;
+	vector<size_t> _def_at;
+	vector<Quad::reg_t> _rename;
+
+	// state of the analysis of a block
+	uint32_t _stamp;
+	vector<uint32_t> _reg_stamp, _reg_expr, _expr_stamp;
+
+	// carriers of the values
+	vector<Quad::reg_t> _carriers;
+	vector<Quad::reg_t> _carrier_of;
+};
+
+
+/**
+ * Build the eliminator.
+ * @param prog		Program (to allocate registers and carriers).
+ * @param quads		Quads of the program.
+ * @param g			CFG of the quads.
+ * @param entries	Labels of the entries of the regions.
+ */
+RedundancyEliminator::RedundancyEliminator(QuadProgram& prog, vector<Quad>& quads, CFG<Quad>& g, const vector<Quad::lab_t>& entries)
+:	removed(quads.size(), false),
+	_prog(prog),
+	_quads(quads),
+	_begin(0),
+	_end(0),
+	_words(0),
+	_reg_count(prog.regCount()),
+	_var(_reg_count, false),
+	_shared(_reg_count, false),
+	_defs(_reg_count, 0),
+	_uses(_reg_count, 0),
+	_def_at(_reg_count, 0),
+	_rename(_reg_count, 0),
+	_stamp(0),
+	_reg_stamp(_reg_count, 0),
+	_reg_expr(_reg_count, ExprTable::none)
+{
+	for(auto r: prog.variables())
+		_var[r] = true;
+	vector<bool> entry(prog.labCount(), false);
+	for(auto l: entries)
+		if(l < entry.size())
+			entry[l] = true;
+
+	// build the blocks
+	vector<int> index(g.basicBlocks().size(), -1);
+	_blocks.reserve(g.basicBlocks().size());
+	for(auto bb: g.basicBlocks())
+		if(bb != g.entry() && bb != g.exit()) {
+			index[bb->number()] = _blocks.size();
+			Block b;
+			b.first = bb->instructions().begin() - quads.data();
+			b.last = bb->instructions().end() - quads.data();
+			_blocks.push_back(b);
+			bool start = _blocks.size() == 1;
+			for(const auto& q: bb->instructions())
+				if(q.type != Quad::LAB)
+					break;
+				else if(entry[q.label()])
+					start = true;
+			_starts.push_back(start);
+		}
+	for(auto bb: g.basicBlocks()) {
+		if(index[bb->number()] < 0)
+			continue;
+		Block& b = _blocks[index[bb->number()]];
+		b.preds = _preds.size();
+		for(auto p: bb->predecessors())
+			if(index[p->number()] < 0)
+				b.open = true;
+			else
+				_preds.push_back(index[p->number()]);
+		b.preds_end = _preds.size();
+		if(bb->next() != nullptr)
+			b.succs++;
+		if(bb->target() != nullptr && bb->target() != bb->next())
+			b.succs++;
+	}
+
+	// count the definitions and uses of the registers
+	vector<uint32_t> block(_reg_count, ~uint32_t(0));
+	for(size_t i = 0; i < _blocks.size(); i++) {
+		auto note = [&](Quad::reg_t r) {
+			if(block[r] == ~uint32_t(0))
+				block[r] = i;
+			else if(block[r] != i)
+				_shared[r] = true;
+		};
+		for(size_t j = _blocks[i].first; j < _blocks[i].last; j++) {
+			const Quad& q = quads[j];
+			if(q.readsA()) {
+				note(q.a);
+				_uses[q.a]++;
+			}
+			if(q.readsB()) {
+				note(q.b);
+				_uses[q.b]++;
+			}
+			if(q.writes()) {
+				note(q.d);
+				if(_defs[q.d] < 2)
+					_defs[q.d]++;
+				_def_at[q.d] = j;
+			}
+		}
+	}
+}
+
+
+/**
+ * Number the values of a block, recording the computed expressions and
+ * the written variables.
+ * @param b	Block to analyze.
+ */
+void RedundancyEliminator::analyze(Block& b) {
+	_stamp++;
+	bool called = false;
+	auto value = [&](Quad::reg_t r) {
+		if(_reg_stamp[r] == _stamp)
+			return _reg_expr[r];
+		else if(_var[r] && !called)
+			return _table.get(Quad::NOP, r);
+		else
+			return ExprTable::none;
+	};
+
+	b.occs = _occs.size();
+	b.writes = _writes.size();
+	for(size_t i = b.first; i < b.last; i++) {
+		const Quad& q = _quads[i];
+
+		// a call may write all the variables
+		if(q.type == Quad::CALL) {
+			b.kill_all = true;
+			called = true;
+			_stamp++;
+			continue;
+		}
+		if(!q.writes())
+			continue;
+
+		// find the expression of the result
+		uint32_t e = ExprTable::none;
+		if(q.type == Quad::SETI || q.type == Quad::SETL)
+			e = _table.get(q.type, q.a);
+		else if(q.type == Quad::SET)
+			e = value(q.a);
+		else if(q.type == Quad::NEG || q.type == Quad::INV) {
+			uint32_t x = value(q.a);
+			if(x != ExprTable::none)
+				e = _table.get(q.type, x);
+		}
+		else if(q.type >= Quad::ADD && q.type <= Quad::ROR) {
+			uint32_t x = value(q.a), y = value(q.b);
+			if(x != ExprTable::none && y != ExprTable::none)
+				e = _table.get(q.type, x, y);
+		}
+		if(e != ExprTable::none && q.type >= Quad::NEG && q.type <= Quad::ROR)
+			_occs.push_back({ i, e });
+
+		// record the write
+		if(_var[q.d])
+			_writes.push_back(q.d);
+		_reg_stamp[q.d] = _stamp;
+		_reg_expr[q.d] = e;
+	}
+	b.occs_end = _occs.size();
+	b.writes_end = _writes.size();
+}
+
+
+/**
+ * Find the blocks of the region reachable from its entries.
+ */
+void RedundancyEliminator::findReached() {
+	for(size_t i = _begin; i < _end; i++)
+		_blocks[i].reached = i == _begin || _blocks[i].open;
+	for(bool changed = true; changed;) {
+		changed = false;
+		for(size_t i = _begin; i < _end; i++) {
+			Block& b = _blocks[i];
+			for(auto p = b.preds; !b.reached && p < b.preds_end; p++)
+				if(_blocks[_preds[p]].reached) {
+					b.reached = true;
+					changed = true;
+				}
+		}
+	}
+}
+
+
+/**
+ * Compute the expressions available at the entry and at the exit of the
+ * blocks of the region. Nothing is available in the unreachable blocks.
+ */
+void RedundancyEliminator::computeAvailability() {
+	for(size_t i = _begin; i < _end; i++) {
+		fill(set(i, IN), set(i, IN) + _words, 0);
+		fill(set(i, OUT), set(i, OUT) + _words, _blocks[i].reached ? ~uint64_t(0) : 0);
+	}
+	for(bool changed = true; changed;) {
+		changed = false;
+		for(size_t i = _begin; i < _end; i++) {
+			const Block& b = _blocks[i];
+			if(!b.reached)
+				continue;
+			auto in = set(i, IN), out = set(i, OUT);
+			if(i != _begin && !b.open && b.preds != b.preds_end) {
+				copy(set(_preds[b.preds], OUT), set(_preds[b.preds], OUT) + _words, in);
+				for(auto p = b.preds + 1; p < b.preds_end; p++) {
+					auto pout = set(_preds[p], OUT);
+					for(size_t w = 0; w < _words; w++)
+						in[w] &= pout[w];
+				}
+			}
+			auto occ = set(i, OCC), kill = set(i, KILL), ins = set(i, INS);
+			for(size_t w = 0; w < _words; w++) {
+				uint64_t x = ((in[w] | occ[w]) & ~kill[w]) | ins[w];
+				if(x != out[w]) {
+					out[w] = x;
+					changed = true;
+				}
+			}
+		}
+	}
+}
+
+
+/**
+ * Insert the computations of the partially available expressions at the
+ * end of the predecessors where they are missing (see above).
+ * @return	True if some computations have been inserted.
+ */
+bool RedundancyEliminator::insert() {
+	bool done = false;
+	for(size_t i = _begin; i < _end; i++) {
+		const Block& b = _blocks[i];
+		if(i == _begin || b.open || !b.reached)
+			continue;
+		for(auto o = b.occs; o < b.occs_end; o++) {
+			auto e = _occs[o].expr;
+			if(_table[e].cost < min_cost || test(set(i, IN), e))
+				continue;
+			size_t avail = 0;
+			bool ok = true;
+			for(auto p = b.preds; p < b.preds_end; p++)
+				if(test(set(_preds[p], OUT), e))
+					avail++;
+				else if(_blocks[_preds[p]].succs != 1 || !_blocks[_preds[p]].reached)
+					ok = false;
+			if(!ok || avail == 0 || b.preds_end - b.preds - avail > avail)
+				continue;
+			for(auto p = b.preds; p < b.preds_end; p++)
+				if(!test(set(_preds[p], OUT), e)) {
+					add(set(_preds[p], INS), e);
+					add(set(_preds[p], OUT), e);
+				}
+			done = true;
+		}
+	}
+	return done;
+}
+
+
+/**
+ * Generate the computation of an expression.
+ * @param e		Expression to compute.
+ * @param to	Register to compute in (0 for a new register).
+ * @param pos	Quad to insert the computation before.
+ * @return		Register containing the value.
+ */
+Quad::reg_t RedundancyEliminator::emit(uint32_t e, Quad::reg_t to, size_t pos) {
+	const auto& x = _table[e];
+	if(x.op == Quad::NOP && to == 0)
+		return x.a;
+	if(to == 0)
+		to = _prog.newReg();
+	switch(x.op) {
+	case Quad::NOP:
+		inserted.push_back(make_pair(pos, Quad::set(to, x.a)));
+		break;
+	case Quad::SETI:
+	case Quad::SETL:
+		inserted.push_back(make_pair(pos, Quad(x.op, to, x.a)));
+		break;
+	case Quad::NEG:
+	case Quad::INV:
+		inserted.push_back(make_pair(pos, Quad(x.op, to, emit(x.a, 0, pos))));
+		break;
+	default: {
+			auto a = emit(x.a, 0, pos);
+			auto b = emit(x.b, 0, pos);
+			inserted.push_back(make_pair(pos, Quad(x.op, to, a, b)));
+		}
+		break;
+	}
+	return to;
+}
+
+
+/**
+ * Release the registers read by a removed quad, removing in turn the
+ * computations of the local registers that are no more used.
+ * @param q	Removed quad.
+ */
+void RedundancyEliminator::release(const Quad& q) {
+	for(auto r: { q.readsA() ? q.a : 0, q.readsB() ? q.b : 0 }) {
+		if(r == 0 || r >= _reg_count || --_uses[r] != 0 || !isLocal(r) || _rename[r] != 0)
+			continue;
+		auto i = _def_at[r];
+		const Quad& d = _quads[i];
+		if(!removed[i] && d.type >= Quad::SETI && d.type <= Quad::ROR) {
+			removed[i] = true;
+			release(d);
+		}
+	}
+}
+
+
+/**
+ * Count the operations removed with a computation replaced by a carrier:
+ * the computation and those of its operands that release() would remove.
+ * The constants and labels are not counted as they are mostly folded in
+ * the instructions.
+ * @param i	Quad of the computation.
+ * @return	Number of removed operations.
+ */
+unsigned RedundancyEliminator::freed(size_t i) const {
+	const Quad& q = _quads[i];
+	unsigned n = q.type == Quad::SETI || q.type == Quad::SETL ? 0 : 1;
+	for(auto r: { q.readsA() ? q.a : 0, q.readsB() ? q.b : 0 }) {
+		if(r == 0 || r >= _reg_count || _uses[r] != 1 || !isLocal(r))
+			continue;
+		const Quad& d = _quads[_def_at[r]];
+		if(!removed[_def_at[r]] && d.type >= Quad::SETI && d.type <= Quad::ROR)
+			n += freed(_def_at[r]);
+	}
+	return n;
+}
+
+
+/**
+ * Test if carrying an expression pays, by counting in instructions what it
+ * saves and costs in the reached blocks of the region (as eliminate() does
+ * it):
+ * @li a block reading the carrier at its entry loads it but no longer
+ * computes the expression,
+ * @li a block computing the expression first stores the carrier,
+ * @li the other computations in the block reuse the value of the carrier,
+ * @li a block where the expression is inserted computes and stores it,
+ * @li a computation whose result is not a local register needs a copy.
+ * @param e		Expression to test.
+ * @return		True if carrying it saves instructions.
+ */
+bool RedundancyEliminator::pays(uint32_t e) {
+	int cost = _table[e].ops, gain = 0;
+	for(size_t i = _begin; i < _end; i++) {
+		const Block& b = _blocks[i];
+		if(!b.reached)
+			continue;
+		bool carried = test(set(i, IN), e), first = true;
+		for(auto o = b.occs; o < b.occs_end; o++) {
+			if(_occs[o].expr != e)
+				continue;
+			if(!isLocal(_quads[_occs[o].quad].d))
+				gain--;
+			if(carried)
+				gain += freed(_occs[o].quad) - (first ? 1 : 0);
+			else
+				gain--;
+			carried = true;
+			first = false;
+		}
+		if(test(set(i, INS), e))
+			gain -= cost + 1;
+	}
+	return gain > 0;
+}
+
+
+/**
+ * Replace the redundant computations of the region by their carriers.
+ * @return	Number of replaced computations.
+ */
+size_t RedundancyEliminator::eliminate() {
+
+	// select the expressions to carry (redundant at the entry of a block)
+	vector<uint32_t> selected, tested;
+	for(size_t i = _begin; i < _end; i++)
+		for(auto o = _blocks[i].occs; o < _blocks[i].occs_end; o++) {
+			auto e = _occs[o].expr;
+			if(_table[e].cost >= min_cost && _blocks[i].reached && test(set(i, IN), e) && _carrier_of[e] == 0) {
+				_carrier_of[e] = 1;
+				tested.push_back(e);
+				if(pays(e))
+					selected.push_back(e);
+			}
+		}
+	for(auto e: tested)
+		_carrier_of[e] = 0;
+	if(selected.empty())
+		return 0;
+	sort(selected.begin(), selected.end());
+	for(size_t k = 0; k < selected.size(); k++) {
+		if(k == _carriers.size())
+			_carriers.push_back(_prog.declare("$t" + to_string(k)));
+		_carrier_of[selected[k]] = _carriers[k];
+	}
+
+	// rewrite the computations
+	size_t count = 0;
+	for(size_t i = _begin; i < _end; i++) {
+		const Block& b = _blocks[i];
+		if(!b.reached)
+			continue;
+		_stamp++;
+		for(auto o = b.occs; o < b.occs_end; o++) {
+			auto e = _occs[o].expr;
+			auto t = _carrier_of[e];
+			if(t == 0)
+				continue;
+			Quad& q = _quads[_occs[o].quad];
+			if(test(set(i, IN), e) || _expr_stamp[e] == _stamp) {
+				Quad r = q;
+				if(isLocal(q.d)) {
+					_rename[q.d] = t;
+					removed[_occs[o].quad] = true;
+				}
+				else
+					q = Quad::set(q.d, t);
+				release(r);
+				count++;
+			}
+			else {
+				_expr_stamp[e] = _stamp;
+				if(isLocal(q.d)) {
+					_rename[q.d] = t;
+					q.d = t;
+				}
+				else
+					inserted.push_back(make_pair(_occs[o].quad + 1, Quad::set(t, q.d)));
+			}
+		}
+
+		// compute the inserted expressions at the end
+		size_t pos = _quads[b.last - 1].endsBlock() ? b.last - 1 : b.last;
+		for(auto e: selected)
+			if(test(set(i, INS), e))
+				emit(e, _carrier_of[e], pos);
+	}
+
+	for(auto e: selected)
+		_carrier_of[e] = 0;
+	return count;
+}
+
+
+/**
+ * Perform the elimination on all the regions.
+ * @return	Number of replaced computations.
+ */
+size_t RedundancyEliminator::run() {
+	size_t count = 0;
+	vector<pair<Quad::reg_t, uint32_t> > uses;
+	for(_begin = 0; _begin < _blocks.size(); _begin = _end) {
+		_end = _begin + 1;
+		while(_end < _blocks.size() && !_starts[_end])
+			_end++;
+
+		// number the values of the region
+		_table.clear();
+		_occs.clear();
+		_writes.clear();
+		for(size_t i = _begin; i < _end; i++)
+			analyze(_blocks[i]);
+		if(_occs.empty())
+			continue;
+
+		// build the sets of the blocks
+		_words = (_table.size() + 63) / 64;
+		_sets.assign((_end - _begin) * SET_COUNT * _words, 0);
+		uses.clear();
+		for(uint32_t e = 0; e < _table.size(); e++)
+			for(auto v: _table.vars(e))
+				uses.push_back(make_pair(v, e));
+		sort(uses.begin(), uses.end());
+		for(size_t i = _begin; i < _end; i++) {
+			const Block& b = _blocks[i];
+			if(b.kill_all)
+				fill(set(i, KILL), set(i, KILL) + _words, ~uint64_t(0));
+			for(auto o = b.occs; o < b.occs_end; o++)
+				add(set(i, OCC), _occs[o].expr);
+			for(auto w = b.writes; w < b.writes_end; w++)
+				for(auto u = lower_bound(uses.begin(), uses.end(), make_pair(_writes[w], uint32_t(0)));
+				u != uses.end() && u->first == _writes[w]; ++u)
+					add(set(i, KILL), u->second);
+		}
+
+		// place and eliminate the computations
+		findReached();
+		computeAvailability();
+		while(insert())
+			computeAvailability();
+		_carrier_of.assign(_table.size(), 0);
+		_expr_stamp.assign(_table.size(), 0);
+		count += eliminate();
+	}
+
+	// rename the uses of the replaced registers
+	for(auto& q: _quads) {
+		if(q.readsA() && q.a < _reg_count && _rename[q.a] != 0)
+			q.a = _rename[q.a];
+		if(q.readsB() && q.b < _reg_count && _rename[q.b] != 0)
+			q.b = _rename[q.b];
+	}
+	return count;
+}
+
+
+/**
+ * Perform global value numbering with partial redundancy elimination on
+ * the program (see above).
+ * @param entries	Labels of the entries of the regions (states and
+ * 					epilogue): no value is carried across them.
+ * @return			Number of removed computations.
+ */
+size_t QuadProgram::eliminateRedundancies(const vector<Quad::lab_t>& entries) {
+	unique_ptr<CFG<Quad> > g(makeCFG());
+	RedundancyEliminator elim(*this, _quads, *g, entries);
+	size_t count = elim.run();
+	g.reset();
+	if(count != 0)
+		rewrite(elim.removed, move(elim.inserted));
+	return count;
+}
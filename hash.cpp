@@ -0,0 +1,170 @@
+#include "AST.hpp"
+#include "Hash.hpp"
+
+/*
+ * Structural hashing of the AST: two ASTs with the same hash generate
+ * the same quadruplets, up to the numbering of the registers and of the
+ * labels they allocate. The hash covers the values the generation takes
+ * from outside the AST: values of constants, addresses of registers,
+ * virtual registers of variables and labels of the states.
+ */
+
+/**
+ * Hash a declaration used by a statement or an expression.
+ * @param dec	Declaration to hash.
+ * @param prog	Program giving the registers of the variables.
+ * @param h		Hash to update.
+ */
+static void hashDecl(Declaration *dec, QuadProgram& prog, Hash& h) {
+	h.add(uint64_t(dec->type()));
+	switch(dec->type()) {
+	case Declaration::CST:
+		h.add(uint64_t(static_cast<ConstDecl *>(dec)->value()));
+		break;
+	case Declaration::VAR:
+		h.add(prog.regFor(dec->name()));
+		break;
+	case Declaration::REG:
+		h.add(static_cast<RegDecl *>(dec)->address());
+		break;
+	case Declaration::SIG:
+		h.add(static_cast<SigDecl *>(dec)->reg()->address());
+		h.add(uint64_t(static_cast<SigDecl *>(dec)->bit()));
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Hash an expression of the pool.
+ * @param i		Expression index.
+ * @param prog	Program giving the registers of the variables.
+ * @param h		Hash to update.
+ */
+void ExprPool::hash(index_t i, QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(op(i)));
+	switch(op(i)) {
+	case CST:
+		h.add(value(i));
+		break;
+	case MEM:
+		hashDecl(declaration(i), prog, h);
+		break;
+	case BITFIELD:
+		hash(_arg1[i], prog, h);
+		hash(_arg2[i], prog, h);
+		hash(_arg3[i], prog, h);
+		break;
+	case NEG:
+	case INV:
+		hash(_arg1[i], prog, h);
+		break;
+	default:
+		hash(_arg1[i], prog, h);
+		hash(_arg2[i], prog, h);
+		break;
+	}
+}
+
+///
+void Expression::hash(QuadProgram& prog, Hash& h) const {
+	if(_pool == nullptr)
+		h.add(~uint64_t(0));
+	else
+		_pool->hash(_index, prog, h);
+}
+
+///
+void NOPStatement::hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(type()));
+}
+
+///
+void BlockStatement::hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(type()));
+	h.add(uint64_t(_stmts.size()));
+	for(auto s: _stmts)
+		s->hash(automaton, prog, h);
+}
+
+///
+void SetStatement::hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(type()));
+	hashDecl(_dec, prog, h);
+	_expr.hash(prog, h);
+}
+
+///
+void SetFieldStatement::hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(type()));
+	hashDecl(_dec, prog, h);
+	_hi.hash(prog, h);
+	_lo.hash(prog, h);
+	_expr.hash(prog, h);
+}
+
+///
+void IfStatement::hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(type()));
+	_cond->hash(prog, h);
+	_stmt1->hash(automaton, prog, h);
+	h.add(uint64_t(_stmt2 != nullptr));
+	if(_stmt2 != nullptr)
+		_stmt2->hash(automaton, prog, h);
+}
+
+///
+void GotoStatement::hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(type()));
+	h.add(_state->label());
+}
+
+///
+void StopStatement::hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(type()));
+	h.add(automaton.stopLabel());
+}
+
+///
+void CompCond::hash(QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(type()));
+	h.add(uint64_t(_comp));
+	_arg1.hash(prog, h);
+	_arg2.hash(prog, h);
+}
+
+///
+void NotCond::hash(QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(type()));
+	_cond->hash(prog, h);
+}
+
+///
+void BinCond::hash(QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(type()));
+	_cond1->hash(prog, h);
+	_cond2->hash(prog, h);
+}
+
+///
+void When::hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const {
+	h.add(uint64_t(_neg));
+	hashDecl(_sig, prog, h);
+	_action->hash(automaton, prog, h);
+}
+
+/**
+ * Hash a state, including its own label (the labels of the states must
+ * be assigned).
+ * @param automaton	Automaton of the state.
+ * @param prog		Program giving the registers of the variables.
+ * @param h			Hash to update.
+ */
+void State::hash(AutoDecl& automaton, QuadProgram& prog, Hash& h) const {
+	h.add(_label);
+	_action->hash(automaton, prog, h);
+	h.add(uint64_t(_whens.size()));
+	for(auto w: _whens)
+		w->hash(automaton, prog, h);
+}
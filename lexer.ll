@@ -1,17 +1,20 @@
+%option reentrant bison-bridge
+%option noyywrap nounput noinput
+%option extra-type="CompilationUnit *"
+
 %{
 	#include "AST.hpp"
+	#include "CompilationUnit.hpp"
 	#include "parser.hpp"
 	#include <string.h>
 	#include <stdlib.h>
-	void yyerror(const char *);
-	const char *lexer_file = "<stdin>";
-	int lexer_line = 1;
 %}
 
 id	[a-zA-Z_][a-zA-Z_0-9]*
 dec	[0-9]+
 hex	"0x"[0-9a-fA-F]+
 bin	"0b"[01]+
+str	\"[^"\n]*\"
 syms [=@\[\]!:=<>()&|^+%/~\-\*]
 
 %x ecom
@@ -20,7 +23,7 @@ syms [=@\[\]!:=<>()&|^+%/~\-\*]
 %%
 
 [ \t]	{ }
-\n		{ lexer_line++; }
+\n		{ yyextra->newLine(); }
 
 {syms}	{ return *yytext; }
 ".."	{ return DOTDOT; }
@@ -35,9 +38,10 @@ syms [=@\[\]!:=<>()&|^+%/~\-\*]
 "//"	{ BEGIN(ecom); }
 "/*"	{ BEGIN(ccom); }
 
-{dec}	{ yylval.INT = strtol(yytext, NULL, 10); return INT; }
-{hex}	{ yylval.INT = strtol(yytext+2, NULL, 16); return INT; }
-{bin}	{ yylval.INT = strtol(yytext+2, NULL, 2); return INT; }
+{dec}	{ yylval->INT = strtol(yytext, NULL, 10); return INT; }
+{hex}	{ yylval->INT = strtol(yytext+2, NULL, 16); return INT; }
+{bin}	{ yylval->INT = strtol(yytext+2, NULL, 2); return INT; }
+{str}	{ yylval->STRING = yyextra->intern(yytext+1, yyleng-2); return STRING; }
 
 "and"	{ return AND; }
 "auto"	{ return AUTO; }
@@ -46,6 +50,7 @@ syms [=@\[\]!:=<>()&|^+%/~\-\*]
 "endif"	{ return ENDIF; }
 "goto"	{ return GOTO; }
 "if"	{ return IF; }
+"import"	{ return IMPORT; }
 "not"	{ return NOT; }
 "or"	{ return OR; }
 "reg"	{ return REG; }
@@ -55,18 +60,15 @@ syms [=@\[\]!:=<>()&|^+%/~\-\*]
 "then"	{ return THEN; }
 "var"	{ return VAR; }
 "when"	{ return WHEN; }
-{id}	{ yylval.ID = strdup(yytext); return ID; }
+{id}	{ yylval->ID = yyextra->intern(yytext, yyleng); return ID; }
 
-.		{ yyerror("bad character"); }
+.		{ throw ParseException(yyextra->position(), "bad character"); }
 
-<ecom>\n	{ lexer_line++; BEGIN(INITIAL); }
+<ecom>\n	{ yyextra->newLine(); BEGIN(INITIAL); }
 <ecom>.		{ }
 
 <ccom>"*/"	{ BEGIN(INITIAL); }
-<ccom>\n	{ lexer_line++; }
+<ccom>\n	{ yyextra->newLine(); }
 <ccom>.		{ }
 
 %%
-
-
-int yywrap(void) {return 1;}
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include "Quad.hpp"
+
+/*
+ * Local value numbering of the quadruplets: in each block (the quads
+ * between two labels or jumps, never larger than a BB of the CFG), the
+ * registers are given value numbers such that two registers with the
+ * same number hold the same value. A SETI, a SETL or a pure operation
+ * computing a value already held by a register is removed and the later
+ * uses of its result are renamed to this register.
+ *
+ * A quad is only removed if its result is a virtual register written
+ * once and used in the same block: the variables and the hardware
+ * registers live through the blocks and keep all their writes. LOAD and
+ * POP always give a new value (the memory is made of hardware
+ * registers) and the other quads are kept as is.
+ *
+ * A SETI read only by the operation following it is also kept and its
+ * register only replaces the later unused ones: the instruction selection
+ * folds it as an immediate of the operation, while a register shared
+ * with other uses of the constant would be kept over the block and
+ * increase the spills.
+ */
+
+/**
+ * Table of the values computed in a block, from (operation, operands)
+ * to value number. The table is reset in constant time by changing its
+ * stamp.
+ */
+class ValueTable {
+public:
+
+	/**
+	 * Build a table.
+	 * @param size	Maximal number of values to record in a block.
+	 */
+	ValueTable(size_t size): _mask(1), _stamp(1) {
+		while(_mask < 2 * size)
+			_mask <<= 1;
+		_entries.resize(_mask);
+		_mask--;
+	}
+
+	/// Forget all the values.
+	inline void reset() { _stamp++; }
+
+	/**
+	 * Find the value of an operation, recording it if it is new.
+	 * @param op	Operation.
+	 * @param a		First operand.
+	 * @param b		Second operand.
+	 * @param vn	Value number to record if the operation is new.
+	 * @return		Value number of the operation.
+	 */
+	uint32_t find(uint32_t op, uint32_t a, uint32_t b, uint32_t vn) {
+		uint64_t h = (uint64_t(op) << 56) ^ (uint64_t(a) << 28) ^ b;
+		h *= 0x9e3779b97f4a7c15ULL;
+		for(size_t i = h >> 40; ; i++) {
+			Entry& e = _entries[i & _mask];
+			if(e.stamp != _stamp) {
+				e.stamp = _stamp;
+				e.op = op;
+				e.a = a;
+				e.b = b;
+				e.vn = vn;
+				return vn;
+			}
+			if(e.op == op && e.a == a && e.b == b)
+				return e.vn;
+		}
+	}
+
+private:
+	class Entry {
+	public:
+		inline Entry(): stamp(0), op(0), a(0), b(0), vn(0) { }
+		uint32_t stamp, op, a, b, vn;
+	};
+	vector<Entry> _entries;
+	size_t _mask;
+	uint32_t _stamp;
+};
+
+
+/**
+ * Test if the constant of a SETI is folded by the instruction selection
+ * in the operation following it, provided it has no other use.
+ * @param s		SETI quad.
+ * @param q		Following quad.
+ * @return		True if the constant is folded.
+ */
+static bool isFolded(const Quad& s, const Quad& q) {
+	auto imm = [](uint32_t x) {
+		for(int i = 0; i < 16 && x != 0 && (x & 0b11) == 0; i++, x >>= 2);
+		return (x & 0xffffff00) == 0;
+	};
+	switch(q.type) {
+	case Quad::ADD:
+		return (q.a == s.d || q.b == s.d) && imm(s.a);
+	case Quad::SUB:
+	case Quad::AND:
+	case Quad::OR:
+	case Quad::XOR:
+	case Quad::SHL:
+	case Quad::SHR:
+	case Quad::ROL:
+	case Quad::ROR:
+		return q.b == s.d && q.a != s.d && imm(s.a);
+	case Quad::MUL:
+	case Quad::DIV:
+		return q.b == s.d && q.a != s.d && s.a != 0 && (s.a & (s.a - 1)) == 0;
+	default:
+		return false;
+	}
+}
+
+
+/**
+ * Test if a quad starts a new block for the value numbering.
+ * @param q	Quad to test.
+ * @return	True if the numbering is reset before q.
+ */
+static inline bool startsBlock(const Quad& q) {
+	return q.type == Quad::LAB || q.type == Quad::CALL;
+}
+
+
+/**
+ * Perform local value numbering on the program (see above).
+ * @return	Number of removed quads.
+ */
+size_t QuadProgram::numberValues() {
+	const uint32_t many = 2;
+
+	// count the writes and the uses and find the registers used in several blocks
+	vector<uint8_t> defs(_vreg, 0), uses(_vreg, 0);
+	vector<uint32_t> block(_vreg, 0);
+	vector<bool> shared(_vreg, false);
+	for(Quad::reg_t r = 0; r < Quad::HARD_COUNT && r < _vreg; r++)
+		defs[r] = many;
+	for(auto r: _vars)
+		defs[r] = many;
+	uint32_t b = 1;
+	size_t size = 0, max_size = 0;
+	auto use = [&](Quad::reg_t r) {
+		if(uses[r] < many)
+			uses[r]++;
+		if(block[r] == 0)
+			block[r] = b;
+		else if(block[r] != b)
+			shared[r] = true;
+	};
+	for(const auto& q: _quads) {
+		if(startsBlock(q)) {
+			b++;
+			size = 0;
+		}
+		if(q.readsA())
+			use(q.a);
+		if(q.readsB())
+			use(q.b);
+		if(q.writes()) {
+			if(block[q.d] == 0)
+				block[q.d] = b;
+			else if(block[q.d] != b)
+				shared[q.d] = true;
+			if(defs[q.d] < many)
+				defs[q.d]++;
+		}
+		max_size = max(max_size, ++size);
+		if(q.endsBlock()) {
+			b++;
+			size = 0;
+		}
+	}
+
+	// number the values block by block
+	vector<uint32_t> val(_vreg, 0), stamp(_vreg, 0);
+	vector<Quad::reg_t> rename(_vreg, 0), holder;
+	vector<bool> removed(_quads.size(), false), folded(_vreg, false);
+	ValueTable table(max_size);
+	uint32_t vn = 0;
+	b = 1;
+	auto value = [&](Quad::reg_t r) {
+		if(stamp[r] != b) {
+			stamp[r] = b;
+			val[r] = vn++;
+			holder.push_back(0);
+		}
+		return val[r];
+	};
+	auto fresh = [&]() {
+		holder.push_back(0);
+		return vn++;
+	};
+	size_t count = 0;
+	for(size_t i = 0; i < _quads.size(); i++) {
+		Quad& q = _quads[i];
+		if(startsBlock(q)) {
+			b++;
+			table.reset();
+		}
+
+		// rename the used registers
+		if(q.readsA() && rename[q.a] != 0)
+			q.a = rename[q.a];
+		if(q.readsB() && rename[q.b] != 0)
+			q.b = rename[q.b];
+
+		// find the value of the result
+		if(q.writes()) {
+			uint32_t v, x = 0, y = 0;
+			if(q.readsA())
+				x = value(q.a);
+			if(q.readsB())
+				y = value(q.b);
+			switch(q.type) {
+			case Quad::SETI:
+			case Quad::SETL:
+				v = table.find(q.type, q.a, 0, vn);
+				break;
+			case Quad::SET:
+				v = x;
+				break;
+			case Quad::NEG:
+			case Quad::INV:
+				v = table.find(q.type, x, 0, vn);
+				break;
+			case Quad::ADD:
+			case Quad::MUL:
+			case Quad::AND:
+			case Quad::OR:
+			case Quad::XOR:
+				v = table.find(q.type, min(x, y), max(x, y), vn);
+				break;
+			case Quad::SUB:
+			case Quad::DIV:
+			case Quad::MOD:
+			case Quad::SHL:
+			case Quad::SHR:
+			case Quad::ROL:
+			case Quad::ROR:
+				v = table.find(q.type, x, y, vn);
+				break;
+			default:
+				v = vn;
+				break;
+			}
+			if(v == vn)
+				fresh();
+
+			// remove the quad if the value is already held
+			Quad::reg_t h = holder[v];
+			bool local = defs[q.d] == 1 && !shared[q.d];
+			folded[q.d] = local && q.type == Quad::SETI && uses[q.d] == 1
+				&& i + 1 < _quads.size() && isFolded(q, _quads[i + 1]);
+			bool held = h != 0 && stamp[h] == b && val[h] == v;
+			if(local && held && !folded[q.d] && (!folded[h] || uses[q.d] == 0)) {
+				rename[q.d] = h;
+				removed[i] = true;
+				count++;
+			}
+			else {
+				stamp[q.d] = b;
+				val[q.d] = v;
+				if(defs[q.d] == 1 && (!held || (folded[h] && !folded[q.d])))
+					holder[v] = q.d;
+			}
+		}
+
+		if(q.endsBlock()) {
+			b++;
+			table.reset();
+		}
+	}
+
+	if(count != 0)
+		rewrite(removed);
+	return count;
+}
@@ -1,302 +1,367 @@
-#include <set>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
 #include <vector>
-#include "AST.hpp"
-#include "parser.hpp"
-#include "Inst.hpp"
-#include "RegAlloc.hpp"
-
-// Only for compatibility with Flex
 #include <stdio.h>
-#include <map>
-extern FILE *yyin;
-extern const char *lexer_file;
+#include <string.h>
+#include <unistd.h>
+#include "Cache.hpp"
+#include "Compiler.hpp"
+#include "Server.hpp"
+#include "ThreadPool.hpp"
 
 /**
- * Generate the CFG of machine instructions from the CFG of quads.
- * @param g		CFG of quads.
- * @return		CFG of instructions.
+ * Build the path of the assembly file of a source.
+ * @param source	Source path.
+ * @return			Assembly path.
  */
-CFG<Inst> *selectInstructions(CFG<Quad> *g) {
-	CFG<Inst> *r = new CFG<Inst>();
-
-	// build BBs
-	map<BB<Quad> *, BB<Inst> *> map;
-	for(auto bb: g->basicBlocks())
-		if(bb == g->entry())
-			map[g->entry()] = r->entry();
-		else if(bb == g->exit())
-			map[g->exit()] = r->exit();
-		else {
-			auto rbb = new BB<Inst>();
-			r->add(rbb);
-			map[bb] = rbb;
-			rbb->setInstructions(select(bb->instructions()));
-		}
-
-	// build edges
-	for(auto bb: g->basicBlocks()) {
-		auto rbb = map[bb];
-		if(bb->next() != nullptr)
-			rbb->setNext(map[bb->next()]);
-		if(bb->target() != nullptr)
-			rbb->setTarget(map[bb->target()]);
-	}
-
-	return r;
+string assemblyPath(const string& source) {
+	auto dot = source.rfind('.');
+	auto slash = source.rfind('/');
+	if(dot == string::npos || (slash != string::npos && dot < slash))
+		return source + ".s";
+	else
+		return source.substr(0, dot) + ".s";
 }
 
 
 /**
- * Allocate the registers in the CFG of registers.
- * @param g		CFG of registers.
- * @param prog	Current program.
+ * Compile several sources on a pool of threads. Each source is compiled
+ * in its own compilation unit and its assembly is written in a file named
+ * after the source with the ".s" extension. Prints and diagnostics are
+ * output in the order of the sources.
+ * @param sources	Sources to compile.
+ * @param options	Compilation options.
+ * @param jobs		Number of threads (0 for hardware concurrency).
+ * @param out		Stream to output the prints to.
+ * @param err		Stream to output the diagnostics to.
+ * @return			0 for success, the highest error code else.
  */
-void allocRegisters(CFG<Inst>& g, QuadProgram& prog) {
+int compileBatch(const vector<string>& sources, const Options& options, unsigned jobs, ostream& out, ostream& err) {
+	vector<ostringstream> outs(sources.size()), errs(sources.size());
+	vector<int> codes(sources.size(), 0);
 
-	// prepare mapper
-	StackMapper map;
-	for(auto d: Declaration::symbols())
-		if(d.second->type() == Declaration::VAR)
-			map.add(prog.regFor(static_cast<VarDecl *>(d.second)->name()));
+	// compile in parallel
+	ThreadPool pool(jobs);
+	pool.parallelFor(sources.size(), [&](size_t i) {
+		ofstream asm_out;
+		string path = assemblyPath(sources[i]);
+		if(options.assembly) {
+			asm_out.open(path);
+			if(!asm_out) {
+				errs[i] << "ERROR: cannot create '" << path << "'" << endl;
+				codes[i] = 2;
+				return;
+			}
+		}
+		codes[i] = compile(sources[i], options, outs[i], asm_out, errs[i]);
+		if(options.assembly && codes[i] != 0) {
+			asm_out.close();
+			remove(path.c_str());
+		}
+	});
 
-	// allocate the registers
-	for(auto v: g.basicBlocks()) {
-		list<Inst> nlist;
-		RegAlloc alloc(map, nlist);
-		for(auto i: v->instructions())
-			alloc.process(i);
-		alloc.complete();
-		v->setInstructions(nlist);
-		map.rewind();
+	// output in order
+	int code = 0, failed = 0;
+	for(size_t i = 0; i < sources.size(); i++) {
+		out << outs[i].str();
+		err << errs[i].str();
+		if(codes[i] != 0) {
+			failed++;
+			code = max(code, codes[i]);
+		}
 	}
+	if(failed != 0)
+		err << "ERROR: " << failed << " of " << sources.size() << " sources failed." << endl;
+	return code;
 }
 
 
 /**
- * Output assembly from the CFG from the given stream.
- * @param g		Instruction CFG to output.
- * @param out	Output stream to output to.
+ * Command line of the compiler.
  */
-void outputAssembly(CFG<Inst>& g, ostream& out) {
-
-	// generate prolog
-	out << "\t.global main\n"
-		<< "\n"
-		<< "_main:" << endl;
-
-	// generate body
-	set<BB<Inst> *> todo, done;
-	todo.insert(g.entry());
-	while(!todo.empty()) {
-		auto bb = *todo.begin();
-		while(bb != nullptr) {
-			for(auto i: bb->instructions())
-				out << i << endl;
-			todo.erase(bb);
-			done.insert(bb);
-			if(bb->target() != nullptr
-			&& done.find(bb->target()) == done.end())
-				todo.insert(bb->target());
-			bb = bb->next();
-		}
-	}
+class Command {
+public:
+	typedef enum {
+		COMPILE,
+		SERVER,
+		CLIENT
+	} mode_t;
 
-	// generate epilog
-	out << "\tbx LR" << endl;
-
-	// generate run-time
-	out << endl
-		<< "@ R0 = e, R1 = u, R2 = l\n"
-		<< "get_field:\n"
-		<< "L10000:\n"
-		<< "	stmfd sp!, {R1, R2}\n"
-		<< "	mov R0, R0, lsr R2\n"
-		<< "	sub R1, R1, R2\n"
-		<< "	add R1, R1, #1\n"
-		<< "	mov R2, #1\n"
-		<< "	mov R2, R2, lsl R1\n"
-		<< "	sub R2, R2, #1\n"
-		<< "	and R0, R0, R2\n"
-		<< "	ldmfd sp!, {R1, R2}\n"
-		<< "	bx  LR\n"
-		<< endl
-		<< "@ R0 = i, R1 = u, R2 = l, R3 = e\n"
-		<< "set_field:\n"
-		<< "L10001:\n"
-		<< "	stmfd sp!, {R1, R3, R4}\n"
-		<< "	sub R1, R1, R2\n"
-		<< "	add R1, R1, #1\n"
-		<< "	mov R4, #1\n"
-		<< "	mov R4, R4, lsl R1\n"
-		<< "	and R3, R3, R4\n"
-		<< "	mov R3, R3, lsl R2\n"
-		<< "	mov R4, R4, lsl R2\n"
-		<< "	mvn R4, R4\n"
-		<< "	and R0, R0, R4\n"
-		<< "	orr R0, R0, R3\n"
-		<< "	ldmfd sp!, {R1, R3, R4}\n"
-		<< "	bx  LR\n"
-	;
-}
+	inline Command(): jobs(1), mode(COMPILE), shutdown(false) { }
+	vector<string> sources;
+	Options options;
+	unsigned jobs;
+	mode_t mode;
+	string socket;
+	bool shutdown;
+};
 
 
 /**
  * Print help message.
+ * @param err	Stream to print to.
  */
-void printHelp() {
-	cerr << "SYNTAX: ioc [options] FILE.ioc\n"
+void printHelp(ostream& err) {
+	err << "SYNTAX: ioc [options] FILE.io...\n"
 		 << "Options may be:\n"
 		 << "-h, --help     	- display this message.\n"
+		 << "--server[=SOCK]	- serve the compilation requests on the socket SOCK.\n"
+		 << "--client[=SOCK]	- forward the compilation to the server on the socket SOCK.\n"
+		 << "--shutdown     	- with --client, stop the server.\n"
+		 << "-ftime-report  	- print the time spent in each phase.\n"
+		 << "-ftime-report=json	- print the time report as JSON.\n"
+		 << "-fcache        	- use the compilation cache (in $IOC_CACHE_DIR, else ~/.cache/ioc).\n"
+		 << "-fcache=DIR    	- use the compilation cache in DIR.\n"
+		 << "-fcache-size=N 	- maximal size of the compilation cache in MiB (default 64).\n"
+		 << "-fsccp         	- propagate the constants through the states and remove the code never executed.\n"
+		 << "-flvn          	- remove the redundant computations in the basic blocks.\n"
+		 << "-fgvn          	- remove the redundant computations across the basic blocks of the states.\n"
+		 << "-fdce          	- remove the computations whose result is never used.\n"
+		 << "-fincremental  	- reuse the code of the states unchanged since a previous compilation.\n"
+		 << "-fscanner=KIND 	- scanner among flex (default), simd or scalar.\n"
+		 << "-fthreads=N    	- generate, select and allocate with N threads (0 for all cores).\n"
+		 << "-j N           	- compile several sources with N threads (0 for all cores).\n"
 		 << "-S, --assembly 	- generate assembly.\n"
 		 << "-print-alloc   	- print the instructions after register allocation.\n"
 		 << "-print-ast    		- print AST and stop.\n"
 		 << "-print-cfg     	- print quadruplet CFG.\n"
 		 << "-print-quads   	- print the quadruplets.\n"
 		 << "-print-select  	- print the selected instructions.\n"
+		 << "-print-ssa     	- print the quadruplets in SSA form.\n"
 		 << "-reduce-const  	- reduce constant expressions.\n"
-		 << "-stop-after-print	- stop compilation after a print command.\n";
+		 << "-stop-after-print	- stop compilation after a print command.\n"
+		 << "The socket defaults to $IOC_SOCKET, else $XDG_RUNTIME_DIR/ioc.sock.\n";
 }
 
+
 /**
- * Compiler entry.
+ * Parse the command line arguments.
+ * @param args	Arguments (without the program name).
+ * @param cmd	Command to fill.
+ * @param err	Stream to output the errors to.
+ * @return		-1 for success, the exit code else.
  */
-int main(int argc, const char **argv) {
-	string source;
-	bool print_ast = false;
-	bool reduce_const = false;
-	bool print_quads = false;
-	bool print_cfg = false;
-	bool print_select = false;
-	bool print_alloc = false;
-	bool assembly = false;
-	bool stop_after_print = false;
-
-	// parse arguments
-	for(int i = 1; i < argc; i++) {
-		string arg = argv[i];
+int parseArguments(const vector<string>& args, Command& cmd, ostream& err) {
+	Options& options = cmd.options;
+	for(size_t i = 0; i < args.size(); i++) {
+		const string& arg = args[i];
 		if(arg == "")
 			continue;
-		else if(arg[0] != '-') {
-			if(source == "")
-				source = arg;
-			else {
-				printHelp();
-				cerr << "ERROR: several sources provided!" << endl;
-				exit(1);
-			}
-		}
+		else if(arg[0] != '-')
+			cmd.sources.push_back(arg);
 		else if(arg == "-print-ast")
-			print_ast = true;
+			options.print_ast = true;
 		else if(arg == "-reduce-const")
-			reduce_const = true;
+			options.reduce_const = true;
 		else if(arg == "-print-quads")
-			print_quads = true;
+			options.print_quads = true;
 		else if(arg == "-print-cfg")
-			print_cfg = true;
+			options.print_cfg = true;
+		else if(arg == "-print-ssa")
+			options.print_ssa = true;
 		else if(arg == "-print-select")
-			print_select = true;
+			options.print_select = true;
 		else if(arg == "-print-alloc")
-			print_alloc = true;
+			options.print_alloc = true;
 		else if(arg == "-stop-after-print")
-			stop_after_print = true;
+			options.stop_after_print = true;
 		else if(arg == "-S" || arg == "--assembly")
-			assembly = true;
+			options.assembly = true;
+		else if(arg == "-ftime-report")
+			options.time_report = Options::TEXT;
+		else if(arg == "-ftime-report=json")
+			options.time_report = Options::JSON;
+		else if(arg == "-fscanner=flex")
+			options.scanner = Scanner::FLEX;
+		else if(arg == "-fscanner=simd")
+			options.scanner = Scanner::SIMD;
+		else if(arg == "-fscanner=scalar")
+			options.scanner = Scanner::SCALAR;
+		else if(arg == "-fsccp")
+			options.sccp = true;
+		else if(arg == "-fgvn")
+			options.gvn = true;
+		else if(arg == "-fdce")
+			options.dce = true;
+		else if(arg == "-flvn")
+			options.lvn = true;
+		else if(arg == "-fincremental")
+			options.incremental = true;
+		else if(arg == "-fcache")
+			options.cache_dir = Cache::defaultDir();
+		else if(arg.compare(0, 8, "-fcache=") == 0)
+			options.cache_dir = arg.substr(8);
+		else if(arg.compare(0, 13, "-fcache-size=") == 0) {
+			string n = arg.substr(13);
+			if(n == "" || n.find_first_not_of("0123456789") != string::npos) {
+				printHelp(err);
+				err << "ERROR: bad cache size " << n << endl;
+				return 2;
+			}
+			options.cache_size = stoul(n) << 20;
+		}
+		else if(arg.compare(0, 10, "-fthreads=") == 0) {
+			string n = arg.substr(10);
+			if(n == "" || n.find_first_not_of("0123456789") != string::npos) {
+				printHelp(err);
+				err << "ERROR: bad number of threads " << n << endl;
+				return 2;
+			}
+			options.threads = stoul(n);
+		}
+		else if(arg.compare(0, 2, "-j") == 0) {
+			string n = arg.substr(2);
+			if(n == "" && i + 1 < args.size())
+				n = args[++i];
+			if(n == "" || n.find_first_not_of("0123456789") != string::npos) {
+				printHelp(err);
+				err << "ERROR: bad number of jobs " << n << endl;
+				return 2;
+			}
+			cmd.jobs = stoul(n);
+		}
+		else if(arg == "--server" || arg.compare(0, 9, "--server=") == 0) {
+			cmd.mode = Command::SERVER;
+			cmd.socket = arg.size() > 9 ? arg.substr(9) : Server::defaultPath();
+		}
+		else if(arg == "--client" || arg.compare(0, 9, "--client=") == 0) {
+			cmd.mode = Command::CLIENT;
+			cmd.socket = arg.size() > 9 ? arg.substr(9) : Server::defaultPath();
+		}
+		else if(arg == "--shutdown")
+			cmd.shutdown = true;
 		else if(arg == "-h" || arg == "--help") {
-			printHelp();
+			printHelp(err);
 			return 1;
 		}
 		else {
-			printHelp();
-			cerr << "ERROR: unknown argument " << arg << endl;
+			printHelp(err);
+			err << "ERROR: unknown argument " << arg << endl;
 			return 2;
 		}
 	}
+	return -1;
+}
 
-	// perform analaysis
-	try {
-		if(source == "")
-			yyparse();
-		else {
-			yyin = fopen(source.c_str(), "r");
-			if(yyin == NULL) {
-				cerr << "ERROR: cannot open '" << source << "'" << endl;
-				return 2;
-			}
-			lexer_file = source.c_str();
-			yyparse();
-			fclose(yyin);
-		}
-	}
-	catch(const ParseException& e) {
-		cerr << "ERROR:" << e.pos() << ": " << e.msg() << endl;
-		return 1;
-	}
-
-	// reduce constant
-	if(reduce_const)
-		for(auto s: Declaration::symbols())
-			s.second->reduce();
 
-	// perform post-processing
-	if(print_ast) {
-		for(auto s: Declaration::symbols())
-			s.second->print(cout);
-		if(stop_after_print)
-			return 0;
+/**
+ * Perform the compilation of a command.
+ * @param cmd	Command to perform.
+ * @param input	Text to compile if there is no source (nullptr for the
+ * 				standard input).
+ * @param out	Stream to output the prints and the assembly to.
+ * @param err	Stream to output the diagnostics to.
+ * @return		0 for success, an error code else.
+ */
+int execute(const Command& cmd, const string *input, ostream& out, ostream& err) {
+	if(cmd.sources.size() > 1)
+		return compileBatch(cmd.sources, cmd.options, cmd.jobs, out, err);
+	else if(!cmd.sources.empty())
+		return compile(cmd.sources[0], cmd.options, out, out, err);
+	else if(input == nullptr)
+		return compile("", cmd.options, out, out, err);
+	else {
+		Source text;
+		text.assign(*input);
+		return compile("", text, cmd.options, out, out, err);
 	}
+}
 
-	// compile in quadruplets
-	QuadProgram quads;
-	AutoDecl *automaton = nullptr;
-	for(auto s: Declaration::symbols())
-		if(s.second->type() == Declaration::VAR)
-			quads.declare(s.first);
-		else if(s.second->type() == Declaration::AUTO)
-			automaton = static_cast<AutoDecl *>(s.second);
-	if(automaton == nullptr) {
-		cerr << "ERROR: no automaton in this file: '" << source << "'" << endl;
-		return 3;
-	}
-	automaton->gen(quads);
 
-	// print quads if need
-	if(print_quads) {
-		quads.print(cout);
-		if(stop_after_print)
-			return 0;
+/**
+ * Serve the compilation requests of the clients. Each request is
+ * processed in the working directory of its client and the imported
+ * modules are kept between the requests.
+ * @param cmd	Server command.
+ * @return		0 for success, an error code else.
+ */
+int serve(const Command& cmd) {
+	Server server(cmd.socket);
+	if(!server.listen()) {
+		cerr << "ERROR: cannot listen on '" << cmd.socket << "': " << strerror(errno) << endl;
+		return 2;
 	}
+	CompilationUnit::keepModules(true);
+	server.serve([](const Server::Request& request, Server::Response& response) {
+		ostringstream out, err;
+		Command cmd;
+		response.code = parseArguments(request.args, cmd, err);
+		if(response.code < 0) {
+			if(cmd.shutdown) {
+				response.stop = true;
+				response.code = 0;
+			}
+			else if(cmd.mode != Command::COMPILE) {
+				err << "ERROR: --server and --client cannot be sent to a server" << endl;
+				response.code = 2;
+			}
+			else if(chdir(request.cwd.c_str()) < 0) {
+				err << "ERROR: cannot change to '" << request.cwd << "'" << endl;
+				response.code = 2;
+			}
+			else
+				response.code = execute(cmd, request.has_input ? &request.input : nullptr, out, err);
+		}
+		response.out = out.str();
+		response.err = err.str();
+	});
+	CompilationUnit::keepModules(false);
+	return 0;
+}
 
-	// build CFG
-	auto cfg = quads.makeCFG();
 
-	// print CFG if needed
-	if(print_cfg) {
-		cfg->print(cout);
-		if(stop_after_print)
-			return 0;
+/**
+ * Forward the compilation to a server. If no source is given, the
+ * standard input is sent as the text to compile.
+ * @param cmd	Client command.
+ * @param args	Arguments to forward (without the client option).
+ * @return		Exit code of the compilation.
+ */
+int callServer(const Command& cmd, const vector<string>& args) {
+	Server::Request request;
+	char buf[4096];
+	if(getcwd(buf, sizeof(buf)) == nullptr) {
+		cerr << "ERROR: cannot get the current directory" << endl;
+		return 2;
 	}
-
-	// select instructions
-	auto inst_cfg = selectInstructions(cfg);
-	if(print_select) {
-		inst_cfg->print(cout);
-		if(stop_after_print)
-			return 0;
+	request.cwd = buf;
+	request.args = args;
+	if(cmd.sources.empty() && !cmd.shutdown) {
+		Source text;
+		if(!text.open("")) {
+			cerr << "ERROR: cannot read the standard input" << endl;
+			return 2;
+		}
+		request.has_input = true;
+		request.input.assign(text.data(), text.size());
 	}
-
-	// allocate registers
-	allocRegisters(*inst_cfg, quads);
-	if(print_alloc) {
-		inst_cfg->print(cout);
-		if(stop_after_print)
-			return 0;
+	int code = Server::call(cmd.socket, request, cout, cerr);
+	if(code < 0) {
+		cerr << "ERROR: cannot reach the server on '" << cmd.socket << "': " << strerror(errno) << endl;
+		return 2;
 	}
+	return code;
+}
 
-	// output machine instructions
-	if(assembly)
-		outputAssembly(*inst_cfg, cout);
 
-	// clean all
-	Declaration::clearSymTab();
-	return 0;
+/**
+ * Compiler entry.
+ */
+int main(int argc, const char **argv) {
+	vector<string> args(argv + 1, argv + argc);
+	Command cmd;
+	int code = parseArguments(args, cmd, cerr);
+	if(code >= 0)
+		return code;
+	switch(cmd.mode) {
+	case Command::SERVER:
+		return serve(cmd);
+	case Command::CLIENT:
+		args.erase(remove_if(args.begin(), args.end(),
+			[](const string& a) { return a == "--client" || a.compare(0, 9, "--client=") == 0; }), args.end());
+		return callServer(cmd, args);
+	default:
+		return execute(cmd, nullptr, cout, cerr);
+	}
 }
@@ -3,21 +3,31 @@
 	#include <vector>
 	#include <algorithm>
 	#include "AST.hpp"
+	#include "CompilationUnit.hpp"
 	using namespace std;
+%}
 
-	extern int lexer_line;
-	extern const char *lexer_file;
-
-	int yylex();
-	void yyerror(char const *msg) {
-		throw ParseException(Position(), msg);
+%code requires {
+	#ifndef YY_TYPEDEF_YY_SCANNER_T
+	#define YY_TYPEDEF_YY_SCANNER_T
+	typedef void *yyscan_t;
+	#endif
+	#include <cstdint>
+	class CompilationUnit;
+}
+
+%code {
+	static inline int yylex(YYSTYPE *lvalp, CompilationUnit& cu) {
+		return cu.lex(lvalp);
 	}
 
-	vector<State *> states;
-	vector<When *> whens;
+	void yyerror(CompilationUnit& cu, char const *msg) {
+		throw ParseException(cu.position(), msg);
+	}
 
-	Declaration *checkLoc(string name, int line) {
-		auto d = Declaration::getSymbol(name);
+	Declaration *checkLoc(CompilationUnit& cu, uint32_t id, int line) {
+		auto d = cu.getSymbol(id);
+		const string& name = cu.name(id);
 		if(d == nullptr)
 			throw ParseException(Position(line), name + " does not exist.");
 		if(d->type() != Declaration::REG
@@ -26,8 +36,9 @@
 		return d;
 	}
 
-	Declaration *checkMem(string name, int line) {
-		auto d = Declaration::getSymbol(name);
+	Declaration *checkMem(CompilationUnit& cu, uint32_t id, int line) {
+		auto d = cu.getSymbol(id);
+		const string& name = cu.name(id);
 		if(d == nullptr)
 			throw ParseException(Position(line), name + " does not exist.");
 		if(d->type() != Declaration::REG
@@ -36,13 +47,24 @@
 			throw ParseException(Position(line), name + " should be a register, a variable or a constant.");
 		return d;
 	}
-%}
 
+	template <class T>
+	T *declare(CompilationUnit& cu, T *decl, int line) {
+		decl->setLine(line);
+		cu.declare(decl);
+		return decl;
+	}
+}
+
+%define api.pure full
+%parse-param {CompilationUnit& cu}
+%lex-param {CompilationUnit& cu}
 %define api.value.type union
-%token<char *> ID
+%token<uint32_t> ID
 %token<long int> INT
+%token<uint32_t> STRING
 %type<int> line
-%type<Expression *> expr atom
+%type<uint32_t> expr atom
 %type<Statement *> opt_stmts stmts stmt
 %type<bool> opt_not
 %type<Condition *> cond
@@ -62,6 +84,7 @@
 %token GT2
 %token GT3
 %token IF
+%token IMPORT
 %token LT2
 %token LT3
 %token NOT
@@ -90,13 +113,20 @@
 
 %%
 
-top: opt_decls
+top: opt_imports opt_decls
 	{ }
 ;
 
 line:
 	%empty
-		{ $$ = lexer_line; }
+		{ $$ = cu.line(); }
+
+opt_imports:
+	%empty
+		{ }
+|	opt_imports IMPORT line STRING
+		{ cu.import(cu.name($4), $3); }
+;
 
 opt_decls:
 	%empty
@@ -116,53 +146,46 @@ decl:
 
 	CONST line ID '=' expr
 		{
-			auto x = $5->eval();
+			auto x = cu.expr($5).eval();
 			if(!x)
-				throw ParseException($5->pos, "should be a constant!");
-			delete $5;
-			(new ConstDecl($3, *x))->setLine($2);
-			free($3);
+				throw ParseException(cu.expr($5).pos(), "should be a constant!");
+			declare(cu, new ConstDecl(cu.name($3), *x), $2);
 		}
 
 |	VAR line ID
-		{ (new VarDecl($3))->setLine($2); free($3); }
+		{ declare(cu, new VarDecl(cu.name($3)), $2); }
 
 |	REG line ID '@' expr
 		{
-			auto x = $5->eval();
+			auto x = cu.expr($5).eval();
 			if(!x)
-				throw ParseException($5->pos, "should be a constant!");
-			delete $5;
-			(new RegDecl($3, *x))->setLine($2);
-			free($3);
+				throw ParseException(cu.expr($5).pos(), "should be a constant!");
+			declare(cu, new RegDecl(cu.name($3), *x), $2);
 		}
 
 |	SIG line ID '@' ID '[' expr ']'
 		{
-			auto dec = Declaration::getSymbol($5);
+			auto dec = cu.getSymbol($5);
 			if(dec == nullptr)
-				throw ParseException(Position($2), string($5) + " does not exist!");
+				throw ParseException(Position($2), cu.name($5) + " does not exist!");
 			if(dec->type() != Declaration::REG)
-				throw ParseException(Position($2), string($5) + " must be a register.");
-			auto x = $7->eval();
+				throw ParseException(Position($2), cu.name($5) + " must be a register.");
+			auto x = cu.expr($7).eval();
 			if(!x)
-				throw ParseException($7->pos, "bit number should be a constant!");
+				throw ParseException(cu.expr($7).pos(), "bit number should be a constant!");
 			if(*x >= 32)
-				throw ParseException($7->pos, "bit number must be less than 32!");
-			(new SigDecl($3, static_cast<RegDecl *>(dec), *x))->setLine($2);
-			delete $7;
-			free($3);
-			free($5);
+				throw ParseException(cu.expr($7).pos(), "bit number must be less than 32!");
+			declare(cu, new SigDecl(cu.name($3), static_cast<RegDecl *>(dec), *x), $2);
 		}
 
 |	AUTO line ID opt_stmts states
 		{
-			$4->fix(states);
-			for(auto s: states)
-				s->fix(states);
-			(new AutoDecl($3, $4, states))->setLine($2);
-			free($3);
-			states.clear();
+			auto& index = cu.stateIndex();
+			$4->fix(index);
+			for(auto s: cu.states())
+				s->fix(index);
+			declare(cu, new AutoDecl(cu.name($3), $4, cu.states()), $2);
+			cu.clearStates();
 		}
 ;
 
@@ -176,14 +199,12 @@ states:
 state:
 	STATE line ID ':' opt_stmts opt_whens
 		{
-			for(auto s: states)
-				if(s->name() == $3)
-					throw ParseException(Position($2), string(" state ") + $3 + " already exists.");
-			auto s = new State($3, $5, whens);
+			if(cu.getState($3) != nullptr)
+				throw ParseException(Position($2), string(" state ") + cu.name($3) + " already exists.");
+			auto s = new State(cu.name($3), $5, cu.whens());
 			s->setLine($2);
-			states.push_back(s);
-			whens.clear();
-			free($3);
+			cu.addState($3, s);
+			cu.whens().clear();
 		}
 ;
 
@@ -204,14 +225,14 @@ whens:
 when:
 	WHEN line opt_not ID ':' opt_stmts
 		{
-			auto s = Declaration::getSymbol($4);
+			auto s = cu.getSymbol($4);
 			if(s == nullptr)
-				throw ParseException(Position($2), string($4) + " does not exist.");
+				throw ParseException(Position($2), cu.name($4) + " does not exist.");
 			if(s->type() != Declaration::SIG)
-				throw ParseException(Position($2), string($4) + " should be a singal!");
+				throw ParseException(Position($2), cu.name($4) + " should be a singal!");
 			auto w = new When($3, static_cast<SigDecl *>(s), $6);
 			w->setLine($2);
-			whens.push_back(w);
+			cu.whens().push_back(w);
 		}
 ;
 
@@ -233,32 +254,38 @@ stmts:
 	stmt
 		{ $$ = $1; }
 |	stmts stmt
-		{ $$ = new SeqStatement($1, $2); }
+		{
+			/* a stmt is never a block: only a sequence built here is */
+			auto b = $1->type() == Statement::BLOCK
+				? static_cast<BlockStatement *>($1)
+				: new BlockStatement();
+			if(b != $1)
+				b->add($1);
+			b->add($2);
+			$$ = b;
+		}
 ;
 
 stmt:
 
 	ID line '=' expr
 		{
-			auto d = checkLoc($1, $2);
-			$$ = new SetStatement(d, $4);
+			auto d = checkLoc(cu, $1, $2);
+			$$ = new SetStatement(d, cu.expr($4));
 			$$->setLine($2);
-			free($1);
 		}
 
 |	ID line '[' expr ']' '=' expr
 		{
-			auto d = checkLoc($1, $2);
-			$$ = new SetFieldStatement(d, $4, $4, $7);
+			auto d = checkLoc(cu, $1, $2);
+			$$ = new SetFieldStatement(d, cu.expr($4), cu.expr($4), cu.expr($7));
 			$$->setLine($2);
-			free($1);
 		}
 |	ID line '[' expr DOTDOT expr ']' '=' expr
 		{
-			auto d = checkLoc($1, $2);
-			$$ = new SetFieldStatement(d, $4, $6, $9);
+			auto d = checkLoc(cu, $1, $2);
+			$$ = new SetFieldStatement(d, cu.expr($4), cu.expr($6), cu.expr($9));
 			$$->setLine($2);
-			free($1);
 		}
 |	IF line cond THEN stmts ENDIF
 		{ $$ = new IfStatement($3, $5, new NOPStatement()); $$->setLine($2); }
@@ -272,17 +299,17 @@ stmt:
 
 cond:
 	expr '=' line expr
-		{ $$ = new CompCond(CompCond::EQ, $1, $4); $$->setLine($3); }
+		{ $$ = new CompCond(CompCond::EQ, cu.expr($1), cu.expr($4)); $$->setLine($3); }
 |	expr NE line expr
-		{ $$ = new CompCond(CompCond::NE, $1, $4); $$->setLine($3); }
+		{ $$ = new CompCond(CompCond::NE, cu.expr($1), cu.expr($4)); $$->setLine($3); }
 |	expr '<' line expr
-		{ $$ = new CompCond(CompCond::LT, $1, $4); $$->setLine($3); }
+		{ $$ = new CompCond(CompCond::LT, cu.expr($1), cu.expr($4)); $$->setLine($3); }
 |	expr LE line expr
-		{ $$ = new CompCond(CompCond::LE, $1, $4); $$->setLine($3); }
+		{ $$ = new CompCond(CompCond::LE, cu.expr($1), cu.expr($4)); $$->setLine($3); }
 |	expr '>' line expr
-		{ $$ = new CompCond(CompCond::GT, $1, $4); $$->setLine($3); }
+		{ $$ = new CompCond(CompCond::GT, cu.expr($1), cu.expr($4)); $$->setLine($3); }
 |	expr GE line expr
-		{ $$ = new CompCond(CompCond::GE, $1, $4); $$->setLine($3); }
+		{ $$ = new CompCond(CompCond::GE, cu.expr($1), cu.expr($4)); $$->setLine($3); }
 |	NOT line cond
 		{ $$ = new NotCond($3); $$->setLine($2); }
 |	cond AND line cond
@@ -297,53 +324,51 @@ expr:
 	atom
 		{ $$ = $1; }
 |	expr '+' line expr
-		{ $$ = new BinopExpr(BinopExpr::ADD, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::ADD, $1, $4, $3); }
 |	expr '-' line expr
-		{ $$ = new BinopExpr(BinopExpr::SUB, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::SUB, $1, $4, $3); }
 |	expr '*' line expr
-		{ $$ = new BinopExpr(BinopExpr::MUL, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::MUL, $1, $4, $3); }
 |	expr '/' line expr
-		{ $$ = new BinopExpr(BinopExpr::DIV, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::DIV, $1, $4, $3); }
 |	expr '%' line expr
-		{ $$ = new BinopExpr(BinopExpr::MOD, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::MOD, $1, $4, $3); }
 |	expr '&' line expr
-		{ $$ = new BinopExpr(BinopExpr::BIT_AND, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::BIT_AND, $1, $4, $3); }
 |	expr '|' line expr
-		{ $$ = new BinopExpr(BinopExpr::BIT_OR, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::BIT_OR, $1, $4, $3); }
 |	expr '^' line expr
-		{ $$ = new BinopExpr(BinopExpr::XOR, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::XOR, $1, $4, $3); }
 |	expr LT2 line expr
-		{ $$ = new BinopExpr(BinopExpr::SHL, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::SHL, $1, $4, $3); }
 |	expr GT2 line expr
-		{ $$ = new BinopExpr(BinopExpr::SHR, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::SHR, $1, $4, $3); }
 |	expr LT3 line expr
-		{ $$ = new BinopExpr(BinopExpr::ROL, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::ROL, $1, $4, $3); }
 |	expr GT3 line expr
-		{ $$ = new BinopExpr(BinopExpr::ROR, $1, $4); $$->setLine($3); }
+		{ $$ = cu.exprs().binop(ExprPool::ROR, $1, $4, $3); }
 ;
 
 atom:
 	INT line
-		{ $$ = new ConstExpr($1); $$->setLine($2); }
+		{ $$ = cu.exprs().cst($1, $2); }
 |	ID line
 		{
-			auto d = checkMem($1, $2);
-			$$ = new MemExpr(d);
-			$$->setLine($2);
-			free($1);
+			auto d = checkMem(cu, $1, $2);
+			$$ = cu.exprs().mem(d, $2);
 		}
 
 |	atom '[' expr ']'
-		{ $$ = new BitFieldExpr($1, $3, $3); $$->pos = $1->pos;  }
+		{ $$ = cu.exprs().bitfield($1, $3, $3, cu.exprs().line($1)); }
 
 |	atom '[' expr DOTDOT expr ']'
-		{ $$ = new BitFieldExpr($1, $3, $5); $$->pos = $1->pos;  }
+		{ $$ = cu.exprs().bitfield($1, $3, $5, cu.exprs().line($1)); }
 
 |	'~' line atom
-		{ $$ = new UnopExpr(UnopExpr::INV, $3); $$->setLine($2); }
+		{ $$ = cu.exprs().unop(ExprPool::INV, $3, $2); }
 
 |	'-' line atom
-		{ $$ = new UnopExpr(UnopExpr::NEG, $3); $$->setLine($2); }
+		{ $$ = cu.exprs().unop(ExprPool::NEG, $3, $2); }
 
 |	'+' line atom
 		{ $$ = $3; }
@@ -2,44 +2,43 @@
 
 /****** Reduce for expressions ******/
 
-Expression *ConstExpr::reduce() {
-	return this;
+/**
+ * Replace a node by a constant if its operands are constant.
+ * @param i		Node to fold.
+ */
+void ExprPool::fold(index_t i) {
+	bool cst;
+	switch(op(i)) {
+	case CST:
+		return;
+	case MEM:
+		cst = declaration(i)->type() == Declaration::CST;
+		break;
+	case NEG:
+	case INV:
+		cst = op(_arg1[i]) == CST;
+		break;
+	case BITFIELD:
+		cst = op(_arg1[i]) == CST && op(_arg2[i]) == CST && op(_arg3[i]) == CST;
+		break;
+	default:
+		cst = op(_arg1[i]) == CST && op(_arg2[i]) == CST;
+		break;
+	}
+	if(cst) {
+		_consts.push_back(*eval(i));
+		_ops[i] = CST;
+		_arg1[i] = _consts.size() - 1;
+	}
 }
 
-Expression *MemExpr::reduce() {
-	if(_dec->type() != Declaration::CST)
-		return this;
-	else
-		return new ConstExpr(static_cast<ConstDecl *>(_dec)->value());
-}
-
-
-Expression *UnopExpr::reduce() {
-	_arg = _arg->reduce();
-	if(_arg->type() == CST)
-		return new ConstExpr(*eval());
-	else
-		return this;
-}
-
-Expression *BinopExpr::reduce() {
-	_arg1 = _arg1->reduce();
-	_arg2 = _arg2->reduce();
-	if(_arg1->type() == CST && _arg2->type() == CST)
-		return new ConstExpr(*eval());
-	else
-		return this;
-}
-
-Expression *BitFieldExpr::reduce() {
-	_expr = _expr->reduce();
-	_hi = _hi->reduce();
-	if(_hi != _lo)
-		_lo = _lo->reduce();
-	if(_expr->type() == CST && _hi->type() == CST && _lo->type() == CST)
-		return new ConstExpr(*eval());
-	else
-		return this;
+/**
+ * The sub-expression nodes being stored before their parent, the reduction
+ * is a simple forward sweep over the range of the expression.
+ */
+void ExprPool::reduce(index_t i) {
+	for(auto j = first(i); j <= i; j++)
+		fold(j);
 }
 
 
@@ -48,13 +47,13 @@ Expression *BitFieldExpr::reduce() {
 void NOPStatement::reduce() {
 }
 
-void SeqStatement::reduce() {
-	_stmt1->reduce();
-	_stmt2->reduce();
+void BlockStatement::reduce() {
+	for(auto s: _stmts)
+		s->reduce();
 }
 
 void SetStatement::reduce() {
-	_expr = _expr->reduce();
+	_expr.reduce();
 }
 
 void SetFieldStatement::reduce() {
@@ -73,8 +72,8 @@ void StopStatement::reduce() {
 /****** Reduction for conditions ******/
 
 void CompCond::reduce() {
-	_arg1 = _arg1->reduce();
-	_arg2 = _arg2->reduce();
+	_arg1.reduce();
+	_arg2.reduce();
 }
 
 void NotCond::reduce() {
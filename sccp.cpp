@@ -0,0 +1,455 @@
+#include <algorithm>
+#include <memory>
+#include "SSA.hpp"
+
+/*
+ * Sparse conditional constant propagation (Wegman and Zadeck) of the
+ * quadruplets, on their SSA form. Each version is given a value of the
+ * lattice TOP (not yet known), constant or BOTTOM (unknown) and each edge
+ * of the CFG is executable or not. The quads are only evaluated once their
+ * BB is reached by an executable edge and re-evaluated when one of the
+ * versions they use goes down in the lattice; a conditional branch only
+ * makes executable the edges it may take.
+ *
+ * Then a quad computing a constant becomes a SETI, a conditional branch
+ * with constant operands becomes a GOTO or is removed, and the BBs that
+ * are not reachable are removed (labels included). The folding leaves the
+ * definitions of its operands without use: while still in SSA form, the
+ * pure quads defining a temporary version that is no longer used are
+ * removed, cascading to their own operands.
+ *
+ * The registers read before being written in a state, the memory and the
+ * hardware registers are unknown. The operations are folded as performed
+ * by the target: comparisons are signed, and the divisions and the shifts
+ * are only folded when the ARM instructions give the C result (positive
+ * operands, shift count less than 32).
+ */
+
+/**
+ * Fold an operation on constants.
+ * @param op	Operation.
+ * @param x		First operand.
+ * @param y		Second operand.
+ * @param r		Result.
+ * @return		True if the operation can be folded.
+ */
+static bool fold(Quad::type_t op, uint32_t x, uint32_t y, uint32_t& r) {
+	switch(op) {
+	case Quad::SETI:
+	case Quad::SET:		r = x; break;
+	case Quad::NEG:		r = -x; break;
+	case Quad::INV:		r = ~x; break;
+	case Quad::ADD:		r = x + y; break;
+	case Quad::SUB:		r = x - y; break;
+	case Quad::MUL:		r = x * y; break;
+	case Quad::AND:		r = x & y; break;
+	case Quad::OR:		r = x | y; break;
+	case Quad::XOR:		r = x ^ y; break;
+	case Quad::DIV:
+	case Quad::MOD:
+		if(int32_t(x) < 0 || int32_t(y) <= 0)
+			return false;
+		r = op == Quad::DIV ? x / y : x % y;
+		break;
+	case Quad::SHL:
+	case Quad::SHR:
+	case Quad::ROL:
+	case Quad::ROR:
+		if(y >= 32)
+			return false;
+		if(op == Quad::SHL)
+			r = x << y;
+		else if(op == Quad::SHR)
+			r = x >> y;
+		else if(y == 0)
+			r = x;
+		else if(op == Quad::ROL)
+			r = (x << y) | (x >> (32 - y));
+		else
+			r = (x >> y) | (x << (32 - y));
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+
+/**
+ * Evaluate the condition of a branch on constants.
+ * @param op	Branch.
+ * @param x		First operand.
+ * @param y		Second operand.
+ * @return		True if the branch is taken.
+ */
+static bool taken(Quad::type_t op, uint32_t x, uint32_t y) {
+	int32_t a = x, b = y;
+	switch(op) {
+	case Quad::GOTO_EQ:	return a == b;
+	case Quad::GOTO_NE:	return a != b;
+	case Quad::GOTO_LT:	return a < b;
+	case Quad::GOTO_LE:	return a <= b;
+	case Quad::GOTO_GT:	return a > b;
+	case Quad::GOTO_GE:	return a >= b;
+	default:			return true;
+	}
+}
+
+
+/**
+ * Test if a quad only computes its result.
+ * @param q	Quad to test.
+ * @return	True if q can be removed when its result is not used.
+ */
+static inline bool isPure(const Quad& q) {
+	return q.type >= Quad::SETI && q.type <= Quad::ROR;
+}
+
+
+/**
+ * Constant propagator over the SSA form of a program (see above).
+ */
+class ConstantPropagator {
+public:
+	ConstantPropagator(SSAForm& ssa, size_t quad_count, unsigned reg_count);
+	void run();
+	size_t apply();
+	size_t removeDead(const vector<Quad::reg_t>& vars);
+
+private:
+	typedef enum : uint8_t {
+		TOP,
+		CONST,
+		BOTTOM
+	} level_t;
+
+	inline bool isConst(Quad::reg_t r) const { return _level[r] == CONST; }
+	void lower(Quad::reg_t r, level_t level, uint32_t value = 0);
+	void reach(uint32_t from, uint32_t to);
+	void evalPhi(const SSAForm::Phi& p);
+	void evalQuad(size_t i);
+	void evalBranch(uint32_t b);
+
+	SSAForm& _ssa;
+	vector<level_t> _level;
+	vector<uint32_t> _value;
+	vector<uint32_t> _block_of;
+	vector<bool> _visited;
+	vector<bool> _executable;			// by predecessor slot
+	vector<pair<uint32_t, uint32_t> > _flow;
+	vector<Quad::reg_t> _changed;
+};
+
+
+/**
+ * Build the propagator.
+ * @param ssa			SSA form of the program.
+ * @param quad_count	Number of quads.
+ * @param reg_count		Number of registers (versions included).
+ */
+ConstantPropagator::ConstantPropagator(SSAForm& ssa, size_t quad_count, unsigned reg_count)
+:	_ssa(ssa),
+	_level(reg_count, TOP),
+	_value(reg_count, 0),
+	_block_of(quad_count, SSAForm::none),
+	_visited(ssa.blockCount(), false)
+{
+	size_t slots = 0;
+	for(uint32_t b = 0; b < ssa.blockCount(); b++) {
+		const auto& x = ssa.block(b);
+		for(auto i = x.first; i < x.last; i++)
+			_block_of[i] = b;
+		slots = max(slots, size_t(x.preds_end));
+	}
+	_executable.resize(slots, false);
+
+	// the values not defined in the SSA form are unknown
+	for(Quad::reg_t r = 0; r < reg_count; r++)
+		if(ssa.def(r) == SSAForm::none)
+			_level[r] = BOTTOM;
+}
+
+
+/**
+ * Lower the value of a version in the lattice.
+ * @param r		Version.
+ * @param level	New level.
+ * @param value	Constant value (for CONST).
+ */
+void ConstantPropagator::lower(Quad::reg_t r, level_t level, uint32_t value) {
+	if(level == CONST && _level[r] == CONST && _value[r] != value)
+		level = BOTTOM;
+	if(level <= _level[r])
+		return;
+	_level[r] = level;
+	_value[r] = value;
+	_changed.push_back(r);
+}
+
+
+/**
+ * Record that an edge may be executed.
+ * @param from	Source BB.
+ * @param to	Sink BB.
+ */
+void ConstantPropagator::reach(uint32_t from, uint32_t to) {
+	if(to != SSAForm::none)
+		_flow.push_back(make_pair(from, to));
+}
+
+
+/**
+ * Evaluate a phi function over its executable edges.
+ * @param p	Phi function.
+ */
+void ConstantPropagator::evalPhi(const SSAForm::Phi& p) {
+	auto slot = _ssa.block(p.block).preds;
+	for(auto a: _ssa.args(p)) {
+		if(_executable[slot++] && _level[a] != TOP)
+			lower(p.d, _level[a], _value[a]);
+		if(_level[p.d] == BOTTOM)
+			break;
+	}
+}
+
+
+/**
+ * Evaluate a quad of a reached BB.
+ * @param i	Quad index.
+ */
+void ConstantPropagator::evalQuad(size_t i) {
+	const Quad& q = _ssa.quad(i);
+	if(q.type >= Quad::GOTO && q.type <= Quad::GOTO_GE) {
+		evalBranch(_block_of[i]);
+		return;
+	}
+	if(!q.writes() || q.d < Quad::HARD_COUNT)
+		return;
+	if(q.type == Quad::SETI) {
+		lower(q.d, CONST, q.a);
+		return;
+	}
+	if(q.type < Quad::SET || q.type > Quad::ROR) {
+		lower(q.d, BOTTOM);
+		return;
+	}
+	level_t x = _level[q.a], y = q.readsB() ? _level[q.b] : CONST;
+	uint32_t r;
+	if(x == BOTTOM || y == BOTTOM)
+		lower(q.d, BOTTOM);
+	else if(x == CONST && y == CONST) {
+		if(fold(q.type, _value[q.a], q.readsB() ? _value[q.b] : 0, r))
+			lower(q.d, CONST, r);
+		else
+			lower(q.d, BOTTOM);
+	}
+}
+
+
+/**
+ * Find the edges that may be taken at the end of a reached BB.
+ * @param b	BB.
+ */
+void ConstantPropagator::evalBranch(uint32_t b) {
+	const auto& x = _ssa.block(b);
+	if(x.first == x.last) {
+		reach(b, x.next);
+		return;
+	}
+	const Quad& q = _ssa.quad(x.last - 1);
+	if(q.type == Quad::GOTO)
+		reach(b, x.target);
+	else if(q.type >= Quad::GOTO_EQ && q.type <= Quad::GOTO_GE) {
+		if(_level[q.a] == TOP || _level[q.b] == TOP)
+			return;
+		if(isConst(q.a) && isConst(q.b))
+			reach(b, taken(q.type, _value[q.a], _value[q.b]) ? x.target : x.next);
+		else {
+			reach(b, x.target);
+			reach(b, x.next);
+		}
+	}
+	else if(q.type != Quad::RETURN)
+		reach(b, x.next);
+}
+
+
+/**
+ * Propagate the constants until a fixpoint is reached.
+ */
+void ConstantPropagator::run() {
+	for(auto s: _ssa.succs(SSAForm::root))
+		reach(SSAForm::root, s);
+	while(!_flow.empty() || !_changed.empty()) {
+
+		// follow an edge
+		if(!_flow.empty()) {
+			auto e = _flow.back();
+			_flow.pop_back();
+			auto ps = _ssa.preds(e.second);
+			auto slot = _ssa.block(e.second).preds + (find(ps.begin(), ps.end(), e.first) - ps.begin());
+			if(_executable[slot])
+				continue;
+			_executable[slot] = true;
+			for(const auto& p: _ssa.phis(e.second))
+				evalPhi(p);
+			if(!_visited[e.second]) {
+				_visited[e.second] = true;
+				const auto& x = _ssa.block(e.second);
+				for(auto i = x.first; i < x.last; i++)
+					if(_ssa.quad(i).writes())
+						evalQuad(i);
+				evalBranch(e.second);
+			}
+			continue;
+		}
+
+		// propagate a changed value
+		auto r = _changed.back();
+		_changed.pop_back();
+		for(auto site: _ssa.uses(r))
+			if(SSAForm::isPhi(site)) {
+				const auto& p = _ssa.phi(site);
+				if(_visited[p.block])
+					evalPhi(p);
+			}
+			else if(_visited[_block_of[site]])
+				evalQuad(site);
+	}
+}
+
+
+/**
+ * Rewrite the quads according to the found constants and edges.
+ * @return	Number of changed or removed quads.
+ */
+size_t ConstantPropagator::apply() {
+	size_t count = 0;
+	for(uint32_t b = 1; b < _ssa.blockCount(); b++) {
+		const auto& x = _ssa.block(b);
+
+		// remove the unreachable BBs
+		if(!_visited[b]) {
+			for(auto i = x.first; i < x.last; i++) {
+				_ssa.removed[i] = true;
+				count++;
+			}
+			continue;
+		}
+
+		for(auto i = x.first; i < x.last; i++) {
+			Quad& q = _ssa.quad(i);
+
+			// replace the constant computations
+			if(q.type >= Quad::SET && q.type <= Quad::ROR && q.d >= Quad::HARD_COUNT && isConst(q.d)) {
+				q = Quad::seti(q.d, _value[q.d]);
+				count++;
+			}
+
+			// fold the branches
+			else if(q.type >= Quad::GOTO_EQ && q.type <= Quad::GOTO_GE && isConst(q.a) && isConst(q.b)) {
+				if(taken(q.type, _value[q.a], _value[q.b]))
+					q = Quad::goto_(q.label());
+				else
+					_ssa.removed[i] = true;
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+
+/**
+ * Remove the pure quads and the phi functions defining a temporary version
+ * that is no longer used, once the quads are rewritten (see above).
+ * The registers read while not defined in their region may be defined in
+ * another one and are kept.
+ * @param vars	Variables of the program (live everywhere).
+ * @return		Number of removed quads.
+ */
+size_t ConstantPropagator::removeDead(const vector<Quad::reg_t>& vars) {
+	vector<uint32_t> uses(_level.size(), 0);
+	vector<bool> kept(_level.size(), false);
+	for(auto r: vars)
+		kept[r] = true;
+
+	// count the uses of the versions by the kept quads and phi functions
+	auto use = [&](Quad::reg_t r) {
+		uses[r]++;
+		if(_ssa.def(r) == SSAForm::none)
+			kept[_ssa.origin(r)] = true;
+	};
+	for(uint32_t b = 1; b < _ssa.blockCount(); b++) {
+		if(!_visited[b])
+			continue;
+		const auto& x = _ssa.block(b);
+		for(const auto& p: _ssa.phis(b))
+			for(auto a: _ssa.args(p))
+				use(a);
+		for(auto i = x.first; i < x.last; i++) {
+			const Quad& q = _ssa.quad(i);
+			if(_ssa.removed[i])
+				continue;
+			if(q.readsA())
+				use(q.a);
+			if(q.readsB() && !(q.readsA() && q.a == q.b))
+				use(q.b);
+		}
+	}
+
+	// remove the dead definitions, then the definitions they made dead
+	vector<Quad::reg_t> todo;
+	for(Quad::reg_t r = 0; r < uses.size(); r++)
+		if(uses[r] == 0 && _ssa.def(r) != SSAForm::none)
+			todo.push_back(r);
+	size_t count = 0;
+	while(!todo.empty()) {
+		auto r = todo.back();
+		todo.pop_back();
+		auto site = _ssa.def(r);
+		if(kept[_ssa.origin(r)])
+			continue;
+		auto release = [&](Quad::reg_t a) {
+			if(--uses[a] == 0 && _ssa.def(a) != SSAForm::none)
+				todo.push_back(a);
+		};
+		if(SSAForm::isPhi(site)) {
+			const auto& p = _ssa.phi(site);
+			if(!_visited[p.block])
+				continue;
+			for(auto a: _ssa.args(p))
+				release(a);
+		}
+		else {
+			const Quad& q = _ssa.quad(site);
+			if(_ssa.removed[site] || !isPure(q) || !_visited[_block_of[site]])
+				continue;
+			_ssa.removed[site] = true;
+			count++;
+			if(q.readsA())
+				release(q.a);
+			if(q.readsB() && !(q.readsA() && q.a == q.b))
+				release(q.b);
+		}
+	}
+	return count;
+}
+
+
+/**
+ * Perform sparse conditional constant propagation on the program (see
+ * above).
+ * @param entries	Labels of the entries of the regions (states and
+ * 					epilogue): no value is propagated across them.
+ * @return			Number of changed or removed quads.
+ */
+size_t QuadProgram::propagateConstants(const vector<Quad::lab_t>& entries) {
+	unique_ptr<SSAForm> ssa(makeSSA(entries));
+	ConstantPropagator prop(*ssa, _quads.size(), _vreg);
+	prop.run();
+	size_t count = prop.apply();
+	count += prop.removeDead(_vars);
+	restoreRegisters(*ssa);
+	return count;
+}
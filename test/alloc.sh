@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# Check the allocated code of the test files, e.g. bash test/alloc.sh -fgvn
+# As the registers are allocated per BB, each hardware register read in
+# a BB must be written (computed or loaded) before in the same BB. The
+# reads of registers not written before are printed and the exit status
+# is 1 if any is found.
+
+# Directory containing the test files
+test_dir="test"
+
+# Print the reads of registers not written before in their BB
+check() {
+    ./ioc "$@" -print-alloc -stop-after-print | awk '
+        /^BB / { bb = $2; sub(/:$/, "", bb); delete def; next }
+        /^\t\t/ {
+            op = $1
+            n = 0
+            for(i = 2; i <= NF; i++)
+                if(match($i, /^\[?R[0-9]+/)) {
+                    r = substr($i, RSTART, RLENGTH)
+                    sub(/^\[/, "", r)
+                    regs[++n] = r
+                }
+            first = 1
+            if(op == "str" || op == "cmp" || op ~ /^b/)
+                first = 0
+            for(i = 1 + first; i <= n; i++)
+                if(!(regs[i] in def))
+                    print "BB " bb ": " regs[i] " undefined in:" $0
+            if(first)
+                def[regs[1]] = 1
+        }
+    '
+}
+
+status=0
+for file in "$test_dir"/*.io; do
+    # skip the files that do not compile
+    if ! ./ioc "$@" -S "$file" > /dev/null 2>&1; then
+        continue
+    fi
+    errors=$(check "$@" "$file")
+    if [ -n "$errors" ]; then
+        echo "$(basename "$file"):"
+        echo "$errors"
+        status=1
+    fi
+done
+exit $status
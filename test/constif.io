@@ -0,0 +1,20 @@
+const MODE = 2
+
+reg ODR @ 0x40020C14
+
+var x
+
+auto A
+	x = MODE * 2
+	if x = 4 then
+		ODR[3..3] = 1
+	else
+		ODR[4..4] = 1
+	endif
+	if MODE > 3 then
+		ODR[5..5] = 1
+	endif
+	goto S
+
+	state S:
+		ODR[1..1] = 0
@@ -0,0 +1,17 @@
+// an expression computed before and after an if: -fgvn carries its
+// value across the BBs of the state
+reg R @ 0x40020000
+sig S @ R[0]
+var x
+var y
+var z
+
+auto A
+	state s1:
+		z = (x * 3 + y) * (x - y)
+		if x = 1 then
+			R = 2
+		endif
+		R = (x * 3 + y) * (x - y) + z
+		when S:
+			goto s1
@@ -0,0 +1,24 @@
+import "stm32f4.io"
+
+/* configuration */
+const USER_BUT = 0
+const GREEN_LED = 12
+sig BUTTON @ GPIOA_IDR[USER_BUT]
+
+
+/* automaton */
+auto A
+
+	GPIOD_MODER[2*GREEN_LED+1 .. 2*GREEN_LED] = GPIO_MODER_OUT
+	GPIOA_MODER[2*USER_BUT+1 .. 2*USER_BUT] = GPIO_MODER_IN
+	GPIOA_OTYPER[2*USER_BUT+1 .. 2*USER_BUT] = GPIO_PUPDR_PD
+
+	state up:
+		GPIOD_BSRR[GREEN_LED + 16] = 1
+		when BUTTON:
+			goto down
+
+	state down:
+		GPIOD_BSRR[GREEN_LED] = 1
+		when !BUTTON:
+			goto up
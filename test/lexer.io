@@ -0,0 +1,21 @@
+// lexical corner cases: the flex and hand-written scanners
+// must give the same tokens (ioc -fscanner=simd)
+const	K0 = 0x1F
+const K1=0b101	/* binary */
+reg R @ 0x40020000 + K0*4
+sig S @ R[3]
+var x_1
+var _y
+/* a comment
+   over several * lines **/
+
+auto A
+	x_1 = ((K0<<2)>>1) + (K1<<<3) - (R>>>4) % 7 ^ ~0x0f & 0b1|_y
+	_y = x_1[K1+2..K1]/**/ // trailing comment
+	state s1:
+		if x_1 >= 10 and not _y <= 3 or x_1 != _y then
+			R[1..0] = 0123
+		endif
+		when !S:
+			goto s1
+/* unterminated at the end of the file: still an end of input
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# Compare the code size of the test files with and without optimization
+# options, e.g. bash test/opt.sh -flvn
+# For each file, print the number of quads and of allocated instructions
+# without then with the options.
+
+if [ $# -eq 0 ]; then
+    echo "usage: $0 OPTIONS..."
+    exit 1
+fi
+
+# Directory containing the test files
+test_dir="test"
+
+# Count the quads and the allocated instructions of a file
+count() {
+    quads=$(./ioc "$@" -print-quads -stop-after-print | grep -c $'^\t[^@]')
+    insts=$(./ioc "$@" -print-alloc -stop-after-print | grep -c $'^\t\t')
+    echo "$quads $insts"
+}
+
+printf "%-20s %8s %8s %8s %8s\n" "file" "quads" "(opt)" "insts" "(opt)"
+total=(0 0 0 0)
+for file in "$test_dir"/*.io; do
+    # skip the files that do not compile
+    if ! ./ioc -S "$file" > /dev/null 2>&1; then
+        continue
+    fi
+    before=($(count "$file"))
+    after=($(count "$@" "$file"))
+    printf "%-20s %8d %8d %8d %8d\n" "$(basename "$file")" \
+        ${before[0]} ${after[0]} ${before[1]} ${after[1]}
+    total=($((total[0] + before[0])) $((total[1] + after[0])) \
+        $((total[2] + before[1])) $((total[3] + after[1])))
+done
+printf "%-20s %8d %8d %8d %8d\n" "total" ${total[@]}